@@ -0,0 +1,40 @@
+#ifndef DBUS_DISPATCH_H
+#define DBUS_DISPATCH_H
+
+#include <dbus-server/module-lib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct dbus_dispatch_entry {
+    uint64_t hash;                  /* 0 = empty slot */
+    const char *object_path;        /* Borrowed from the interface/method */
+    const char *interface;
+    const char *member;
+    DBUS_METHOD *method;
+    const struct dbus_dispatch_entry *next; /* Same key, next registration */
+};
+
+/*
+ * Immutable (object_path, interface, member) -> method table, rebuilt from
+ * the module list whenever it changes and swapped in as a whole, so the
+ * dispatcher looks methods up without taking the module lock.
+ * Open addressing with linear probing, at most half full.
+ */
+struct dbus_dispatch_table {
+    size_t mask;                    /* capacity - 1, capacity is a power of two */
+    size_t count;
+    struct dbus_dispatch_entry entries[];
+};
+
+/* NULL on allocation failure. Duplicate keys are chained through ->next in
+ * module order, so the dispatcher can fall through to the next registration
+ * on DBUS_HANDLER_RESULT_NOT_YET_HANDLED like the module search used to */
+struct dbus_dispatch_table *dbus_dispatch_table_build(DBUS_MODULE *modules);
+void dbus_dispatch_table_destroy(struct dbus_dispatch_table *table);
+
+/* First registration for the key, NULL if none */
+const struct dbus_dispatch_entry *dbus_dispatch_lookup(const struct dbus_dispatch_table *table,
+                                                       const char *object_path, const char *interface,
+                                                       const char *member);
+
+#endif
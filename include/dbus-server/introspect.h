@@ -0,0 +1,33 @@
+#ifndef DBUS_INTROSPECT_H
+#define DBUS_INTROSPECT_H
+
+#include <dbus-server/module-lib.h>
+#include <stddef.h>
+
+/*
+ * Object path tree built from the registered interfaces. Every node answers
+ * Introspect with its interfaces and direct children; the XML is generated
+ * on first request and kept until the tree is rebuilt (module add/remove).
+ */
+struct dbus_introspect_node {
+    char *name;                     /* Path component, "" for the root */
+    struct dbus_introspect_node *children;
+    struct dbus_introspect_node *children_tail;
+    struct dbus_introspect_node *next;
+
+    DBUS_INTERFACE **interfaces;    /* Borrowed from the modules */
+    size_t n_interfaces;
+    size_t interfaces_cap;
+
+    char *xml;                      /* Cached reply, NULL until requested */
+    size_t xml_len;
+};
+
+/* NULL on allocation failure */
+struct dbus_introspect_node *dbus_introspect_tree_build(DBUS_MODULE *modules);
+void dbus_introspect_tree_destroy(struct dbus_introspect_node *root);
+
+/* Cached XML for path, NULL when the path is not in the tree */
+const char *dbus_introspect_xml(struct dbus_introspect_node *root, const char *path, size_t *len);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DBUS_LOOP_H
+#define DBUS_LOOP_H
+
+#include <dbus/dbus.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+struct dbus_loop_watch {
+    DBusWatch *watch;
+    struct dbus_loop_watch *next;
+};
+
+struct dbus_loop_timeout {
+    DBusTimeout *timeout;
+    int timer_fd;
+    struct dbus_loop_timeout *next;
+};
+
+/*
+ * epoll loop for a D-Bus connection, driven by libdbus watch/timeout
+ * functions: the socket is only polled for writing while libdbus has
+ * outgoing data, timeouts are timerfds. wakeup_fd interrupts a wait from
+ * any thread (stop, libdbus wakeup_main).
+ */
+struct dbus_loop {
+    DBusConnection *connection;
+    int epoll_fd;
+    int wakeup_fd;
+
+    /* libdbus may call the watch/timeout functions from any thread */
+    pthread_mutex_t mutex;
+    struct dbus_loop_watch *watches;
+    struct dbus_loop_timeout *timeouts;
+};
+
+struct dbus_loop *dbus_loop_create(DBusConnection *connection);
+void dbus_loop_destroy(struct dbus_loop *loop);
+
+/* Extra fd that only interrupts the wait (edge-triggered, e.g. a queue eventfd) */
+bool dbus_loop_add_wakeup_fd(struct dbus_loop *loop, int fd);
+
+/* Any thread: interrupt dbus_loop_dispatch */
+void dbus_loop_wakeup(struct dbus_loop *loop);
+
+/* Loop thread: wait for events and handle watches/timeouts, -1 on error */
+int dbus_loop_dispatch(struct dbus_loop *loop);
+
+#endif
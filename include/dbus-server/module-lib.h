@@ -2,16 +2,45 @@
 #define DESKTOPENGINE_DBUS_MODULE_LIB_H
 
 #include <dbus/dbus.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 /* Callback type for method handlers */
 typedef DBusHandlerResult (*DBUS_METHOD_HANDLER)(DBusConnection *connection, DBusMessage *message, void *user_data);
 
+/* Reply handle of a worker method, answered once from any thread (dbus-server/worker_pool.h) */
+typedef struct dbus_deferred_reply DBUS_DEFERRED_REPLY;
+/* Callback type for handlers run on the worker pool, the message stays valid until the reply */
+typedef void (*DBUS_WORKER_HANDLER)(DBusMessage *message, DBUS_DEFERRED_REPLY *reply, void *user_data);
+
+/* Method flags */
+#define DBUS_METHOD_WORKER (1u << 0)   /* Slow handler, runs off the D-Bus thread */
+#define DBUS_METHOD_TYPED  (1u << 1)   /* Signature checked by the dispatcher (typed_method.h) */
+
+/* Named argument for introspection */
+struct dbus_arg_desc {
+    const char *name;               /* NULL terminates the table */
+    const char *type;
+    bool in;
+};
+
+/* Generated by DBUS_TYPED_METHOD */
+struct dbus_method_desc {
+    const char *signature;
+    const char *return_signature;
+    const struct dbus_arg_desc *args;
+    DBUS_METHOD_HANDLER dispatch;
+};
+
 /* Method type (Linked list) */
 typedef struct dbus_server_method {
     char *name;
     char *signature;
     char *return_signature;
-    DBUS_METHOD_HANDLER handler;
+    unsigned int flags;
+    DBUS_METHOD_HANDLER handler;            /* Inline methods */
+    DBUS_WORKER_HANDLER worker_handler;     /* DBUS_METHOD_WORKER methods */
+    const struct dbus_arg_desc *args;       /* Typed methods, static */
     void *user_data;
     struct dbus_server_method *next;
 } DBUS_METHOD;
@@ -31,9 +60,22 @@ typedef struct dbus_server_module {
     struct dbus_server_module *next;
 } DBUS_MODULE;
 
+/* Growable string, appends are amortized O(length of the fragment) */
+struct dbus_strbuf {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;                    /* An allocation failed, data was freed */
+};
+
+void strbuf_append_len(struct dbus_strbuf *buf, const char *src, size_t len);
+void strbuf_append(struct dbus_strbuf *buf, const char *src);
+/* Hand over the string (NULL if an append failed), buf is reset */
+char *strbuf_steal(struct dbus_strbuf *buf, size_t *len);
+
 /* Generate introspect XML for module */
 char *module_generate_introspection_xml(DBUS_MODULE *module, const char *object_path);
-char *str_append(char *dest, const char *src);
+void interface_append_introspection(struct dbus_strbuf *buf, DBUS_INTERFACE *iface);
 
 /* Module operations */
 DBUS_MODULE *module_create(char *name);
@@ -44,6 +86,8 @@ DBUS_INTERFACE *module_add_interface(DBUS_MODULE *module, char *iface_name, char
 
 /* Method operations */
 DBUS_METHOD *interface_add_method(DBUS_INTERFACE *iface, char *method_name, char *signature, char *return_signature, DBUS_METHOD_HANDLER handler, void *user_data);
+DBUS_METHOD *interface_add_typed_method(DBUS_INTERFACE *iface, char *method_name, const struct dbus_method_desc *desc, void *user_data);
+DBUS_METHOD *interface_add_worker_method(DBUS_INTERFACE *iface, char *method_name, char *signature, char *return_signature, DBUS_WORKER_HANDLER handler, void *user_data);
 DBUS_METHOD *module_find_method(DBUS_MODULE *module, const char *interface_name, const char *method_name, const char *object_path);
 
 #endif
\ No newline at end of file
@@ -7,29 +7,60 @@
 #include <stdbool.h>
 
 #include <wayland/buffer.h>
+#include <wayland/region.h>
+#include <wayland/buffer_tracker.h>
+#include <wayland/buffer_ring.h>
+#include <wayland/frame_timing.h>
 
 /* Buffer transport data */
 typedef struct {
     uint32_t width;
     uint32_t height;
     uint32_t stride;
-    uint32_t format;
+    uint32_t format; /* WL_SHM_FORMAT_* for SHM, DRM_FORMAT_* for DMA-BUF */
     const char *format_str;
     size_t size;
     enum wl_buffer_type type;  /* WL_BUFFER_SHM, WL_BUFFER_DMA_BUF, WL_BUFFER_EGL */
-    int fd; // Buffer fd
+    int fd; // Buffer fd (SHM: the whole pool)
+    uint32_t offset; /* Offset of the first pixel in fd */
+    const struct region *damage; /* Damaged boxes in buffer coords, NULL or empty = whole buffer */
+    uint32_t serial; /* Commit serial, consumers ack it with Release */
+    uint32_t surface_id; /* struct surface.id the buffer was committed to */
+    uint32_t buffer_id; /* struct buffer.id */
+    uint64_t modifier; /* DRM_FORMAT_MOD_*, LINEAR for SHM */
+    /* Planes after the first one (fd/offset/stride above are plane 0) */
+    uint32_t extra_planes;
+    int plane_fds[BUFFER_DMABUF_MAX_PLANES - 1];
+    uint32_t plane_offsets[BUFFER_DMABUF_MAX_PLANES - 1];
+    uint32_t plane_strides[BUFFER_DMABUF_MAX_PLANES - 1];
 } BufferInfo;
 
-/* Create module */
-DBUS_MODULE *create_buffer_module(void);
+/* Create module (Subscribe/Unsubscribe/Release feed the buffer tracker, OpenRing the ring) */
+DBUS_MODULE *create_buffer_module(struct buffer_tracker *tracker, struct buffer_ring *ring);
 
 /* Signals */
-DBusHandlerResult buffer_update_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
-DBusHandlerResult buffer_get_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
-DBusHandlerResult buffer_set_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
+DBusHandlerResult buffer_open_ring_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
 
-/* Update signal (Internal) */
-void buffer_module_send_update_signal(DBusConnection *conn, const BufferInfo *info);
+struct dbus_server;
+
+/*
+ * Signals (Internal). BufferRegistered carries the fds and layout of a
+ * buffer id once per consumer epoch, Updated only references the id,
+ * BufferDestroyed tells consumers to drop their mapping. They are queued
+ * for the D-Bus thread, false means the queue was full and it was dropped.
+ */
+bool buffer_module_send_registered_signal(struct dbus_server *server, const BufferInfo *info);
+bool buffer_module_send_update_signal(struct dbus_server *server, const BufferInfo *info);
+bool buffer_module_send_destroyed_signal(struct dbus_server *server, uint32_t buffer_id);
+
+/* DBUS_NAME_LOST_HANDLER, unsubscribes the peer and closes its ring; user_data is the buffer tracker */
+void buffer_module_name_lost(const char *name, void *user_data);
+
+/* DBUS_OUTBOUND_MERGE for Updated signals, user_data is the buffer tracker */
+DBusMessage *buffer_module_merge_updates(DBusMessage *older, DBusMessage *newer, void *user_data);
+
+/* DBUS_OUTBOUND_SENT for Updated signals, stamps FRAME_STAMP_SEND; user_data is the frame timing */
+void buffer_module_update_sent(DBusMessage *message, uint32_t coalesce_key, void *user_data);
 
 /* Format convert */
 const char *pixel_format_to_string(enum pixel_format format);
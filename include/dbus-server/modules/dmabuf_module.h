@@ -0,0 +1,15 @@
+#ifndef DBUS_DMABUF_MODULE_H
+#define DBUS_DMABUF_MODULE_H
+
+#include <dbus-server/module-lib.h>
+#include <dbus/dbus.h>
+
+#include <wayland/linux_dmabuf.h>
+
+/* Create module (user_data of every method is the linux-dmabuf state) */
+DBUS_MODULE *create_dmabuf_module(struct linux_dmabuf *dmabuf);
+
+/* Methods */
+DBusHandlerResult dmabuf_set_surface_feedback_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
+
+#endif
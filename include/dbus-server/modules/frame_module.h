@@ -0,0 +1,12 @@
+#ifndef DBUS_FRAME_MODULE_H
+#define DBUS_FRAME_MODULE_H
+
+#include <dbus-server/module-lib.h>
+#include <dbus/dbus.h>
+
+#include <wayland/frame_scheduler.h>
+
+/* Create module (user_data of every method is the frame scheduler) */
+DBUS_MODULE *create_frame_module(struct frame_scheduler *scheduler);
+
+#endif
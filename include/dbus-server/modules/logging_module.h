@@ -0,0 +1,10 @@
+#ifndef DBUS_LOGGING_MODULE_H
+#define DBUS_LOGGING_MODULE_H
+
+#include <dbus-server/module-lib.h>
+#include <dbus/dbus.h>
+
+/* Create module: live per-module log levels, no user_data */
+DBUS_MODULE *create_logging_module(void);
+
+#endif
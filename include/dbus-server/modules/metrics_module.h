@@ -0,0 +1,14 @@
+#ifndef DBUS_METRICS_MODULE_H
+#define DBUS_METRICS_MODULE_H
+
+#include <dbus-server/module-lib.h>
+#include <dbus/dbus.h>
+
+#include <wayland/frame_timing.h>
+
+/* Create module (user_data of every method is the frame timing) */
+DBUS_MODULE *create_metrics_module(struct frame_timing *timing);
+
+DBusHandlerResult metrics_list_surfaces_handler(DBusConnection *conn, DBusMessage *msg, void *user_data);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef DBUS_OUTBOUND_H
+#define DBUS_OUTBOUND_H
+
+#include <dbus/dbus.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DBUS_OUTBOUND_CAPACITY 1024     /* power of two */
+/* Slots only non-coalescable messages may take, they carry state (fds, ids) */
+#define DBUS_OUTBOUND_RESERVED 128
+
+/*
+ * Merge two coalescable messages with the same key, older was queued first.
+ * Returns the message to send in place of both and unrefs the others.
+ */
+typedef DBusMessage *(*DBUS_OUTBOUND_MERGE)(DBusMessage *older, DBusMessage *newer, void *user_data);
+
+/* A coalescable message was handed to the connection (D-Bus thread) */
+typedef void (*DBUS_OUTBOUND_SENT)(DBusMessage *message, uint32_t coalesce_key, void *user_data);
+
+struct dbus_outbound_cell {
+    _Atomic size_t sequence;
+    DBusMessage *message;
+    uint32_t coalesce_key;          /* 0 = never coalesced */
+};
+
+/*
+ * Messages built on other threads (Wayland) and sent by the D-Bus thread,
+ * so a slow bus never blocks the producer. Bounded lock-free MPSC queue
+ * (per-cell sequence numbers); when the consumer drains a backlog, messages
+ * sharing a coalesce key are merged latest-wins.
+ */
+struct dbus_outbound {
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) _Atomic size_t dequeue_pos;    /* Written by the consumer only */
+
+    atomic_bool wakeup_pending;
+    int event_fd;                   /* Readable when messages were queued */
+    atomic_ulong dropped;
+
+    DBUS_OUTBOUND_MERGE merge;
+    void *merge_data;
+    DBUS_OUTBOUND_SENT sent;
+    void *sent_data;
+
+    /* Consumer only, scratch space for coalescing */
+    struct dbus_outbound_cell batch[DBUS_OUTBOUND_CAPACITY];
+
+    struct dbus_outbound_cell cells[DBUS_OUTBOUND_CAPACITY];
+};
+
+struct dbus_outbound *dbus_outbound_create(void);
+void dbus_outbound_destroy(struct dbus_outbound *queue);
+
+/* Set before the first coalescable push */
+void dbus_outbound_set_merge(struct dbus_outbound *queue, DBUS_OUTBOUND_MERGE merge, void *user_data);
+/* Set before the first coalescable push */
+void dbus_outbound_set_sent(struct dbus_outbound *queue, DBUS_OUTBOUND_SENT sent, void *user_data);
+
+/* Any thread: takes the message reference, false (message dropped) when full */
+bool dbus_outbound_push(struct dbus_outbound *queue, DBusMessage *message, uint32_t coalesce_key);
+
+/* D-Bus thread: clear the wakeup, coalesce and send everything queued */
+void dbus_outbound_flush(struct dbus_outbound *queue, DBusConnection *conn);
+
+#endif
@@ -3,24 +3,42 @@
 
 #include <dbus/dbus.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
 #include <dbus-server/module-lib.h>
+#include <dbus-server/outbound.h>
+#include <dbus-server/loop.h>
+#include <dbus-server/dispatch.h>
+#include <dbus-server/introspect.h>
+
+struct wl_event_loop;
+struct dbus_wl_loop;
+struct dbus_worker_pool;
+
+/* A peer's unique name left the bus (exited or disconnected), called on the dispatching thread */
+typedef void (*DBUS_NAME_LOST_HANDLER)(const char *name, void *user_data);
 
 struct dbus_server {
     DBusConnection *connection;
     char *bus_name;
-    bool is_running;
+    atomic_bool is_running;
     pthread_t thread_id;
-    pthread_mutex_t mutex;
-    int wakeup_pipe[2];
-    struct pollfd *pollfds;
-    int pollfd_count;
+    pthread_mutex_t mutex; // modules list, unused in single-threaded mode
+    struct dbus_loop *loop; // epoll over the connection watches, owned by the loop thread while running
     DBUS_MODULE *modules; // list of modules (HEAD)
     DBUS_MODULE *modules_tail; // modules list tail
+    _Atomic(struct dbus_dispatch_table *) dispatch; // rebuilt from modules on add/remove, read without the mutex
+    atomic_uint dispatch_readers; // lookups (and handlers) using the current table
+    struct dbus_introspect_node *introspect_tree; // object path tree with cached XML, NULL after module changes
+    struct dbus_worker_pool *workers; // DBUS_METHOD_WORKER handlers, started on first call
+    struct dbus_outbound *outbound; // messages from other threads, sent by the loop thread
+    struct dbus_wl_loop *wl_loop; // set in single-threaded mode (no loop thread)
+    DBUS_NAME_LOST_HANDLER name_lost; // NameOwnerChanged for unique names, NULL = not watched
+    void *name_lost_data;
 };
 
-/* Server modules operations */
+/* Server modules operations (populate a module's methods before adding it, not from a handler) */
 void dbus_server_add_module(struct dbus_server *server, DBUS_MODULE *module);
 DBUS_MODULE *dbus_server_find_module(struct dbus_server *server, char *name);
 void dbus_server_remove_module(struct dbus_server *server, char *name);
@@ -30,8 +48,18 @@ void dbus_server_remove_all_modules(struct dbus_server *server);
 struct dbus_server *dbus_create_server(char *bus_name);
 void dbus_server_cleanup(struct dbus_server *server);
 int dbus_start_main_loop(struct dbus_server *server);
+/* Single-threaded alternative to dbus_start_main_loop: dispatch from the Wayland event loop */
+int dbus_server_attach_event_loop(struct dbus_server *server, struct wl_event_loop *loop);
+/* Loop thread (or event loop): handle every message read from the bus */
+void dbus_server_dispatch(struct dbus_server *server);
 void release_bus_name(DBusConnection *conn, const char *name);
 
 DBusConnection *dbus_server_get_connection(struct dbus_server *server);
 
+/* Set before the loop starts: watch peers leaving the bus */
+void dbus_server_set_name_lost(struct dbus_server *server, DBUS_NAME_LOST_HANDLER handler, void *user_data);
+
+/* Any thread: queue a message for the D-Bus thread, never blocks (false = dropped) */
+bool dbus_server_send_async(struct dbus_server *server, DBusMessage *message, uint32_t coalesce_key);
+
 #endif
\ No newline at end of file
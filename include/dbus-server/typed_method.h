@@ -0,0 +1,105 @@
+#ifndef DBUS_TYPED_METHOD_H
+#define DBUS_TYPED_METHOD_H
+
+#include <dbus-server/module-lib.h>
+#include <stdbool.h>
+
+/*
+ * Typed methods: one argument table per direction generates the in/out
+ * structs, (de)marshalling, signature and introspection <arg> entries.
+ * Only basic types are supported; the dispatcher checks the signature
+ * before the handler runs, so decoding cannot fail. Strings point into the
+ * message, nothing is allocated. UNIX_FD in-args are dups owned by the handler.
+ *
+ *   #define FRAME_SET_RATE_IN(A)  A(UINT32, refresh_mhz)
+ *   DBUS_TYPED_METHOD(frame_set_rate, FRAME_SET_RATE_IN, DBUS_NO_ARGS)
+ *
+ *   DBUS_TYPED_METHOD_IMPL(frame_set_rate) {
+ *       ... in->refresh_mhz ...
+ *       return true;
+ *   }
+ *
+ *   interface_add_typed_method(iface, "SetRefreshRate", &frame_set_rate_desc, scheduler);
+ */
+
+#define DBUS_CTYPE_BYTE         unsigned char
+#define DBUS_CTYPE_BOOLEAN      dbus_bool_t
+#define DBUS_CTYPE_INT16        dbus_int16_t
+#define DBUS_CTYPE_UINT16       dbus_uint16_t
+#define DBUS_CTYPE_INT32        dbus_int32_t
+#define DBUS_CTYPE_UINT32       dbus_uint32_t
+#define DBUS_CTYPE_INT64        dbus_int64_t
+#define DBUS_CTYPE_UINT64       dbus_uint64_t
+#define DBUS_CTYPE_DOUBLE       double
+#define DBUS_CTYPE_STRING       const char *
+#define DBUS_CTYPE_OBJECT_PATH  const char *
+#define DBUS_CTYPE_UNIX_FD      int
+
+/* Argument table for a method without arguments in that direction */
+#define DBUS_NO_ARGS(A)
+
+#define DBUS_ARG_FIELD(type, name)      DBUS_CTYPE_##type name;
+#define DBUS_ARG_SIGNATURE(type, name)  DBUS_TYPE_##type##_AS_STRING
+#define DBUS_ARG_DESC_IN(type, name)    { #name, DBUS_TYPE_##type##_AS_STRING, true },
+#define DBUS_ARG_DESC_OUT(type, name)   { #name, DBUS_TYPE_##type##_AS_STRING, false },
+#define DBUS_ARG_READ(type, name) \
+    dbus_message_iter_get_basic(&iter, &args->name); \
+    dbus_message_iter_next(&iter);
+#define DBUS_ARG_WRITE(type, name) \
+    if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_##type, &args->name)) return false;
+
+/* Error reply of a typed handler, name NULL = DBUS_ERROR_FAILED */
+struct dbus_method_error {
+    const char *name;
+    const char *message;
+};
+
+/* Handler definition: returns false with *error set to reply with an error */
+#define DBUS_TYPED_METHOD_IMPL(fn) \
+    static bool fn(void *user_data, DBusMessage *msg, const struct fn##_in *in, \
+                   struct fn##_out *out, struct dbus_method_error *error)
+
+#define DBUS_TYPED_METHOD(fn, IN, OUT) \
+    struct fn##_in { IN(DBUS_ARG_FIELD) char end_; }; \
+    struct fn##_out { OUT(DBUS_ARG_FIELD) char end_; }; \
+    DBUS_TYPED_METHOD_IMPL(fn); \
+    static void fn##_read(DBusMessage *msg, struct fn##_in *args) { \
+        DBusMessageIter iter; \
+        dbus_message_iter_init(msg, &iter); \
+        IN(DBUS_ARG_READ) \
+    } \
+    static bool fn##_write(DBusMessage *reply, const struct fn##_out *args) { \
+        DBusMessageIter iter; \
+        dbus_message_iter_init_append(reply, &iter); \
+        OUT(DBUS_ARG_WRITE) \
+        return true; \
+    } \
+    static DBusHandlerResult fn##_dispatch(DBusConnection *conn, DBusMessage *msg, void *user_data) { \
+        struct fn##_in in = {0}; \
+        struct fn##_out out = {0}; \
+        struct dbus_method_error error = { NULL, NULL }; \
+        fn##_read(msg, &in); \
+        if (!fn(user_data, msg, &in, &out, &error)) { \
+            return dbus_typed_method_send_error(conn, msg, &error); \
+        } \
+        if (dbus_message_get_no_reply(msg)) return DBUS_HANDLER_RESULT_HANDLED; \
+        DBusMessage *reply = dbus_message_new_method_return(msg); \
+        if (!reply || !fn##_write(reply, &out)) { \
+            if (reply) dbus_message_unref(reply); \
+            return DBUS_HANDLER_RESULT_NEED_MEMORY; \
+        } \
+        dbus_connection_send(conn, reply, NULL); \
+        dbus_message_unref(reply); \
+        return DBUS_HANDLER_RESULT_HANDLED; \
+    } \
+    static const struct dbus_arg_desc fn##_args[] = { \
+        IN(DBUS_ARG_DESC_IN) OUT(DBUS_ARG_DESC_OUT) { NULL, NULL, false } \
+    }; \
+    static const struct dbus_method_desc fn##_desc = { \
+        "" IN(DBUS_ARG_SIGNATURE), "" OUT(DBUS_ARG_SIGNATURE), fn##_args, fn##_dispatch \
+    };
+
+DBusHandlerResult dbus_typed_method_send_error(DBusConnection *conn, DBusMessage *msg,
+                                               const struct dbus_method_error *error);
+
+#endif
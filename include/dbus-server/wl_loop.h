@@ -0,0 +1,32 @@
+#ifndef DBUS_WL_LOOP_H
+#define DBUS_WL_LOOP_H
+
+#include <dbus/dbus.h>
+#include <wayland-server.h>
+#include <stdbool.h>
+
+struct dbus_server;
+
+/*
+ * Single-threaded mode: the connection's watches and timeouts live on the
+ * Wayland event loop, so wl_display_run dispatches both protocols and no
+ * D-Bus thread (or locking) is involved. Alternative to dbus_start_main_loop.
+ */
+struct dbus_wl_loop {
+    struct dbus_server *server;
+    struct wl_event_loop *loop;
+    struct wl_event_source *outbound_source;    /* Disabled while libdbus has a backlog */
+    struct wl_event_source *dispatch_idle;      /* Pending when messages wait to be handled */
+};
+
+/* One per DBusWatch / DBusTimeout, kept in their data slot */
+struct dbus_wl_source {
+    struct dbus_wl_loop *wl_loop;
+    struct wl_event_source *source;
+    void *object;                   /* DBusWatch or DBusTimeout */
+};
+
+struct dbus_wl_loop *dbus_wl_loop_create(struct dbus_server *server, struct wl_event_loop *loop);
+void dbus_wl_loop_destroy(struct dbus_wl_loop *wl_loop);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef DBUS_WORKER_POOL_H
+#define DBUS_WORKER_POOL_H
+
+#include <dbus-server/module-lib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define DBUS_WORKER_THREADS 2
+#define DBUS_WORKER_QUEUE 64            /* Calls per worker, power of two */
+
+struct dbus_server;
+
+struct dbus_deferred_reply {
+    struct dbus_server *server;
+    DBusMessage *call;
+};
+
+struct dbus_worker_task {
+    DBUS_WORKER_HANDLER handler;
+    void *user_data;
+    DBUS_DEFERRED_REPLY *reply;
+};
+
+struct dbus_worker {
+    struct dbus_worker_pool *pool;
+    pthread_t thread;
+    pthread_mutex_t mutex;          /* Owner and thieves */
+    size_t head, tail;              /* Free-running, FIFO */
+    struct dbus_worker_task tasks[DBUS_WORKER_QUEUE];
+};
+
+/*
+ * Small pool for DBUS_METHOD_WORKER handlers. Calls are spread round-robin
+ * over per-worker queues, idle workers steal from the others. Replies are
+ * queued on the server's outbound queue and sent by the connection thread.
+ */
+struct dbus_worker_pool {
+    struct dbus_server *server;
+    sem_t wake;                     /* One post per submitted call */
+    atomic_bool stopping;
+    unsigned int next;              /* Round-robin start, submit side only */
+    size_t n_workers;
+    struct dbus_worker workers[DBUS_WORKER_THREADS];
+};
+
+struct dbus_worker_pool *dbus_worker_pool_create(struct dbus_server *server);
+/* Joins the workers, calls not started yet are dropped without a reply */
+void dbus_worker_pool_destroy(struct dbus_worker_pool *pool);
+
+/* Connection thread: false when every queue is full (message untouched) */
+bool dbus_worker_pool_submit(struct dbus_worker_pool *pool, DBUS_WORKER_HANDLER handler,
+                             void *user_data, DBusMessage *message);
+
+/* Any thread, exactly once per call: send response (NULL = empty return) and free the handle */
+void dbus_deferred_reply_send(DBUS_DEFERRED_REPLY *reply, DBusMessage *response);
+void dbus_deferred_reply_error(DBUS_DEFERRED_REPLY *reply, const char *error_name, const char *error_message);
+
+#endif
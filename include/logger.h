@@ -9,6 +9,9 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <logger_format.h>
 
 typedef enum {
     LOG_LEVEL_DEBUG,
@@ -21,7 +24,8 @@ typedef enum {
 typedef enum {
     LOG_MODULE_SERVER,
     LOG_MODULE_DBUS,
-    LOG_MODULE_CORE
+    LOG_MODULE_CORE,
+    LOG_MODULE_COUNT
 } log_module_t;
 
 typedef enum {
@@ -36,39 +40,166 @@ typedef enum {
     LOG_COLOR_BRIGHT_RED = 91
 } log_color_t;
 
+#define LOGGER_MAX_MESSAGE 1024
+#define LOGGER_RING_SIZE (256 * 1024)   /* Bytes, power of two */
+
+// Что делать, когда кольцевой буфер заполнен
+typedef enum {
+    LOG_OVERFLOW_DROP,      // Отбросить и посчитать
+    LOG_OVERFLOW_BLOCK,     // Ждать, пока рабочий поток освободит место
+    LOG_OVERFLOW_SYNC       // Записать синхронно в вызывающем потоке
+} log_overflow_t;
+
+// Место вызова макроса: одно статическое на каждый LOG_*
 typedef struct {
     log_level_t level;
     log_module_t module;
     const char* file;
     int line;
     const char* function;
-    time_t timestamp;
-    char message[1024];
+    atomic_int state;           // LOG_SITE_*
+    const char* format;         // Формат, для которого разобраны args
+    uint8_t n_args;
+    uint8_t args[LOG_FORMAT_MAX_ARGS];
+    uint32_t binary_id;         // Номер в бинарном файле, 0 - еще не записан
+    uint32_t binary_generation; // Файл, в который записано описание (ротация)
+} log_site_t;
+
+enum {
+    LOG_SITE_UNPARSED,
+    LOG_SITE_PARSING,
+    LOG_SITE_DEFERRED,          // Аргументы копируются, форматирует рабочий поток
+    LOG_SITE_TEXT               // Формат не поддерживается, vsnprintf на месте
+};
+
+// Необязательные поля структурированного вывода (JSON, journald), 0 - нет
+typedef struct {
+    int32_t client_pid;         // pid wl_client
+    uint32_t surface_id;
+    uint32_t buffer_id;
+} log_fields_t;
+
+// Запись в кольцевом буфере: длина текста переменная
+typedef struct {
+    log_level_t level;
+    log_module_t module;
+    const char* file;
+    int line;
+    const char* function;
+    uint64_t timestamp;         // CLOCK_MONOTONIC, нс, на месте вызова
+    uint32_t thread_id;         // gettid() вызывающего потока
+    log_fields_t fields;        // logger_set_fields вызывающего потока
+    log_site_t* site;           // NULL для logger_log
+    const char* format;         // NULL: message - готовый текст, иначе упакованные аргументы
+    size_t length;
+    char message[];
 } log_message_t;
 
+// Время в текстовом выводе
+typedef enum {
+    LOG_TIMESTAMP_LOCAL,        // Локальное время с микросекундами
+    LOG_TIMESTAMP_RAW           // CLOCK_MONOTONIC в наносекундах
+} log_timestamp_t;
+
+// Формат файла лога
+typedef enum {
+    LOG_FILE_TEXT,
+    LOG_FILE_BINARY,            // Для desktop_engine_log_decode
+    LOG_FILE_JSON               // JSON lines, по объекту на сообщение
+} log_file_format_t;
+
 typedef struct {
     log_level_t level;
+    int module_levels[LOG_MODULE_COUNT];   // -1: как level
     int use_colors;
     int log_to_file;
     int log_to_console;
     int async_enabled;
     int flush_immediately;
+    log_overflow_t overflow_policy;
+    log_file_format_t file_format;
+    log_timestamp_t timestamp_format;
+    uint64_t rotate_size;       // Байт, 0 - без ротации по размеру
+    int rotate_age;             // Секунд, 0 - без ротации по времени
+    int rotate_keep;            // Старых файлов: path.1 ... path.N
+    int sync_interval_ms;       // fdatasync не реже, 0 - не вызывать
     char log_file_path[256];
+    int log_to_journal;         // Нативный протокол journald
+    char journal_socket_path[108];
 } logger_config_t;
 
 extern volatile sig_atomic_t g_logger_graceful_shutdown;
 
+// Текущий уровень каждого модуля, меняется на лету (D-Bus модуль Logging)
+extern atomic_int g_logger_module_levels[LOG_MODULE_COUNT];
+
 int logger_init(const logger_config_t* config);
 void logger_cleanup(void);
 void logger_log(log_level_t level, log_module_t module, const char* file, int line, 
                 const char* function, const char* format, ...);
+void logger_log_site(log_site_t* site, const char* format, ...);
+
+// Поля для следующих сообщений текущего потока, NULL - сбросить
+void logger_set_fields(const log_fields_t* fields);
+
+// Время места вызова: одно чтение CLOCK_MONOTONIC
+static inline uint64_t logger_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void logger_set_module_level(log_module_t module, log_level_t level);
+log_level_t logger_get_module_level(log_module_t module);
+const char* logger_level_name(log_level_t level);
+const char* logger_module_name(log_module_t module);
+
+// Минимальный уровень на этапе компиляции: meson -Dlog_min_level (0 - debug ... 4 - fatal)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// Проверка до вычисления аргументов
+#define LOG_ENABLED(log_level, log_module) \
+    ((int)(log_level) >= atomic_load_explicit(&g_logger_module_levels[log_module], memory_order_relaxed))
+
+// Log macros: статическое описание места вызова + logger_log_site
+#define LOG_AT(log_level, log_module, ...) do { \
+        if (LOG_ENABLED(log_level, log_module)) { \
+            static log_site_t log_site_ = { .level = log_level, .module = log_module, \
+                                            .file = __FILE__, .line = __LINE__, .function = __func__ }; \
+            logger_log_site(&log_site_, __VA_ARGS__); \
+        } \
+    } while (0)
+
+// Вызовы ниже LOG_MIN_LEVEL исчезают целиком, FATAL остается всегда
+#define LOG_DISCARD(...) do { } while (0)
+
+#if LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(module, ...) LOG_AT(LOG_LEVEL_DEBUG, module, __VA_ARGS__)
+#else
+#define LOG_DEBUG(module, ...) LOG_DISCARD()
+#endif
+
+#if LOG_MIN_LEVEL <= 1
+#define LOG_INFO(module, ...)  LOG_AT(LOG_LEVEL_INFO, module, __VA_ARGS__)
+#else
+#define LOG_INFO(module, ...)  LOG_DISCARD()
+#endif
+
+#if LOG_MIN_LEVEL <= 2
+#define LOG_WARN(module, ...)  LOG_AT(LOG_LEVEL_WARN, module, __VA_ARGS__)
+#else
+#define LOG_WARN(module, ...)  LOG_DISCARD()
+#endif
+
+#if LOG_MIN_LEVEL <= 3
+#define LOG_ERROR(module, ...) LOG_AT(LOG_LEVEL_ERROR, module, __VA_ARGS__)
+#else
+#define LOG_ERROR(module, ...) LOG_DISCARD()
+#endif
 
-// Log macros
-#define LOG_DEBUG(module, ...) logger_log(LOG_LEVEL_DEBUG, module, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_INFO(module, ...)  logger_log(LOG_LEVEL_INFO, module, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_WARN(module, ...)  logger_log(LOG_LEVEL_WARN, module, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_ERROR(module, ...) logger_log(LOG_LEVEL_ERROR, module, __FILE__, __LINE__, __func__, __VA_ARGS__)
-#define LOG_FATAL(module, ...) logger_log(LOG_LEVEL_FATAL, module, __FILE__, __LINE__, __func__, __VA_ARGS__)
+#define LOG_FATAL(module, ...) LOG_AT(LOG_LEVEL_FATAL, module, __VA_ARGS__)
 
 // Server log macros
 #define SERVER_DEBUG(...)    LOG_DEBUG(LOG_MODULE_SERVER, __VA_ARGS__)
@@ -0,0 +1,80 @@
+#ifndef LOGGER_FORMAT_H
+#define LOGGER_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Deferred printf formatting. A format string is parsed once into argument
+ * types; each call only copies the raw values (strings by content) into a
+ * packed buffer, which is rendered later by the logger worker or by the
+ * offline decoder. Values are stored in host byte order:
+ *
+ *   integers, pointers   8 bytes
+ *   double               8 bytes
+ *   long double          sizeof(long double)
+ *   strings              uint32_t length (UINT32_MAX for NULL), the bytes, NUL
+ *
+ * %n and %s with a precision (the string need not be NUL-terminated) are not
+ * supported; formats containing them are logged as plain text.
+ */
+
+#define LOG_FORMAT_MAX_ARGS 16
+
+typedef enum {
+    LOG_ARG_INT,            /* int and everything promoted to it, '*' */
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_INTMAX,
+    LOG_ARG_SIZE,
+    LOG_ARG_PTRDIFF,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_LDOUBLE,
+    LOG_ARG_STRING,
+    LOG_ARG_POINTER
+} log_arg_type_t;
+
+/* Argument types in order, -1 when unsupported or more than max */
+int log_format_parse(const char *format, uint8_t *types, size_t max);
+
+/* Copy the arguments described by types into out, returns the packed size */
+size_t log_format_pack(const uint8_t *types, size_t n_types, va_list args, uint8_t *out, size_t size);
+
+/* printf of format with packed arguments, returns the length written (excluding NUL) */
+size_t log_format_render(const char *format, const uint8_t *packed, size_t length, char *out, size_t size);
+
+/*
+ * Binary log file: LOG_BINARY_MAGIC, then records. A site record (file,
+ * function and format, NUL-separated) precedes the first event that uses
+ * its id; events carry packed arguments, text records preformatted text.
+ */
+
+#define LOG_BINARY_MAGIC "DELOGBIN"
+#define LOG_BINARY_VERSION 2
+
+enum {
+    LOG_BINARY_SITE = 1,
+    LOG_BINARY_EVENT = 2,
+    LOG_BINARY_TEXT = 3
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pointer_size;          /* Decoder must run on the same ABI */
+} log_binary_header_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t level;
+    uint8_t module;
+    uint8_t reserved;
+    uint32_t id;                    /* Site id, sites and events */
+    int64_t timestamp;              /* CLOCK_REALTIME, ns */
+    int64_t monotonic;              /* CLOCK_MONOTONIC, ns */
+    uint32_t line;
+    uint32_t length;                /* Payload bytes that follow */
+} log_binary_record_t;
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef LOGGER_RING_H
+#define LOGGER_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_RING_ALIGN 16               /* Record granularity, == sizeof(log_ring_header_t) */
+
+enum {
+    LOG_RING_PAD = 0,                   /* Filler up to the end of the buffer */
+    LOG_RING_RECORD = 1,
+};
+
+typedef struct {
+    _Atomic uint32_t size;              /* Whole record, 0 until committed */
+    uint32_t kind;
+    uint32_t length;                    /* Payload bytes */
+    uint32_t reserved;
+} log_ring_header_t;
+
+/*
+ * Lock-free multi-producer, single-consumer byte ring of variable-length
+ * records. Producers reserve space with a CAS on head and commit by
+ * publishing the record size; the consumer reads records in reservation
+ * order and zeroes them before handing the space back. A record that does
+ * not fit before the end of the buffer is preceded by a LOG_RING_PAD record.
+ *
+ * The consumer sleeps on an eventfd; producers only write it when the
+ * consumer announced that it is about to sleep.
+ */
+typedef struct {
+    _Alignas(64) _Atomic uint64_t head; /* Next reservation, producers */
+    _Alignas(64) _Atomic uint64_t tail; /* First unread byte, consumer */
+    _Alignas(64) atomic_bool sleeping;
+    int event_fd;
+    size_t size;                        /* Power of two */
+    uint8_t *data;
+} log_ring_t;
+
+int log_ring_init(log_ring_t *ring, size_t size);
+void log_ring_destroy(log_ring_t *ring);
+
+/* Producers: payload space for length bytes, NULL when the ring is full */
+void *log_ring_reserve(log_ring_t *ring, size_t length);
+/* Producers: publish a reserved payload and wake the consumer if needed */
+void log_ring_commit(log_ring_t *ring, void *payload);
+
+/* Consumer: next committed record, NULL when empty or the next one is still being written */
+const log_ring_header_t *log_ring_peek(log_ring_t *ring);
+/* Consumer: give the space of the record returned by log_ring_peek back */
+void log_ring_release(log_ring_t *ring, const log_ring_header_t *header);
+/* Consumer: block until a producer commits, log_ring_kick or timeout_ms (-1 = none) */
+void log_ring_wait(log_ring_t *ring, int timeout_ms);
+
+/* Any thread: wake the consumer unconditionally */
+void log_ring_kick(log_ring_t *ring);
+
+static inline void *log_ring_payload(const log_ring_header_t *header) {
+    return (void *)(header + 1);
+}
+
+#endif
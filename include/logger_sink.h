@@ -0,0 +1,28 @@
+#ifndef LOGGER_SINK_H
+#define LOGGER_SINK_H
+
+#include <logger.h>
+
+#define LOGGER_BATCH_SIZE (64 * 1024)   // Буфер пакета на каждый вывод
+#define LOGGER_BATCH_LINES 256          // Строк консоли на один writev (3 iovec на строку)
+
+/*
+ * Вывод логгера: консоль, файл (текст, бинарный или JSON lines) и journald.
+ * Сообщения форматируются в пакет, log_sink_flush отдает каждому выводу один
+ * writev. Ротацию и fdatasync делает только log_sink_maintain - на рабочем
+ * потоке между сообщениями (без него - на вызывающем). journald получает по
+ * датаграмме на сообщение сразу. Все функции вызываются под мьютексом логгера.
+ */
+
+// config должен жить до log_sink_close; log_to_file сбрасывается, если файл не открылся
+void log_sink_open(logger_config_t* config);
+void log_sink_close(void);
+
+void log_sink_write(const log_message_t* message);
+void log_sink_flush(void);
+void log_sink_maintain(void);
+
+// Миллисекунды до следующей ротации или fdatasync, -1 - ждать нечего
+int log_sink_timeout_ms(void);
+
+#endif
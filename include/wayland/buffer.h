@@ -2,9 +2,13 @@
 #define BUFFER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <wayland-server.h>
 #include <drm/drm_fourcc.h>
 #include <wayland/shm.h>
+#include <wayland/buffer_ring.h>
+
+struct server;
 
 enum pixel_format {
     PIXEL_FORMAT_UNKNOWN = 0,
@@ -12,9 +16,25 @@ enum pixel_format {
     PIXEL_FORMAT_XRGB8888
 };
 
+#define BUFFER_DMABUF_MAX_PLANES 4
+
+/* linux-dmabuf import parameters, the buffer owns the fds once created */
+struct dmabuf_attributes {
+    int32_t width, height;
+    uint32_t format;        /* DRM_FORMAT_* */
+    uint32_t flags;         /* zwp_linux_buffer_params_v1 flags */
+    uint64_t modifier;      /* Same for every plane */
+    uint32_t num_planes;
+    int fd[BUFFER_DMABUF_MAX_PLANES];
+    uint32_t offset[BUFFER_DMABUF_MAX_PLANES];
+    uint32_t stride[BUFFER_DMABUF_MAX_PLANES];
+};
+
 struct buffer {
+    uint32_t id;                    /* Server-wide, stable for the buffer lifetime */
     uint32_t width, height;
     struct wl_resource *resource;
+    struct server *server;          /* For destroy notifications */
     struct wl_list link;
 
     enum wl_buffer_type {
@@ -25,29 +45,42 @@ struct buffer {
 
     union {
         struct {
-            void *data;
+            struct shm_pool *pool;  /* Referenced, see shm_buffer_get_data */
+            size_t offset;          /* Offset of the first pixel in the pool */
             uint32_t stride;
-            // uint32_t format;
+            uint32_t format;        /* WL_SHM_FORMAT_* */
             int fd;
         } shm;
-        struct {
-            int fd;
-            // uint32_t format;      // (DRM_FORMAT_*)
-            uint64_t modifier;    // format modifier
-            uint32_t stride;
-            uint32_t offset;
-            // uint32_t num_planes;
-        } dmabuf;
+        struct dmabuf_attributes dmabuf;
     };
 
     enum pixel_format format; 
     size_t size;
+
+    /* Release tracking (buffer_tracker.c) */
+    struct wl_list busy_link;
+    bool busy;
+    uint32_t busy_serial;
+    uint32_t pending_consumers;     /* consumer slots that did not ack busy_serial */
+    uint32_t ring_consumers;        /* consumer slots that got busy_serial over their ring */
+    uint64_t busy_deadline_ms;
+
+    /* Per ring channel slot: generation that already received the fds (buffer_ring.c) */
+    uint32_t ring_generation[BUFFER_RING_MAX_CHANNELS];
+    /* Consumer epoch the fds were last announced in over D-Bus, 0 = never */
+    uint32_t dbus_epoch;
 };
 
 enum pixel_format wl_shm_format_to_pixel_format(uint32_t wl_format);
 enum pixel_format drm_format_to_pixel_format(uint32_t drm_format);
 
-struct buffer *buffer_create_shm(struct wl_resource *resource, uint32_t id, int32_t offset, int32_t width, int32_t height, int32_t stride, uint32_t format, int fd);
-struct buffer *buffer_create_dmabuf(int fd, uint32_t width, uint32_t height, uint32_t drm_format, uint64_t modifier, uint32_t stride);
+struct buffer *buffer_create_shm(struct wl_resource *resource, struct shm_pool *pool, int32_t offset, int32_t width, int32_t height, int32_t stride, uint32_t format);
+
+/* Current pixel pointer of an SHM buffer (pool mapping may move on resize) */
+void *shm_buffer_get_data(const struct buffer *buffer);
+struct buffer *buffer_create_dmabuf(struct wl_resource *resource, const struct dmabuf_attributes *attribs);
+
+/* Wayland thread: consumers that know the id drop their mapping, called by the destructors */
+void buffer_publish_destroyed(struct server *server, struct buffer *buffer);
 
 #endif
\ No newline at end of file
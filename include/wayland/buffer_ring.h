@@ -0,0 +1,115 @@
+#ifndef BUFFER_RING_H
+#define BUFFER_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * Shared-memory transport for buffer updates. A consumer negotiates it once
+ * with Buffer.OpenRing and receives three fds:
+ *   - memfd: struct buffer_ring_header followed by `capacity` records (SPSC)
+ *   - SOCK_SEQPACKET socket: struct buffer_ring_fd_msg + SCM_RIGHTS, sent
+ *     the first time a buffer id shows up on the ring (before its record)
+ *   - eventfd: kicked after records are published
+ * Consumers keep the fds (and their mapping) per buffer id until a
+ * DESTROYED record for that id. Every consumer gets its own channel; a
+ * second OpenRing from the same consumer replaces its previous one.
+ * Buffer.Updated keeps going out while a subscriber was not reached over a
+ * ring, so ring consumers skip signals for serials they already have.
+ * The wire layout below is shared with consumers, bump the version on change.
+ */
+
+#define BUFFER_RING_MAGIC 0x42524544u  /* "DERB" */
+#define BUFFER_RING_VERSION 2
+#define BUFFER_RING_CAPACITY 256        /* records, power of two */
+#define BUFFER_RING_MAX_DAMAGE 16
+#define BUFFER_RING_MAX_FDS 4
+#define BUFFER_RING_MAX_CHANNELS 32     /* Consumers with an open ring */
+
+enum buffer_ring_record_kind {
+    BUFFER_RING_RECORD_UPDATE = 1,
+    BUFFER_RING_RECORD_DESTROYED = 2,   /* Only buffer_id is set */
+};
+
+enum buffer_ring_buffer_type {
+    BUFFER_RING_TYPE_SHM = 1,
+    BUFFER_RING_TYPE_DMABUF = 2,
+};
+
+struct buffer_ring_record {
+    uint32_t kind;                  /* enum buffer_ring_record_kind */
+    uint32_t surface_id;
+    uint32_t buffer_id;
+    uint32_t serial;                /* Ack with Buffer.Release */
+    uint32_t type;                  /* enum buffer_ring_buffer_type */
+    uint32_t format;                /* WL_SHM_FORMAT_* or DRM_FORMAT_* */
+    uint32_t width, height;
+    uint64_t modifier;
+    uint32_t n_planes;              /* Matches n_fds of the buffer */
+    uint32_t n_damage;              /* 0 = whole buffer */
+    uint32_t offset[BUFFER_RING_MAX_FDS];
+    uint32_t stride[BUFFER_RING_MAX_FDS];
+    int32_t damage[BUFFER_RING_MAX_DAMAGE][4]; /* x, y, width, height in buffer coords */
+};
+
+struct buffer_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+
+    /* Free-running indices, slot = index & (capacity - 1) */
+    _Alignas(64) _Atomic uint32_t head;    /* Producer */
+    _Alignas(64) _Atomic uint32_t tail;    /* Consumer */
+    _Alignas(64) uint8_t records[];
+};
+
+/* Socket message announcing the fds of a buffer id (one fd per plane) */
+struct buffer_ring_fd_msg {
+    uint32_t buffer_id;
+    uint32_t n_fds;
+};
+
+/* Server side */
+
+struct buffer;
+struct buffer_ring_channel;
+
+/* Opened and cancelled on the D-Bus thread, published into and closed on the Wayland thread */
+struct buffer_ring {
+    pthread_mutex_t mutex;
+    struct buffer_ring_channel *channels[BUFFER_RING_MAX_CHANNELS];    /* One per consumer */
+    uint32_t next_generation;
+};
+
+struct buffer_ring_fds {
+    int memfd;
+    int socket_fd;
+    int event_fd;
+};
+
+struct buffer_ring *buffer_ring_create(void);
+void buffer_ring_destroy(struct buffer_ring *ring);
+
+/* D-Bus thread: new channel of `consumer` (D-Bus unique name), replacing its
+ * previous one. Returns the channel generation, 0 on failure. The fds go to
+ * the consumer, the caller closes them after sending */
+uint32_t buffer_ring_open(struct buffer_ring *ring, const char *consumer, struct buffer_ring_fds *fds);
+/* D-Bus thread: withdraw the channel of a failed open reply, a no-op once it was replaced */
+void buffer_ring_cancel(struct buffer_ring *ring, uint32_t generation);
+/* Any thread: the consumer left the bus */
+void buffer_ring_close(struct buffer_ring *ring, const char *consumer);
+
+/* Wayland thread: push the record to every channel with room, false when none took it */
+bool buffer_ring_publish(struct buffer_ring *ring, struct buffer *buffer,
+                         const struct buffer_ring_record *record);
+/* Wayland thread: whether the last publish of serial reached the consumer's channel */
+bool buffer_ring_delivered(struct buffer_ring *ring, const char *consumer, uint32_t serial);
+
+/* Wayland thread: false when a channel knew the buffer but its ring is full */
+bool buffer_ring_publish_destroyed(struct buffer_ring *ring, struct buffer *buffer);
+
+#endif
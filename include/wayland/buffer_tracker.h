@@ -0,0 +1,80 @@
+#ifndef BUFFER_TRACKER_H
+#define BUFFER_TRACKER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <wayland-server.h>
+
+#define BUFFER_TRACKER_MAX_CONSUMERS 32
+#define BUFFER_TRACKER_NAME_MAX 128
+#define BUFFER_TRACKER_QUEUE_SIZE 256
+#define BUFFER_TRACKER_RELEASE_TIMEOUT_MS 500
+
+struct server;
+struct buffer;
+
+enum buffer_tracker_event_type {
+    BUFFER_TRACKER_SUBSCRIBE,
+    BUFFER_TRACKER_UNSUBSCRIBE,
+    BUFFER_TRACKER_ACK,
+    BUFFER_TRACKER_DROPPED,         /* serial was superseded before reaching consumers */
+    BUFFER_TRACKER_GONE             /* consumer left the bus: unsubscribe and close its ring */
+};
+
+struct buffer_tracker_event {
+    enum buffer_tracker_event_type type;
+    uint32_t serial;
+    char sender[BUFFER_TRACKER_NAME_MAX];
+};
+
+/*
+ * wl_buffer release tracking. A committed buffer stays busy until every
+ * subscribed consumer acked its serial (or its release deadline passed),
+ * then wl_buffer.release is sent. A late consumer stays subscribed, it is
+ * removed on Unsubscribe or when it leaves the bus. Lives on the Wayland thread, consumer
+ * events come from the D-Bus thread through a small locked queue + eventfd.
+ */
+struct buffer_tracker {
+    struct server *server;
+
+    struct wl_list busy;                /* struct buffer.busy_link */
+    uint32_t next_serial;
+
+    char consumers[BUFFER_TRACKER_MAX_CONSUMERS][BUFFER_TRACKER_NAME_MAX];
+    uint32_t consumer_mask;             /* occupied slots of consumers[] */
+    uint32_t late_mask;                 /* missed a deadline and did not ack since */
+    uint32_t consumer_epoch;            /* Bumped on subscribe, buffers re-announce their fds */
+
+    struct wl_event_source *timeout_source;
+
+    /* D-Bus thread -> Wayland thread */
+    pthread_mutex_t queue_mutex;
+    struct buffer_tracker_event queue[BUFFER_TRACKER_QUEUE_SIZE];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    int event_fd;
+    struct wl_event_source *event_source;
+};
+
+struct buffer_tracker *buffer_tracker_create(struct server *server);
+void buffer_tracker_destroy(struct buffer_tracker *tracker);
+
+/* Wayland thread: buffer was committed and is handed to consumers, returns its serial */
+uint32_t buffer_tracker_mark_busy(struct buffer_tracker *tracker, struct buffer *buffer);
+
+/* Wayland thread: serial never reached the D-Bus consumers, stop waiting for them */
+void buffer_tracker_drop(struct buffer_tracker *tracker, uint32_t serial);
+
+/* Wayland thread: after a ring publish of the buffer's serial, whether a subscribed
+ * consumer was not reached and needs the Updated signal */
+bool buffer_tracker_needs_signal(struct buffer_tracker *tracker, struct buffer *buffer);
+
+/* Wayland thread: buffer is being destroyed */
+void buffer_tracker_forget(struct buffer *buffer);
+
+/* Any thread: consumer events (sender is the D-Bus unique name) */
+void buffer_tracker_push_event(struct buffer_tracker *tracker, enum buffer_tracker_event_type type,
+                               const char *sender, uint32_t serial);
+
+#endif
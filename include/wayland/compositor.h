@@ -4,8 +4,14 @@
 #include <stdint.h>
 #include <wayland-server.h>
 
+struct surface;
+
 void bind_compositor(struct wl_client *client, void *data, uint32_t version, uint32_t id);
 
+/* Surface lifecycle (compositor_surface.c) */
+void surface_init_state(struct surface *surface);
+void surface_resource_destroy(struct wl_resource *resource);
+
 extern const struct wl_surface_interface surface_implementation;
 
 #endif
\ No newline at end of file
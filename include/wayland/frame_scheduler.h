@@ -0,0 +1,54 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <wayland-server.h>
+
+#define FRAME_SCHEDULER_DEFAULT_REFRESH 60
+
+struct server;
+
+/*
+ * Virtual vblank source on the wl_display event loop. Pending wl_surface.frame
+ * callbacks are batched and sent once per vblank to presented surfaces only.
+ * refresh_mhz == 0 means vblanks come from renderer presentation feedback.
+ *
+ * "Presented" is approximated as "has a committed buffer" in both modes: the
+ * renderer's Presented call carries no surface, so there is no per-surface
+ * presentation state. A mapped surface the renderer never draws (occluded,
+ * off-screen) still gets its callbacks at the vblank rate.
+ */
+struct frame_scheduler {
+    struct server *server;
+
+    int timer_fd;
+    struct wl_event_source *timer_source;
+    bool armed;
+    uint64_t interval_ns;
+    uint32_t refresh_mhz;
+
+    /* Cross-thread requests (D-Bus thread -> Wayland thread) */
+    int event_fd;
+    struct wl_event_source *event_source;
+    atomic_uint requested_refresh_mhz;
+    atomic_uint presented;
+
+    uint64_t vblank_count;
+};
+
+struct frame_scheduler *frame_scheduler_create(struct server *server);
+void frame_scheduler_destroy(struct frame_scheduler *scheduler);
+
+/* Wayland thread: a commit queued frame callbacks */
+void frame_scheduler_schedule(struct frame_scheduler *scheduler);
+
+/* Wayland thread: change refresh rate in Hz (0 = presentation feedback driven) */
+void frame_scheduler_set_refresh_rate(struct frame_scheduler *scheduler, uint32_t refresh_hz);
+
+/* Any thread: thread-safe requests, applied on the Wayland thread */
+void frame_scheduler_request_refresh_mhz(struct frame_scheduler *scheduler, uint32_t refresh_mhz);
+void frame_scheduler_notify_presented(struct frame_scheduler *scheduler);
+
+#endif
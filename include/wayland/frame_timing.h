@@ -0,0 +1,134 @@
+#ifndef FRAME_TIMING_H
+#define FRAME_TIMING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <wayland-server.h>
+
+#define FRAME_TIMING_MAX_SURFACES 32    /* Surfaces beyond this are not measured */
+#define FRAME_TIMING_IN_FLIGHT 16       /* Frames per surface awaiting later stamps, power of two */
+#define FRAME_TIMING_DEFAULT_DUMP 60    /* Seconds between log dumps */
+
+/*
+ * Log-linear (HDR-style) buckets over nanoseconds: values below 16 are
+ * exact, above that every power of two is split into 16 buckets (~6%
+ * precision). Values from 2^36 ns (~68 s) land in the last bucket.
+ */
+#define FRAME_HISTOGRAM_SUB_BITS 4
+#define FRAME_HISTOGRAM_MAX_BITS 36
+#define FRAME_HISTOGRAM_BUCKETS ((FRAME_HISTOGRAM_MAX_BITS - FRAME_HISTOGRAM_SUB_BITS + 1) << FRAME_HISTOGRAM_SUB_BITS)
+
+struct server;
+
+/* Points in the life of one surface update, CLOCK_MONOTONIC */
+enum frame_stamp {
+    FRAME_STAMP_ATTACH,         /* wl_surface.attach */
+    FRAME_STAMP_COMMIT,         /* wl_surface.commit */
+    FRAME_STAMP_ENQUEUE,        /* Buffer ring record or D-Bus signal queued */
+    FRAME_STAMP_SEND,           /* Ring: same as ENQUEUE, D-Bus: handed to the connection */
+    FRAME_STAMP_RECEIVE,        /* Renderer side, reported with Metrics.Report */
+    FRAME_STAMP_UPLOAD,
+    FRAME_STAMP_PRESENT,
+    FRAME_STAMP_COUNT
+};
+
+/* Histogram per interval: stage N ends at stamp N + 1, TOTAL is commit -> present */
+enum frame_stage {
+    FRAME_STAGE_ATTACH_COMMIT,
+    FRAME_STAGE_COMMIT_ENQUEUE,
+    FRAME_STAGE_ENQUEUE_SEND,
+    FRAME_STAGE_SEND_RECEIVE,
+    FRAME_STAGE_RECEIVE_UPLOAD,
+    FRAME_STAGE_UPLOAD_PRESENT,
+    FRAME_STAGE_TOTAL,
+    FRAME_STAGE_COUNT
+};
+
+struct frame_histogram {
+    _Atomic uint32_t buckets[FRAME_HISTOGRAM_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t max;
+};
+
+struct frame_timing_frame {
+    _Atomic uint32_t serial;                        /* buffer_tracker serial, 0 = free */
+    _Atomic uint64_t stamps[FRAME_STAMP_COUNT];     /* 0 = not reached */
+    _Atomic uint32_t recorded;                      /* FRAME_STAGE_* bits already in the histograms */
+};
+
+struct frame_timing_surface {
+    _Atomic uint32_t surface_id;    /* 0 = free slot */
+
+    /* Wayland thread only */
+    uint64_t attach_ns;             /* Last attach not committed yet */
+    uint32_t next_frame;
+
+    struct frame_timing_frame frames[FRAME_TIMING_IN_FLIGHT];
+    struct frame_histogram stages[FRAME_STAGE_COUNT];
+};
+
+/* Percentiles of one histogram, in nanoseconds */
+struct frame_timing_summary {
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t max;
+};
+
+/*
+ * Per-surface frame timing. Stamps are lock-free (one clock read, a few
+ * atomics, no allocation) so the instrumentation stays enabled in
+ * production. Slots are claimed and released on the Wayland thread, stamps
+ * and reads may come from any thread; a reader racing a reset only sees
+ * slightly stale counts.
+ */
+struct frame_timing {
+    struct server *server;
+
+    struct wl_event_source *dump_source;
+    int dump_interval_ms;           /* 0 = no periodic log dump */
+
+    struct frame_timing_surface surfaces[FRAME_TIMING_MAX_SURFACES];
+};
+
+static inline uint64_t frame_timing_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+struct frame_timing *frame_timing_create(struct server *server);
+void frame_timing_destroy(struct frame_timing *timing);
+
+/* Wayland thread: log every surface's percentiles every `seconds` (0 = off) */
+void frame_timing_set_dump_interval(struct frame_timing *timing, int seconds);
+
+/* Wayland thread: slot of a new surface, NULL when all slots are taken */
+struct frame_timing_surface *frame_timing_surface_acquire(struct frame_timing *timing, uint32_t surface_id);
+void frame_timing_surface_release(struct frame_timing_surface *surface);
+
+/* Wayland thread: stamps before and at commit, NULL surface is a no-op */
+void frame_timing_attach(struct frame_timing_surface *surface, uint64_t now);
+void frame_timing_commit(struct frame_timing_surface *surface, uint32_t serial, uint64_t now);
+
+/* Any thread: later stamp of a committed frame, false when it is no longer tracked.
+ * Stamps may arrive out of order, each interval is recorded once both ends are set */
+bool frame_timing_stamp(struct frame_timing_surface *surface, uint32_t serial, enum frame_stamp stamp, uint64_t ns);
+bool frame_timing_stamp_surface(struct frame_timing *timing, uint32_t surface_id, uint32_t serial,
+                                enum frame_stamp stamp, uint64_t ns);
+
+/* Any thread: readers for the Metrics D-Bus module */
+bool frame_timing_summary(struct frame_timing *timing, uint32_t surface_id, enum frame_stage stage,
+                          struct frame_timing_summary *summary);
+/* Surface ids with a slot, returns how many were written */
+uint32_t frame_timing_surfaces(struct frame_timing *timing, uint32_t *ids, uint32_t max);
+/* Clear the histograms of one surface, 0 = all */
+bool frame_timing_reset(struct frame_timing *timing, uint32_t surface_id);
+
+const char *frame_timing_stage_name(enum frame_stage stage);
+int frame_timing_stage_from_name(const char *name);
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef LINUX_DMABUF_H
+#define LINUX_DMABUF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <wayland-server.h>
+
+#define LINUX_DMABUF_VERSION 4
+#define LINUX_DMABUF_MAX_TRANCHES 4
+#define LINUX_DMABUF_TABLE_MAX 64
+
+/* Advertised as main/target device when present, dev_t 0 otherwise */
+#define LINUX_DMABUF_RENDER_NODE "/dev/dri/renderD128"
+
+struct server;
+
+struct linux_dmabuf_format_modifier {
+    uint32_t format;        /* DRM_FORMAT_* */
+    uint64_t modifier;      /* DRM_FORMAT_MOD_* */
+};
+
+/* Renderer supplied tranche, pairs missing from the format table are dropped */
+struct linux_dmabuf_tranche_request {
+    uint32_t flags;         /* zwp_linux_dmabuf_feedback_v1 tranche_flags */
+    uint32_t n_formats;
+    struct linux_dmabuf_format_modifier formats[LINUX_DMABUF_TABLE_MAX];
+};
+
+/* Per-surface feedback update, D-Bus thread -> Wayland thread */
+struct linux_dmabuf_feedback_request {
+    struct wl_list link;
+    uint32_t surface_id;
+    uint32_t n_tranches;    /* 0 = back to the default feedback */
+    struct linux_dmabuf_tranche_request tranches[LINUX_DMABUF_MAX_TRANCHES];
+};
+
+struct linux_dmabuf_tranche {
+    dev_t target_device;
+    uint32_t flags;
+    uint32_t n_indices;
+    uint16_t indices[LINUX_DMABUF_TABLE_MAX];   /* into the format table */
+};
+
+struct linux_dmabuf_feedback {
+    uint32_t n_tranches;
+    struct linux_dmabuf_tranche tranches[LINUX_DMABUF_MAX_TRANCHES];
+};
+
+/*
+ * zwp_linux_dmabuf_v1 global. The format table is built once into a sealed
+ * memfd shared by every feedback object; surfaces use the default feedback
+ * unless the renderer overrides their tranches over D-Bus.
+ */
+struct linux_dmabuf {
+    struct server *server;
+    struct wl_global *global;
+
+    dev_t main_device;
+
+    int table_fd;
+    uint32_t table_size;    /* bytes */
+    uint32_t table_len;     /* entries */
+    struct linux_dmabuf_format_modifier table[LINUX_DMABUF_TABLE_MAX];
+
+    struct linux_dmabuf_feedback default_feedback;
+    struct wl_list surface_overrides;   /* surface_feedback_override.link */
+    struct wl_list surface_feedbacks;   /* surface_feedback.link */
+
+    /* D-Bus thread -> Wayland thread */
+    pthread_mutex_t queue_mutex;
+    struct wl_list queue;               /* linux_dmabuf_feedback_request.link */
+    int event_fd;
+    struct wl_event_source *event_source;
+};
+
+struct linux_dmabuf *linux_dmabuf_create(struct server *server);
+void linux_dmabuf_destroy(struct linux_dmabuf *dmabuf);
+
+/* Format/modifier pairs consumers can import (linear, CPU mappable) */
+bool linux_dmabuf_format_supported(uint32_t format, uint64_t modifier);
+
+/* Any thread: replace a surface's feedback tranches, takes ownership of request */
+void linux_dmabuf_request_surface_feedback(struct linux_dmabuf *dmabuf,
+                                           struct linux_dmabuf_feedback_request *request);
+
+#endif
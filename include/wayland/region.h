@@ -0,0 +1,38 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Upper bound of boxes kept per region, more collapse into the extents box */
+#define REGION_MAX_BOXES 16
+
+/* Half-open box: [x1, x2) x [y1, y2) */
+struct region_box {
+    int32_t x1, y1;
+    int32_t x2, y2;
+};
+
+/* Fixed-size union of boxes, never allocates */
+struct region {
+    uint32_t n_boxes;
+    struct region_box extents;
+    struct region_box boxes[REGION_MAX_BOXES];
+};
+
+void region_init(struct region *region);
+void region_clear(struct region *region);
+bool region_is_empty(const struct region *region);
+
+/* Union operations */
+void region_add_rect(struct region *region, int32_t x, int32_t y, int32_t width, int32_t height);
+void region_union(struct region *dst, const struct region *src);
+
+/* Clip region to a rectangle */
+void region_intersect_rect(struct region *region, int32_t x, int32_t y, int32_t width, int32_t height);
+
+/* Coordinate space conversion */
+void region_scale(struct region *region, int32_t scale);
+void region_transform(struct region *dst, const struct region *src, int32_t transform, int32_t width, int32_t height);
+
+#endif
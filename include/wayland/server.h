@@ -1,8 +1,18 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <stdbool.h>
 #include <wayland-server.h>
 #include <dbus-server/server.h>
+#include <wayland/region.h>
+
+struct buffer;
+struct frame_scheduler;
+struct buffer_tracker;
+struct linux_dmabuf;
+struct buffer_ring;
+struct frame_timing;
+struct frame_timing_surface;
 
 struct server {
     struct wl_display *display;
@@ -14,20 +24,63 @@ struct server {
 
     struct wl_list surfaces;
     struct wl_list shm_pools;
+    uint32_t next_surface_id;
 
     struct dbus_server *dbus_server;
+    struct frame_scheduler *frame_scheduler;
+    struct buffer_tracker *buffer_tracker;
+    struct buffer_ring *buffer_ring;
+    struct frame_timing *frame_timing;
+    struct linux_dmabuf *linux_dmabuf;      /* NULL without HAVE_LINUX_DMABUF */
+};
+
+/* Bits of surface_state.committed: which fields a wl_surface.commit carries */
+enum surface_state_field {
+    SURFACE_STATE_BUFFER    = 1 << 0,
+    SURFACE_STATE_DAMAGE    = 1 << 1,
+    SURFACE_STATE_SCALE     = 1 << 2,
+    SURFACE_STATE_TRANSFORM = 1 << 3,
+    SURFACE_STATE_OFFSET    = 1 << 4,
+};
+
+/* Double-buffered wl_surface state (pending -> current on commit) */
+struct surface_state {
+    uint32_t committed;             /* SURFACE_STATE_* set since last commit */
+
+    struct buffer *buffer;          /* NULL when detached */
+    struct wl_listener buffer_destroy;
+
+    struct region surface_damage;   /* wl_surface.damage, surface-local coords */
+    struct region buffer_damage;    /* wl_surface.damage_buffer, buffer coords.
+                                       In current: all damage of the commit */
+
+    int32_t dx, dy;                 /* attach / offset delta */
+    int32_t scale;
+    int32_t transform;              /* enum wl_output_transform */
+
+    int32_t width, height;          /* surface-local size, valid in current */
+
+    struct wl_list frame_callbacks; /* wl_callback resources (wl_resource_get_link) */
 };
 
 struct surface {
+    uint32_t id;                    /* Server-wide, identifies the surface to consumers */
     struct wl_resource *resource;
     struct wl_resource *xdg_surface;
     struct wl_resource *xdg_toplevel; 
     struct server *server;
     struct wl_list link;
+    struct frame_timing_surface *timing;    /* NULL when not measured */
+
+    struct surface_state pending;
+    struct surface_state current;
 };
 
 typedef struct server_config {
     char* startup_cmd;
+    int refresh_rate;   /* Virtual vblank rate in Hz, 0 = renderer presentation feedback */
+    bool dbus_inline;   /* Dispatch D-Bus from the Wayland event loop instead of a thread */
+    int metrics_interval; /* Frame timing log dump period in seconds, 0 = off */
 } server_config_t;
 
 void server_init(struct server *server);
@@ -2,17 +2,39 @@
 #define SHM_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <signal.h>
 #include <wayland-server.h>
 
+/* Refcounted: wl_shm_pool resource and every buffer created from it hold a ref */
 struct shm_pool {
-    struct wl_resource *resource;
+    struct wl_resource *resource;   /* NULL after wl_shm_pool.destroy */
+    struct wl_client *client;
+    struct server *server;
     struct wl_list link;
+    int refcount;
     int fd;                 
     size_t size;            
-    void *data;             
+    void *data;             /* May move on resize, buffers keep offsets */
     struct wl_list buffers;
+
+    /* Set by the SIGBUS handler, the mapping was replaced with zero pages */
+    volatile sig_atomic_t sigbus_fault;
 };
 
 void bind_shm(struct wl_client *client, void *data, uint32_t version, uint32_t id);
 
+struct shm_pool *shm_pool_ref(struct shm_pool *pool);
+void shm_pool_unref(struct shm_pool *pool);
+
+/*
+ * Guard direct reads of pool->data. A client truncating its fd makes the
+ * access SIGBUS; inside a begin/end pair the fault is absorbed (zero pages
+ * are mapped over the pool) and end_access returns false after posting a
+ * protocol error to the client (so end it on the Wayland thread). One pool
+ * per thread at a time, may nest.
+ */
+bool shm_pool_begin_access(struct shm_pool *pool);
+bool shm_pool_end_access(struct shm_pool *pool);
+
 #endif
\ No newline at end of file
@@ -5,16 +5,33 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <strings.h>
+#include <wayland/frame_timing.h>
+
+/* meson -Ddbus_inline=true */
+#ifndef DBUS_INLINE_DEFAULT
+#define DBUS_INLINE_DEFAULT 0
+#endif
 
 static void log_help(char **argv) {
     printf("Usage: %s [OPTIONS]\n", argv[0]);
     printf("Options:\n");
     printf("  --startup COMMAND   Startup command for server\n");
+    printf("  --refresh-rate HZ   Frame callback rate (0 = renderer presentation feedback)\n");
+    printf("  --metrics-interval S Log frame timing percentiles every S seconds (0 = off)\n");
+    printf("  --dbus-inline       Dispatch D-Bus on the Wayland thread\n");
+    printf("  --dbus-threaded     Dispatch D-Bus on its own thread\n");
     printf("  --log-config FILE   Load configuration from file\n");
     printf("  --log-level LEVEL   Set log level (debug, info, warn, error, fatal)\n");
+    printf("  --log-module M=LVL  Set the level of one module (server, dbus, core)\n");
     printf("  --log-file FILE     Log to specified file\n");
+    printf("  --log-binary        Write the log file in binary (desktop_engine_log_decode)\n");
+    printf("  --log-json          Write the log file as JSON lines\n");
+    printf("  --log-journal       Also log to journald (native protocol)\n");
+    printf("  --log-raw-time      Print CLOCK_MONOTONIC nanoseconds instead of local time\n");
     printf("  --no-colors         Disable colored output\n");
     printf("  --no-async          Disable asynchronous logging\n");
+    printf("  --log-overflow MODE Full log ring: drop, block or sync\n");
     printf("  --console-only      Log only to console\n");
     printf("  --file-only         Log only to file\n");
     printf("  --help              Show this help message\n");
@@ -24,14 +41,29 @@ static void log_help(char **argv) {
 void load_default_config(logger_config_t* logger_config, server_config_t* server_config) {
     /* Logger config*/
     logger_config->level = LOG_LEVEL_INFO;
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        logger_config->module_levels[i] = -1;
+    }
     logger_config->use_colors = 1;
     logger_config->log_to_file = 0;
     logger_config->log_to_console = 1;
     logger_config->async_enabled = 1;
     logger_config->flush_immediately = 0;
+    logger_config->overflow_policy = LOG_OVERFLOW_DROP;
+    logger_config->file_format = LOG_FILE_TEXT;
+    logger_config->timestamp_format = LOG_TIMESTAMP_LOCAL;
+    logger_config->rotate_size = 0;
+    logger_config->rotate_age = 0;
+    logger_config->rotate_keep = 5;
+    logger_config->sync_interval_ms = 0;
     strcpy(logger_config->log_file_path, "application.log");
+    logger_config->log_to_journal = 0;
+    strcpy(logger_config->journal_socket_path, "/run/systemd/journal/socket");
     /* Server config */
     server_config->startup_cmd = NULL;
+    server_config->refresh_rate = 60;
+    server_config->dbus_inline = DBUS_INLINE_DEFAULT;
+    server_config->metrics_interval = FRAME_TIMING_DEFAULT_DUMP;
 }
 
 static log_level_t parse_log_level(const char* level_str) {
@@ -43,6 +75,46 @@ static log_level_t parse_log_level(const char* level_str) {
     return LOG_LEVEL_INFO; // По умолчанию
 }
 
+static int parse_log_module(const char* module_str) {
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (strcasecmp(module_str, logger_module_name((log_module_t)i)) == 0) return i;
+    }
+    return -1;
+}
+
+/* "dbus=debug" */
+static void parse_module_level(const char* arg, logger_config_t* config) {
+    char module[32];
+    const char* level = strchr(arg, '=');
+    if (!level || (size_t)(level - arg) >= sizeof(module)) return;
+
+    memcpy(module, arg, (size_t)(level - arg));
+    module[level - arg] = '\0';
+
+    int index = parse_log_module(module);
+    if (index >= 0) {
+        config->module_levels[index] = parse_log_level(level + 1);
+    }
+}
+
+static log_overflow_t parse_overflow_policy(const char* policy_str) {
+    if (strcmp(policy_str, "block") == 0) return LOG_OVERFLOW_BLOCK;
+    if (strcmp(policy_str, "sync") == 0) return LOG_OVERFLOW_SYNC;
+    return LOG_OVERFLOW_DROP;
+}
+
+/* "64M", "512K", "1G" or bytes */
+static uint64_t parse_size(const char* size_str) {
+    char* end;
+    uint64_t size = strtoull(size_str, &end, 10);
+    switch (toupper((unsigned char)*end)) {
+        case 'G': size *= 1024;  /* fallthrough */
+        case 'M': size *= 1024;  /* fallthrough */
+        case 'K': size *= 1024;  break;
+    }
+    return size;
+}
+
 static int parse_boolean(const char* value) {
     if (strcmp(value, "true") == 0 || strcmp(value, "yes") == 0 || 
         strcmp(value, "1") == 0 || strcmp(value, "on") == 0) {
@@ -89,6 +161,9 @@ int logger_config_read(const char* config_path, logger_config_t* config) {
             if (strcmp(key, "log_level") == 0) {
                 config->level = parse_log_level(value);
             }
+            else if (strncmp(key, "log_level_", 10) == 0 && parse_log_module(key + 10) >= 0) {
+                config->module_levels[parse_log_module(key + 10)] = parse_log_level(value);
+            }
             else if (strcmp(key, "use_colors") == 0) {
                 config->use_colors = parse_boolean(value);
             }
@@ -107,6 +182,34 @@ int logger_config_read(const char* config_path, logger_config_t* config) {
             else if (strcmp(key, "flush_immediately") == 0) {
                 config->flush_immediately = parse_boolean(value);
             }
+            else if (strcmp(key, "overflow_policy") == 0) {
+                config->overflow_policy = parse_overflow_policy(value);
+            }
+            else if (strcmp(key, "file_format") == 0) {
+                config->file_format = strcmp(value, "binary") == 0 ? LOG_FILE_BINARY :
+                                      strcmp(value, "json") == 0 ? LOG_FILE_JSON : LOG_FILE_TEXT;
+            }
+            else if (strcmp(key, "log_to_journal") == 0) {
+                config->log_to_journal = parse_boolean(value);
+            }
+            else if (strcmp(key, "journal_socket") == 0) {
+                strncpy(config->journal_socket_path, value, sizeof(config->journal_socket_path) - 1);
+            }
+            else if (strcmp(key, "rotate_size") == 0) {
+                config->rotate_size = parse_size(value);
+            }
+            else if (strcmp(key, "rotate_age") == 0) {
+                config->rotate_age = atoi(value);
+            }
+            else if (strcmp(key, "rotate_keep") == 0) {
+                config->rotate_keep = atoi(value);
+            }
+            else if (strcmp(key, "sync_interval_ms") == 0) {
+                config->sync_interval_ms = atoi(value);
+            }
+            else if (strcmp(key, "timestamp_format") == 0) {
+                config->timestamp_format = strcmp(value, "raw") == 0 ? LOG_TIMESTAMP_RAW : LOG_TIMESTAMP_LOCAL;
+            }
         }
     }
     
@@ -122,16 +225,34 @@ void parse_args(int argc, char **argv, logger_config_t *logger_config, server_co
         else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
             logger_config->level = parse_log_level(argv[++i]);
         }
+        else if (strcmp(argv[i], "--log-module") == 0 && i + 1 < argc) {
+            parse_module_level(argv[++i], logger_config);
+        }
         else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
             strncpy(logger_config->log_file_path, argv[++i], sizeof(logger_config->log_file_path) - 1);
             logger_config->log_to_file = 1;
         }
+        else if (strcmp(argv[i], "--log-binary") == 0) {
+            logger_config->file_format = LOG_FILE_BINARY;
+        }
+        else if (strcmp(argv[i], "--log-json") == 0) {
+            logger_config->file_format = LOG_FILE_JSON;
+        }
+        else if (strcmp(argv[i], "--log-journal") == 0) {
+            logger_config->log_to_journal = 1;
+        }
+        else if (strcmp(argv[i], "--log-raw-time") == 0) {
+            logger_config->timestamp_format = LOG_TIMESTAMP_RAW;
+        }
         else if (strcmp(argv[i], "--no-colors") == 0) {
             logger_config->use_colors = 0;
         }
         else if (strcmp(argv[i], "--no-async") == 0) {
             logger_config->async_enabled = 0;
         }
+        else if (strcmp(argv[i], "--log-overflow") == 0 && i + 1 < argc) {
+            logger_config->overflow_policy = parse_overflow_policy(argv[++i]);
+        }
         else if (strcmp(argv[i], "--console-only") == 0) {
             logger_config->log_to_file = 0;
         }
@@ -147,6 +268,26 @@ void parse_args(int argc, char **argv, logger_config_t *logger_config, server_co
                 exit(1);
             }
         } 
+        else if (strcmp(argv[i], "--refresh-rate") == 0 && i + 1 < argc) {
+            server_config->refresh_rate = atoi(argv[++i]);
+            if (server_config->refresh_rate < 0) {
+                fprintf(stderr, "Error: --refresh-rate must be >= 0\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+            server_config->metrics_interval = atoi(argv[++i]);
+            if (server_config->metrics_interval < 0) {
+                fprintf(stderr, "Error: --metrics-interval must be >= 0\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--dbus-inline") == 0) {
+            server_config->dbus_inline = true;
+        }
+        else if (strcmp(argv[i], "--dbus-threaded") == 0) {
+            server_config->dbus_inline = false;
+        }
         else if (strcmp(argv[i], "--help") == 0) {
             log_help(argv);
         }
@@ -0,0 +1,115 @@
+#include <dbus-server/dispatch.h>
+#include <logger.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DISPATCH_MIN_CAPACITY 16
+
+/* FNV-1a over "path\0interface\0member" */
+static uint64_t hash_append(uint64_t hash, const char *s) {
+    const unsigned char *p = (const unsigned char *)s;
+    do {
+        hash ^= *p;
+        hash *= 0x100000001b3ull;
+    } while (*p++);
+    return hash;
+}
+
+static uint64_t dispatch_hash(const char *object_path, const char *interface, const char *member) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hash_append(hash, object_path);
+    hash = hash_append(hash, interface);
+    hash = hash_append(hash, member);
+    return hash ? hash : 1; /* 0 marks empty slots */
+}
+
+static struct dbus_dispatch_entry *dispatch_slot(struct dbus_dispatch_table *table, uint64_t hash,
+                                                 const char *object_path, const char *interface,
+                                                 const char *member) {
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        struct dbus_dispatch_entry *entry = &table->entries[i];
+        if (entry->hash == 0) return entry;
+        if (entry->hash == hash && strcmp(entry->member, member) == 0 &&
+            strcmp(entry->interface, interface) == 0 && strcmp(entry->object_path, object_path) == 0) {
+            return entry;
+        }
+    }
+}
+
+/* Next free slot on the probe sequence, for chained duplicates */
+static struct dbus_dispatch_entry *dispatch_free_slot(struct dbus_dispatch_table *table, size_t from) {
+    for (size_t i = from;; i = (i + 1) & table->mask) {
+        if (table->entries[i].hash == 0) return &table->entries[i];
+    }
+}
+
+struct dbus_dispatch_table *dbus_dispatch_table_build(DBUS_MODULE *modules) {
+    size_t methods = 0;
+    for (DBUS_MODULE *module = modules; module; module = module->next) {
+        for (DBUS_INTERFACE *iface = module->interfaces; iface; iface = iface->next) {
+            for (DBUS_METHOD *method = iface->methods; method; method = method->next) {
+                methods++;
+            }
+        }
+    }
+
+    size_t capacity = DISPATCH_MIN_CAPACITY;
+    while (capacity < methods * 2) capacity *= 2;
+
+    struct dbus_dispatch_table *table = calloc(1, sizeof(struct dbus_dispatch_table) +
+                                                  capacity * sizeof(struct dbus_dispatch_entry));
+    if (!table) {
+        DBUS_ERROR("Failed to allocate dispatch table (%zu methods)", methods);
+        return NULL;
+    }
+    table->mask = capacity - 1;
+
+    for (DBUS_MODULE *module = modules; module; module = module->next) {
+        for (DBUS_INTERFACE *iface = module->interfaces; iface; iface = iface->next) {
+            if (!iface->object_path) continue;
+
+            for (DBUS_METHOD *method = iface->methods; method; method = method->next) {
+                if (!method->handler && !method->worker_handler) continue;
+
+                uint64_t hash = dispatch_hash(iface->object_path, iface->name, method->name);
+                struct dbus_dispatch_entry *entry = dispatch_slot(table, hash, iface->object_path,
+                                                                  iface->name, method->name);
+                if (entry->hash != 0) {
+                    /* Lookup always finds the first registration, later ones hang off it */
+                    struct dbus_dispatch_entry *tail = entry;
+                    while (tail->next) tail = (struct dbus_dispatch_entry *)tail->next;
+
+                    entry = dispatch_free_slot(table, (size_t)(entry - table->entries));
+                    tail->next = entry;
+                    DBUS_DEBUG("Method %s.%s on %s registered more than once, chaining",
+                               iface->name, method->name, iface->object_path);
+                }
+
+                entry->hash = hash;
+                entry->object_path = iface->object_path;
+                entry->interface = iface->name;
+                entry->member = method->name;
+                entry->method = method;
+                table->count++;
+            }
+        }
+    }
+
+    return table;
+}
+
+void dbus_dispatch_table_destroy(struct dbus_dispatch_table *table) {
+    free(table);
+}
+
+const struct dbus_dispatch_entry *dbus_dispatch_lookup(const struct dbus_dispatch_table *table,
+                                                       const char *object_path, const char *interface,
+                                                       const char *member) {
+    if (!table || !object_path || !interface || !member) return NULL;
+
+    uint64_t hash = dispatch_hash(object_path, interface, member);
+    struct dbus_dispatch_entry *entry = dispatch_slot((struct dbus_dispatch_table *)table, hash,
+                                                      object_path, interface, member);
+    return entry->hash ? entry : NULL;
+}
@@ -0,0 +1,164 @@
+#include <dbus-server/introspect.h>
+#include <logger.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+static struct dbus_introspect_node *node_create(const char *name, size_t len) {
+    struct dbus_introspect_node *node = calloc(1, sizeof(struct dbus_introspect_node));
+    if (!node) return NULL;
+
+    node->name = strndup(name, len);
+    if (!node->name) {
+        free(node);
+        return NULL;
+    }
+    return node;
+}
+
+static struct dbus_introspect_node *node_find_child(struct dbus_introspect_node *node,
+                                                    const char *name, size_t len) {
+    for (struct dbus_introspect_node *child = node->children; child; child = child->next) {
+        if (strncmp(child->name, name, len) == 0 && child->name[len] == '\0') {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+/* Walk path components, creating missing nodes when create is set */
+static struct dbus_introspect_node *node_lookup(struct dbus_introspect_node *root, const char *path, bool create) {
+    if (!path || path[0] != '/') return NULL;
+
+    struct dbus_introspect_node *node = root;
+    const char *component = path + 1;
+
+    while (*component) {
+        const char *end = strchr(component, '/');
+        size_t len = end ? (size_t)(end - component) : strlen(component);
+
+        if (len > 0) {
+            struct dbus_introspect_node *child = node_find_child(node, component, len);
+            if (!child) {
+                if (!create) return NULL;
+
+                child = node_create(component, len);
+                if (!child) return NULL;
+
+                if (node->children_tail) {
+                    node->children_tail->next = child;
+                } else {
+                    node->children = child;
+                }
+                node->children_tail = child;
+            }
+            node = child;
+        }
+
+        if (!end) break;
+        component = end + 1;
+    }
+
+    return node;
+}
+
+static bool node_add_interface(struct dbus_introspect_node *node, DBUS_INTERFACE *iface) {
+    /* Same interface on the same path: the first one is the one dispatched */
+    for (size_t i = 0; i < node->n_interfaces; i++) {
+        if (strcmp(node->interfaces[i]->name, iface->name) == 0) return true;
+    }
+
+    if (node->n_interfaces == node->interfaces_cap) {
+        size_t cap = node->interfaces_cap ? node->interfaces_cap * 2 : 4;
+        DBUS_INTERFACE **interfaces = realloc(node->interfaces, cap * sizeof(*interfaces));
+        if (!interfaces) return false;
+
+        node->interfaces = interfaces;
+        node->interfaces_cap = cap;
+    }
+
+    node->interfaces[node->n_interfaces++] = iface;
+    return true;
+}
+
+struct dbus_introspect_node *dbus_introspect_tree_build(DBUS_MODULE *modules) {
+    struct dbus_introspect_node *root = node_create("", 0);
+    if (!root) {
+        DBUS_ERROR("Failed to allocate introspection tree");
+        return NULL;
+    }
+
+    for (DBUS_MODULE *module = modules; module; module = module->next) {
+        for (DBUS_INTERFACE *iface = module->interfaces; iface; iface = iface->next) {
+            struct dbus_introspect_node *node = node_lookup(root, iface->object_path, true);
+            if (!node || !node_add_interface(node, iface)) {
+                DBUS_ERROR("Failed to add %s to the introspection tree", iface->name);
+                dbus_introspect_tree_destroy(root);
+                return NULL;
+            }
+        }
+    }
+
+    return root;
+}
+
+void dbus_introspect_tree_destroy(struct dbus_introspect_node *root) {
+    if (!root) return;
+
+    struct dbus_introspect_node *child = root->children;
+    while (child) {
+        struct dbus_introspect_node *next = child->next;
+        dbus_introspect_tree_destroy(child);
+        child = next;
+    }
+
+    free(root->interfaces);
+    free(root->xml);
+    free(root->name);
+    free(root);
+}
+
+static void node_generate_xml(struct dbus_introspect_node *node) {
+    struct dbus_strbuf buf = {0};
+
+    strbuf_append(&buf,
+        "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\"\n"
+        "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n"
+        "<node>\n"
+        "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+        "    <method name=\"Introspect\">\n"
+        "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n"
+        "    </method>\n"
+        "  </interface>\n");
+
+    for (size_t i = 0; i < node->n_interfaces; i++) {
+        interface_append_introspection(&buf, node->interfaces[i]);
+    }
+
+    for (struct dbus_introspect_node *child = node->children; child; child = child->next) {
+        strbuf_append(&buf, "  <node name=\"");
+        strbuf_append(&buf, child->name);
+        strbuf_append(&buf, "\"/>\n");
+    }
+
+    strbuf_append(&buf, "</node>\n");
+    node->xml = strbuf_steal(&buf, &node->xml_len);
+}
+
+const char *dbus_introspect_xml(struct dbus_introspect_node *root, const char *path, size_t *len) {
+    if (!root) return NULL;
+
+    struct dbus_introspect_node *node = node_lookup(root, path, false);
+    if (!node) return NULL;
+
+    if (!node->xml) {
+        node_generate_xml(node);
+        if (!node->xml) {
+            DBUS_ERROR("Failed to generate introspection XML for %s", path);
+            return NULL;
+        }
+    }
+
+    if (len) *len = node->xml_len;
+    return node->xml;
+}
@@ -0,0 +1,326 @@
+#include <dbus-server/loop.h>
+#include <logger.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define LOOP_MAX_EVENTS 16
+#define LOOP_MAX_WATCHES 8
+
+/* Register the union of the enabled watches on fd (libdbus uses one watch per direction) */
+static void loop_update_fd(struct dbus_loop *loop, int fd) {
+    uint32_t events = 0;
+    for (struct dbus_loop_watch *w = loop->watches; w; w = w->next) {
+        if (dbus_watch_get_unix_fd(w->watch) != fd || !dbus_watch_get_enabled(w->watch)) continue;
+
+        unsigned int flags = dbus_watch_get_flags(w->watch);
+        if (flags & DBUS_WATCH_READABLE) events |= EPOLLIN;
+        if (flags & DBUS_WATCH_WRITABLE) events |= EPOLLOUT;
+    }
+
+    struct epoll_event event = {
+        .events = events,
+        .data.fd = fd,
+    };
+
+    if (events == 0) {
+        /* Fails when it was never added or fd is already closed, both fine */
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        return;
+    }
+
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0 &&
+        (errno != ENOENT || epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)) {
+        DBUS_ERROR("Failed to watch D-Bus fd %d: %s", fd, strerror(errno));
+    }
+}
+
+static dbus_bool_t loop_add_watch(DBusWatch *watch, void *data) {
+    struct dbus_loop *loop = data;
+
+    struct dbus_loop_watch *entry = calloc(1, sizeof(struct dbus_loop_watch));
+    if (!entry) return FALSE;
+    entry->watch = watch;
+
+    pthread_mutex_lock(&loop->mutex);
+    entry->next = loop->watches;
+    loop->watches = entry;
+    loop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    pthread_mutex_unlock(&loop->mutex);
+
+    return TRUE;
+}
+
+static void loop_remove_watch(DBusWatch *watch, void *data) {
+    struct dbus_loop *loop = data;
+
+    pthread_mutex_lock(&loop->mutex);
+    for (struct dbus_loop_watch **link = &loop->watches; *link; link = &(*link)->next) {
+        if ((*link)->watch == watch) {
+            struct dbus_loop_watch *entry = *link;
+            *link = entry->next;
+            free(entry);
+            break;
+        }
+    }
+    loop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    pthread_mutex_unlock(&loop->mutex);
+}
+
+static void loop_toggle_watch(DBusWatch *watch, void *data) {
+    struct dbus_loop *loop = data;
+
+    pthread_mutex_lock(&loop->mutex);
+    loop_update_fd(loop, dbus_watch_get_unix_fd(watch));
+    pthread_mutex_unlock(&loop->mutex);
+}
+
+/* libdbus timeouts repeat every interval while enabled */
+static void loop_arm_timeout(struct dbus_loop_timeout *entry) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+
+    if (dbus_timeout_get_enabled(entry->timeout)) {
+        int interval = dbus_timeout_get_interval(entry->timeout);
+        spec.it_interval.tv_sec = interval / 1000;
+        spec.it_interval.tv_nsec = (long)(interval % 1000) * 1000000;
+        spec.it_value = spec.it_interval;
+        if (interval <= 0) spec.it_value.tv_nsec = 1; /* zero would disarm */
+    }
+
+    if (timerfd_settime(entry->timer_fd, 0, &spec, NULL) < 0) {
+        DBUS_ERROR("Failed to arm D-Bus timeout: %s", strerror(errno));
+    }
+}
+
+static dbus_bool_t loop_add_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_loop *loop = data;
+
+    struct dbus_loop_timeout *entry = calloc(1, sizeof(struct dbus_loop_timeout));
+    if (!entry) return FALSE;
+    entry->timeout = timeout;
+
+    entry->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (entry->timer_fd < 0) {
+        DBUS_ERROR("Failed to create D-Bus timerfd: %s", strerror(errno));
+        free(entry);
+        return FALSE;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.fd = entry->timer_fd,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, entry->timer_fd, &event) < 0) {
+        DBUS_ERROR("Failed to add D-Bus timerfd to epoll: %s", strerror(errno));
+        close(entry->timer_fd);
+        free(entry);
+        return FALSE;
+    }
+
+    loop_arm_timeout(entry);
+
+    pthread_mutex_lock(&loop->mutex);
+    entry->next = loop->timeouts;
+    loop->timeouts = entry;
+    pthread_mutex_unlock(&loop->mutex);
+
+    return TRUE;
+}
+
+static void loop_remove_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_loop *loop = data;
+
+    pthread_mutex_lock(&loop->mutex);
+    for (struct dbus_loop_timeout **link = &loop->timeouts; *link; link = &(*link)->next) {
+        if ((*link)->timeout == timeout) {
+            struct dbus_loop_timeout *entry = *link;
+            *link = entry->next;
+            epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, entry->timer_fd, NULL);
+            close(entry->timer_fd);
+            free(entry);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&loop->mutex);
+}
+
+static void loop_toggle_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_loop *loop = data;
+
+    pthread_mutex_lock(&loop->mutex);
+    for (struct dbus_loop_timeout *entry = loop->timeouts; entry; entry = entry->next) {
+        if (entry->timeout == timeout) {
+            loop_arm_timeout(entry);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&loop->mutex);
+}
+
+static void loop_wakeup_main(void *data) {
+    dbus_loop_wakeup(data);
+}
+
+struct dbus_loop *dbus_loop_create(DBusConnection *connection) {
+    struct dbus_loop *loop = calloc(1, sizeof(struct dbus_loop));
+    if (!loop) {
+        DBUS_ERROR("Failed to allocate D-Bus loop");
+        return NULL;
+    }
+
+    loop->connection = connection;
+    loop->wakeup_fd = -1;
+
+    if (pthread_mutex_init(&loop->mutex, NULL) != 0) {
+        DBUS_ERROR("Failed to initialize D-Bus loop mutex");
+        free(loop);
+        return NULL;
+    }
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epoll_fd < 0 || loop->wakeup_fd < 0) {
+        DBUS_ERROR("Failed to create D-Bus loop fds: %s", strerror(errno));
+        dbus_loop_destroy(loop);
+        return NULL;
+    }
+
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.fd = loop->wakeup_fd,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wakeup_fd, &event) < 0) {
+        DBUS_ERROR("Failed to add wakeup fd to epoll: %s", strerror(errno));
+        dbus_loop_destroy(loop);
+        return NULL;
+    }
+
+    if (!dbus_connection_set_watch_functions(connection, loop_add_watch, loop_remove_watch,
+                                             loop_toggle_watch, loop, NULL) ||
+        !dbus_connection_set_timeout_functions(connection, loop_add_timeout, loop_remove_timeout,
+                                               loop_toggle_timeout, loop, NULL)) {
+        DBUS_ERROR("Failed to set D-Bus watch/timeout functions");
+        dbus_loop_destroy(loop);
+        return NULL;
+    }
+    dbus_connection_set_wakeup_main_function(connection, loop_wakeup_main, loop, NULL);
+
+    return loop;
+}
+
+void dbus_loop_destroy(struct dbus_loop *loop) {
+    if (!loop) return;
+
+    /* libdbus calls remove for every watch/timeout, which frees our entries */
+    if (loop->connection) {
+        dbus_connection_set_wakeup_main_function(loop->connection, NULL, NULL, NULL);
+        dbus_connection_set_watch_functions(loop->connection, NULL, NULL, NULL, NULL, NULL);
+        dbus_connection_set_timeout_functions(loop->connection, NULL, NULL, NULL, NULL, NULL);
+    }
+
+    if (loop->wakeup_fd >= 0) close(loop->wakeup_fd);
+    if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+
+    pthread_mutex_destroy(&loop->mutex);
+    free(loop);
+}
+
+bool dbus_loop_add_wakeup_fd(struct dbus_loop *loop, int fd) {
+    if (!loop || fd < 0) return false;
+
+    struct epoll_event event = {
+        .events = EPOLLIN | EPOLLET,
+        .data.fd = fd,
+    };
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        DBUS_ERROR("Failed to add fd %d to D-Bus loop: %s", fd, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void dbus_loop_wakeup(struct dbus_loop *loop) {
+    if (!loop) return;
+
+    uint64_t one = 1;
+    if (write(loop->wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        DBUS_ERROR("Failed to wake D-Bus loop: %s", strerror(errno));
+    }
+}
+
+static unsigned int epoll_to_watch_flags(uint32_t events) {
+    unsigned int flags = 0;
+    if (events & EPOLLIN) flags |= DBUS_WATCH_READABLE;
+    if (events & EPOLLOUT) flags |= DBUS_WATCH_WRITABLE;
+    if (events & EPOLLERR) flags |= DBUS_WATCH_ERROR;
+    if (events & EPOLLHUP) flags |= DBUS_WATCH_HANGUP;
+    return flags;
+}
+
+static void loop_handle_fd(struct dbus_loop *loop, int fd, uint32_t events) {
+    /* Collect under the lock, handle without it: handlers take the connection lock */
+    DBusWatch *watches[LOOP_MAX_WATCHES];
+    int n_watches = 0;
+    DBusTimeout *timeout = NULL;
+
+    pthread_mutex_lock(&loop->mutex);
+    for (struct dbus_loop_watch *w = loop->watches; w && n_watches < LOOP_MAX_WATCHES; w = w->next) {
+        if (dbus_watch_get_unix_fd(w->watch) == fd && dbus_watch_get_enabled(w->watch)) {
+            watches[n_watches++] = w->watch;
+        }
+    }
+    for (struct dbus_loop_timeout *t = loop->timeouts; t; t = t->next) {
+        if (t->timer_fd == fd) {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) > 0) timeout = t->timeout;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&loop->mutex);
+
+    unsigned int flags = epoll_to_watch_flags(events);
+    for (int i = 0; i < n_watches; i++) {
+        unsigned int wanted = dbus_watch_get_flags(watches[i]) | DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP;
+        if (flags & wanted) {
+            dbus_watch_handle(watches[i], flags & wanted);
+        }
+    }
+
+    if (timeout) {
+        dbus_timeout_handle(timeout);
+    }
+}
+
+int dbus_loop_dispatch(struct dbus_loop *loop) {
+    struct epoll_event events[LOOP_MAX_EVENTS];
+
+    int count = epoll_wait(loop->epoll_fd, events, LOOP_MAX_EVENTS, -1);
+    if (count < 0) {
+        if (errno == EINTR) return 0;
+        DBUS_ERROR("epoll_wait() failed: %s", strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == loop->wakeup_fd) {
+            uint64_t value;
+            if (read(fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                DBUS_ERROR("Failed to read D-Bus wakeup fd: %s", strerror(errno));
+            }
+            continue;
+        }
+
+        /* Extra wakeup fds are edge-triggered and owned by the caller */
+        loop_handle_fd(loop, fd, events[i].events);
+    }
+
+    return 0;
+}
@@ -1,96 +1,118 @@
 #include <dbus-server/module-lib.h>
+#include <dbus-server/typed_method.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
-/* String concat helper */
-char *str_append(char *dest, const char *src) {
-    if (!src) return dest;
-    
-    size_t dest_len = dest ? strlen(dest) : 0;
-    size_t src_len = strlen(src);
-    
-    char *new_str = realloc(dest, dest_len + src_len + 1);
-    if (!new_str) {
-        free(dest);
-        return NULL;
+void strbuf_append_len(struct dbus_strbuf *buf, const char *src, size_t len) {
+    if (buf->failed || !src) return;
+
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 256;
+        while (cap < buf->len + len + 1) cap *= 2;
+
+        char *data = realloc(buf->data, cap);
+        if (!data) {
+            free(buf->data);
+            buf->data = NULL;
+            buf->failed = true;
+            return;
+        }
+        buf->data = data;
+        buf->cap = cap;
     }
-    
-    memcpy(new_str + dest_len, src, src_len + 1);
-    return new_str;
+
+    memcpy(buf->data + buf->len, src, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
 }
 
-/* Generate interface introspection (Just for Refactor) */
-static char *generate_interface_introspection(DBUS_INTERFACE *iface, const char *object_path) {
-    char *xml = NULL;
-
-    // Validate object path
-    if (!object_path || (iface->object_path && strcmp(iface->object_path, object_path) == 0)) {
-        xml = str_append(xml, "  <interface name=\"");
-        xml = str_append(xml, iface->name);
-        xml = str_append(xml, "\">\n");
-
-        /* Методы интерфейса */
-        DBUS_METHOD *method = iface->methods;
-        while (method) {
-            xml = str_append(xml, "    <method name=\"");
-            xml = str_append(xml, method->name);
-            xml = str_append(xml, "\">\n");
-                    
-            /* Входные аргументы (in) */
-            if (method->signature && method->signature[0] != '\0') {
-                /* Парсим сигнатуру и создаем аргументы */
-                // TODO: Реализовать парсинг сигнатуры D-Bus
-                xml = str_append(xml, "      <arg name=\"value\" direction=\"in\" type=\"");
-                xml = str_append(xml, method->signature);
-                xml = str_append(xml, "\"/>\n");
-            }
-                    
-            /* Выходные аргументы (out) */
-            if (method->return_signature && method->return_signature[0] != '\0') {
-                xml = str_append(xml, "      <arg name=\"result\" direction=\"out\" type=\"");
-                xml = str_append(xml, method->return_signature);
-                xml = str_append(xml, "\"/>\n");
+void strbuf_append(struct dbus_strbuf *buf, const char *src) {
+    if (src) strbuf_append_len(buf, src, strlen(src));
+}
+
+char *strbuf_steal(struct dbus_strbuf *buf, size_t *len) {
+    char *data = buf->failed ? NULL : buf->data;
+    if (len) *len = data ? buf->len : 0;
+    if (!data) free(buf->data);
+
+    buf->data = NULL;
+    buf->len = buf->cap = 0;
+    buf->failed = false;
+    return data;
+}
+
+/* Interface element with its methods */
+void interface_append_introspection(struct dbus_strbuf *buf, DBUS_INTERFACE *iface) {
+    strbuf_append(buf, "  <interface name=\"");
+    strbuf_append(buf, iface->name);
+    strbuf_append(buf, "\">\n");
+
+    /* Методы интерфейса */
+    for (DBUS_METHOD *method = iface->methods; method; method = method->next) {
+        strbuf_append(buf, "    <method name=\"");
+        strbuf_append(buf, method->name);
+        strbuf_append(buf, "\">\n");
+
+        /* Typed methods name their arguments */
+        if (method->args) {
+            for (const struct dbus_arg_desc *arg = method->args; arg->name; arg++) {
+                strbuf_append(buf, "      <arg name=\"");
+                strbuf_append(buf, arg->name);
+                strbuf_append(buf, arg->in ? "\" direction=\"in\" type=\"" : "\" direction=\"out\" type=\"");
+                strbuf_append(buf, arg->type);
+                strbuf_append(buf, "\"/>\n");
             }
-                    
-            xml = str_append(xml, "    </method>\n");
-            method = method->next;
+            strbuf_append(buf, "    </method>\n");
+            continue;
+        }
+
+        /* Входные аргументы (in) */
+        if (method->signature && method->signature[0] != '\0') {
+            // TODO: Реализовать парсинг сигнатуры D-Bus
+            strbuf_append(buf, "      <arg name=\"value\" direction=\"in\" type=\"");
+            strbuf_append(buf, method->signature);
+            strbuf_append(buf, "\"/>\n");
+        }
+
+        /* Выходные аргументы (out) */
+        if (method->return_signature && method->return_signature[0] != '\0') {
+            strbuf_append(buf, "      <arg name=\"result\" direction=\"out\" type=\"");
+            strbuf_append(buf, method->return_signature);
+            strbuf_append(buf, "\"/>\n");
         }
-                
-        xml = str_append(xml, "  </interface>\n");
+
+        strbuf_append(buf, "    </method>\n");
     }
 
-    return xml;
+    strbuf_append(buf, "  </interface>\n");
 }
 
 /* Generate XML Introspect for module */
 char *module_generate_introspection_xml(DBUS_MODULE *module, const char *object_path) {
-    char *xml = NULL;
+    struct dbus_strbuf buf = {0};
 
     /* Header XML */
-    xml = str_append(xml, "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\"\n");
-    xml = str_append(xml, "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n");
-    xml = str_append(xml, "<node>\n");
+    strbuf_append(&buf, "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\"\n");
+    strbuf_append(&buf, "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n");
+    strbuf_append(&buf, "<node>\n");
 
     /* Standart interface Introspectable */
-    xml = str_append(xml, "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n");
-    xml = str_append(xml, "    <method name=\"Introspect\">\n");
-    xml = str_append(xml, "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n");
-    xml = str_append(xml, "    </method>\n");
-    xml = str_append(xml, "  </interface>\n");
+    strbuf_append(&buf, "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n");
+    strbuf_append(&buf, "    <method name=\"Introspect\">\n");
+    strbuf_append(&buf, "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n");
+    strbuf_append(&buf, "    </method>\n");
+    strbuf_append(&buf, "  </interface>\n");
 
     /* Module user interfaces */
-    if (module && module->interfaces) {
-        DBUS_INTERFACE *iface = module->interfaces;
-        while (iface) {
-            char *iface_xml = generate_interface_introspection(iface, object_path);
-            xml = str_append(xml, iface_xml);
-            iface = iface->next;
+    for (DBUS_INTERFACE *iface = module ? module->interfaces : NULL; iface; iface = iface->next) {
+        if (!object_path || (iface->object_path && strcmp(iface->object_path, object_path) == 0)) {
+            interface_append_introspection(&buf, iface);
         }
     }
 
-    xml = str_append(xml, "</node>\n");
-    return xml;
+    strbuf_append(&buf, "</node>\n");
+    return strbuf_steal(&buf, NULL);
 }
 
 /* Create method helper */
@@ -106,7 +128,10 @@ static DBUS_METHOD *method_create(const char *name) {
         return NULL;
     }
     
+    method->flags = 0;
     method->handler = NULL;
+    method->worker_handler = NULL;
+    method->args = NULL;
     method->user_data = NULL;
     method->next = NULL;
     method->signature = NULL;
@@ -240,6 +265,44 @@ DBUS_METHOD *interface_add_method(DBUS_INTERFACE *iface, char *method_name, char
     return new_method;
 }
 
+/* Add method described by DBUS_TYPED_METHOD */
+DBUS_METHOD *interface_add_typed_method(DBUS_INTERFACE *iface, char *method_name, const struct dbus_method_desc *desc, void *user_data) {
+    if (!desc) return NULL;
+
+    DBUS_METHOD *new_method = interface_add_method(iface, method_name, (char *)desc->signature,
+                                                   (char *)desc->return_signature, desc->dispatch, user_data);
+    if (!new_method) return NULL;
+
+    new_method->flags |= DBUS_METHOD_TYPED;
+    new_method->args = desc->args;
+
+    return new_method;
+}
+
+DBusHandlerResult dbus_typed_method_send_error(DBusConnection *conn, DBusMessage *msg,
+                                               const struct dbus_method_error *error) {
+    DBusMessage *reply = dbus_message_new_error(msg, error->name ? error->name : DBUS_ERROR_FAILED,
+                                                error->message ? error->message : "Failed");
+    if (!reply) return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Add method whose handler runs on the worker pool */
+DBUS_METHOD *interface_add_worker_method(DBUS_INTERFACE *iface, char *method_name, char *signature, char *return_signature, DBUS_WORKER_HANDLER handler, void *user_data) {
+    if (!handler) return NULL;
+
+    DBUS_METHOD *new_method = interface_add_method(iface, method_name, signature, return_signature, NULL, user_data);
+    if (!new_method) return NULL;
+
+    new_method->flags |= DBUS_METHOD_WORKER;
+    new_method->worker_handler = handler;
+
+    return new_method;
+}
+
 /* Find method in module */
 DBUS_METHOD *module_find_method(DBUS_MODULE *module, const char *interface_name, const char *method_name, const char *object_path) {
     if (!module || !interface_name || !method_name || !object_path) {
@@ -1,4 +1,6 @@
 #include <dbus-server/modules/buffer_module.h>
+#include <dbus-server/server.h>
+#include <dbus-server/typed_method.h>
 #include <logger.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,8 +25,19 @@ enum pixel_format string_to_pixel_format(const char *str) {
     return PIXEL_FORMAT_UNKNOWN;
 }
 
+#define BUFFER_UPDATE_IN(A)     A(STRING, data)
+#define BUFFER_STATUS_OUT(A)    A(STRING, status)
+#define BUFFER_GET_OUT(A)       A(STRING, info)
+#define BUFFER_RELEASE_IN(A)    A(UINT32, serial)
 
-DBUS_MODULE *create_buffer_module(void) {
+DBUS_TYPED_METHOD(buffer_update, BUFFER_UPDATE_IN, BUFFER_STATUS_OUT)
+DBUS_TYPED_METHOD(buffer_get, DBUS_NO_ARGS, BUFFER_GET_OUT)
+DBUS_TYPED_METHOD(buffer_set, BUFFER_UPDATE_IN, BUFFER_STATUS_OUT)
+DBUS_TYPED_METHOD(buffer_subscribe, DBUS_NO_ARGS, DBUS_NO_ARGS)
+DBUS_TYPED_METHOD(buffer_unsubscribe, DBUS_NO_ARGS, DBUS_NO_ARGS)
+DBUS_TYPED_METHOD(buffer_release, BUFFER_RELEASE_IN, DBUS_NO_ARGS)
+
+DBUS_MODULE *create_buffer_module(struct buffer_tracker *tracker, struct buffer_ring *ring) {
     DBUS_MODULE *module = module_create("Buffer_Broadcast");
     if (!module) {
         SERVER_ERROR("Failed to create buffer module");
@@ -42,93 +55,153 @@ DBUS_MODULE *create_buffer_module(void) {
     }
 
     // Add methods to the interface
-    interface_add_method(iface, "Update", "s", "s", buffer_update_handler, NULL);
-    interface_add_method(iface, "Get", "", "s", buffer_get_handler, NULL);
-    interface_add_method(iface, "Set", "s", "s", buffer_set_handler, NULL);
+    interface_add_typed_method(iface, "Update", &buffer_update_desc, NULL);
+    interface_add_typed_method(iface, "Get", &buffer_get_desc, NULL);
+    interface_add_typed_method(iface, "Set", &buffer_set_desc, NULL);
+    interface_add_typed_method(iface, "Subscribe", &buffer_subscribe_desc, tracker);
+    interface_add_typed_method(iface, "Unsubscribe", &buffer_unsubscribe_desc, tracker);
+    interface_add_typed_method(iface, "Release", &buffer_release_desc, tracker);
+    /* OpenRing: shared-memory update ring, returns (ring memfd, fd socket, eventfd) */
+    interface_add_method(iface, "OpenRing", "", "hhh", buffer_open_ring_handler, ring);
 
     SERVER_DEBUG("Buffer module created successfully");
     return module;
 }
 
-DBusHandlerResult buffer_update_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+DBUS_TYPED_METHOD_IMPL(buffer_update) {
     SERVER_DEBUG("Buffer update handler called");
-    
+
     // TODO: Implement actual buffer update logic
-    const char *response = "Buffer update received";
-    
-    DBusMessage *reply = dbus_message_new_method_return(msg);
-    if (!reply) {
-        return DBUS_HANDLER_RESULT_NEED_MEMORY;
-    }
-    
-    dbus_message_append_args(reply, DBUS_TYPE_STRING, &response, DBUS_TYPE_INVALID);
-    dbus_connection_send(conn, reply, NULL);
-    dbus_message_unref(reply);
-    
-    return DBUS_HANDLER_RESULT_HANDLED;
+    out->status = "Buffer update received";
+    return true;
 }
 
-DBusHandlerResult buffer_get_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+DBUS_TYPED_METHOD_IMPL(buffer_get) {
     SERVER_DEBUG("Buffer get handler called");
-    
+
     // TODO: Get actual buffer info
-    const char *response = "Buffer info: width=0, height=0, format=UNKNOWN";
-    
-    DBusMessage *reply = dbus_message_new_method_return(msg);
-    if (!reply) {
-        return DBUS_HANDLER_RESULT_NEED_MEMORY;
-    }
-    
-    dbus_message_append_args(reply, DBUS_TYPE_STRING, &response, DBUS_TYPE_INVALID);
-    dbus_connection_send(conn, reply, NULL);
-    dbus_message_unref(reply);
-    
-    return DBUS_HANDLER_RESULT_HANDLED;
+    out->info = "Buffer info: width=0, height=0, format=UNKNOWN";
+    return true;
 }
 
-DBusHandlerResult buffer_set_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+DBUS_TYPED_METHOD_IMPL(buffer_set) {
     SERVER_DEBUG("Buffer set handler called");
-    
-    char *buffer_data = NULL;
-    if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &buffer_data, DBUS_TYPE_INVALID)) {
-        DBusMessage *error = dbus_message_new_error(msg, 
-            "org.skapty6260.DesktopEngine.Buffer_Broadcast.Error.InvalidArgs",
-            "Invalid arguments");
-        dbus_connection_send(conn, error, NULL);
-        dbus_message_unref(error);
+    SERVER_DEBUG("Received buffer data: %s", in->data);
+
+    // TODO: Process buffer data
+    out->status = "Buffer set successfully";
+    return true;
+}
+
+/* Consumer holds committed buffers until it Releases their serial */
+DBUS_TYPED_METHOD_IMPL(buffer_subscribe) {
+    struct buffer_tracker *tracker = user_data;
+
+    SERVER_DEBUG("Buffer consumer subscribe: %s", dbus_message_get_sender(msg));
+    buffer_tracker_push_event(tracker, BUFFER_TRACKER_SUBSCRIBE, dbus_message_get_sender(msg), 0);
+    return true;
+}
+
+DBUS_TYPED_METHOD_IMPL(buffer_unsubscribe) {
+    struct buffer_tracker *tracker = user_data;
+
+    SERVER_DEBUG("Buffer consumer unsubscribe: %s", dbus_message_get_sender(msg));
+    buffer_tracker_push_event(tracker, BUFFER_TRACKER_UNSUBSCRIBE, dbus_message_get_sender(msg), 0);
+    return true;
+}
+
+/* A consumer that exits without Unsubscribe must not hold buffers or a ring channel any longer */
+void buffer_module_name_lost(const char *name, void *user_data) {
+    struct buffer_tracker *tracker = user_data;
+
+    buffer_tracker_push_event(tracker, BUFFER_TRACKER_GONE, name, 0);
+}
+
+/* Consumer finished reading the buffer published with this serial */
+DBUS_TYPED_METHOD_IMPL(buffer_release) {
+    struct buffer_tracker *tracker = user_data;
+
+    buffer_tracker_push_event(tracker, BUFFER_TRACKER_ACK, dbus_message_get_sender(msg), in->serial);
+    return true;
+}
+
+/* Switch this consumer to the shared-memory ring, see wayland/buffer_ring.h */
+DBusHandlerResult buffer_open_ring_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+    struct buffer_ring *ring = user_data;
+
+    struct buffer_ring_fds fds;
+    uint32_t generation = buffer_ring_open(ring, dbus_message_get_sender(msg), &fds);
+    if (generation == 0) {
+        DBusMessage *error = dbus_message_new_error(msg,
+            "org.skapty6260.DesktopEngine.Buffer_Broadcast.Error.Failed",
+            "Failed to open buffer ring");
+        if (error) {
+            dbus_connection_send(conn, error, NULL);
+            dbus_message_unref(error);
+        }
         return DBUS_HANDLER_RESULT_HANDLED;
     }
-    
-    SERVER_DEBUG("Received buffer data: %s", buffer_data);
-    
-    // TODO: Process buffer data
-    const char *response = "Buffer set successfully";
-    
+
+    /* libdbus dups the fds into the message */
     DBusMessage *reply = dbus_message_new_method_return(msg);
-    dbus_message_append_args(reply, DBUS_TYPE_STRING, &response, DBUS_TYPE_INVALID);
-    dbus_connection_send(conn, reply, NULL);
-    dbus_message_unref(reply);
-    
+    bool sent = reply &&
+                dbus_message_append_args(reply,
+                                         DBUS_TYPE_UNIX_FD, &fds.memfd,
+                                         DBUS_TYPE_UNIX_FD, &fds.socket_fd,
+                                         DBUS_TYPE_UNIX_FD, &fds.event_fd,
+                                         DBUS_TYPE_INVALID) &&
+                dbus_connection_send(conn, reply, NULL);
+    if (reply) dbus_message_unref(reply);
+
+    close(fds.memfd);
+    close(fds.socket_fd);
+    close(fds.event_fd);
+
+    if (!sent) {
+        /* The consumer never gets the fds, don't publish into the channel */
+        buffer_ring_cancel(ring, generation);
+        SERVER_ERROR("Failed to send buffer ring to %s", dbus_message_get_sender(msg));
+
+        DBusMessage *error = dbus_message_new_error(msg,
+            "org.skapty6260.DesktopEngine.Buffer_Broadcast.Error.Failed",
+            "Failed to send buffer ring");
+        if (error) {
+            dbus_connection_send(conn, error, NULL);
+            dbus_message_unref(error);
+        }
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    SERVER_DEBUG("Buffer ring opened for %s", dbus_message_get_sender(msg));
     return DBUS_HANDLER_RESULT_HANDLED;
 }
 
-/* Signal function */
-void buffer_module_send_update_signal(DBusConnection *conn, const BufferInfo *info) {
-    if (!conn || !info) {
+/* Signals are queued for the D-Bus thread, a stalled bus must not block the Wayland thread */
+static bool buffer_module_emit(struct dbus_server *server, DBusMessage *signal, uint32_t coalesce_key) {
+    if (!dbus_server_send_async(server, signal, coalesce_key)) {
+        SERVER_DEBUG("D-Bus signal dropped, outbound queue is full");
+        return false;
+    }
+    return true;
+}
+
+/* Signal functions */
+bool buffer_module_send_registered_signal(struct dbus_server *server, const BufferInfo *info) {
+    if (!server || !info) {
         SERVER_ERROR("Invalid parameters");
-        return;
+        return false;
     }
 
-    SERVER_DEBUG("=== SENDING BUFFER SIGNAL WITH FD ===");
+    SERVER_DEBUG("=== SENDING BUFFER REGISTRATION WITH FD ===");
     
     DBusMessage *signal = dbus_message_new_signal(
         "/org/skapty6260/DesktopEngine/Buffer",
         "org.skapty6260.DesktopEngine.Buffer",
-        "Updated");
+        "BufferRegistered");
     
     if (!signal) {
         SERVER_ERROR("Failed to create D-Bus signal");
-        return;
+        return false;
     }
     
     // Подготовка метаданных
@@ -149,48 +222,206 @@ void buffer_module_send_update_signal(DBusConnection *conn, const BufferInfo *in
     
     // Добавляем поля в структуру:
     
-    // 1. width (uint32)
+    // 1. buffer id (uint32), later Updated/BufferDestroyed signals refer to it
+    dbus_uint32_t buffer_id = info->buffer_id;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &buffer_id);
+    
+    // 2. width (uint32)
     dbus_uint32_t width = info->width;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &width);
     
-    // 2. height (uint32)
+    // 3. height (uint32)
     dbus_uint32_t height = info->height;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &height);
     
-    // 3. stride (uint32)
+    // 4. stride (uint32)
     dbus_uint32_t stride = info->stride;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &stride);
     
-    // 4. format (uint32)
+    // 5. format (uint32)
     dbus_uint32_t format = info->format;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &format);
     
-    // 5. type string
+    // 6. type string
     const char *type_ptr = type_str;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &type_ptr);
     
-    // 6. format string
+    // 7. format string
     const char *format_str_ptr = info->format_str ? info->format_str : "";
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &format_str_ptr);
     
-    // 7. UNIX FD
+    // 8. UNIX FD (dup'ed into the message here, the buffer may be gone when it is sent)
     int fd = info->fd;
     dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UNIX_FD, &fd);
     
+    // 9. offset (uint32) of the first pixel in fd, pools hold many buffers
+    dbus_uint32_t offset = info->offset;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &offset);
+    
+    // 10. modifier (uint64), DRM_FORMAT_MOD_LINEAR for SHM
+    dbus_uint64_t modifier = info->modifier;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &modifier);
+    
+    // 11. extra planes a(huu): fd, offset, stride of planes 1..n-1 (multi-planar DMA-BUF)
+    DBusMessageIter planes_iter;
+    dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "(huu)", &planes_iter);
+    for (uint32_t i = 0; i < info->extra_planes && i < BUFFER_DMABUF_MAX_PLANES - 1; i++) {
+        int plane_fd = info->plane_fds[i];
+        dbus_uint32_t plane_offset = info->plane_offsets[i];
+        dbus_uint32_t plane_stride = info->plane_strides[i];
+
+        DBusMessageIter plane_iter;
+        dbus_message_iter_open_container(&planes_iter, DBUS_TYPE_STRUCT, NULL, &plane_iter);
+        dbus_message_iter_append_basic(&plane_iter, DBUS_TYPE_UNIX_FD, &plane_fd);
+        dbus_message_iter_append_basic(&plane_iter, DBUS_TYPE_UINT32, &plane_offset);
+        dbus_message_iter_append_basic(&plane_iter, DBUS_TYPE_UINT32, &plane_stride);
+        dbus_message_iter_close_container(&planes_iter, &plane_iter);
+    }
+    dbus_message_iter_close_container(&struct_iter, &planes_iter);
+    
     // Закрываем структуру
     dbus_message_iter_close_container(&iter, &struct_iter);
     
-    SERVER_DEBUG("Buffer signal prepared: %ux%u, stride=%u, fd=%d", 
-                info->width, info->height, info->stride, info->fd);
+    SERVER_DEBUG("Buffer %u registration prepared: %ux%u, stride=%u, format=0x%x, fd=%d, offset=%u",
+                info->buffer_id, info->width, info->height, info->stride, info->format, info->fd, info->offset);
+    
+    return buffer_module_emit(server, signal, 0);
+}
+
+static DBusMessage *buffer_update_signal_new(uint32_t buffer_id, uint32_t surface_id, uint32_t serial,
+                                             const struct region *damage) {
+    DBusMessage *signal = dbus_message_new_signal(
+        "/org/skapty6260/DesktopEngine/Buffer",
+        "org.skapty6260.DesktopEngine.Buffer",
+        "Updated");
+    
+    if (!signal) {
+        SERVER_ERROR("Failed to create D-Bus signal");
+        return NULL;
+    }
+    
+    DBusMessageIter iter, struct_iter;
+    dbus_message_iter_init_append(signal, &iter);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_STRUCT, NULL, &struct_iter);
+    
+    // 1. buffer id (uint32), announced with BufferRegistered
+    dbus_uint32_t buffer_id_arg = buffer_id;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &buffer_id_arg);
+    
+    // 2. surface id (uint32), key for per-surface requests (e.g. dmabuf feedback)
+    dbus_uint32_t surface_id_arg = surface_id;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &surface_id_arg);
+    
+    // 3. serial (uint32), acked by consumers with Release
+    dbus_uint32_t serial_arg = serial;
+    dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT32, &serial_arg);
+    
+    // 4. damage rects a(iiii): x, y, width, height in buffer coords, empty = whole buffer
+    DBusMessageIter damage_iter;
+    dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "(iiii)", &damage_iter);
+    if (damage) {
+        for (uint32_t i = 0; i < damage->n_boxes; i++) {
+            const struct region_box *box = &damage->boxes[i];
+            dbus_int32_t rect[4] = { box->x1, box->y1, box->x2 - box->x1, box->y2 - box->y1 };
+
+            DBusMessageIter rect_iter;
+            dbus_message_iter_open_container(&damage_iter, DBUS_TYPE_STRUCT, NULL, &rect_iter);
+            for (int j = 0; j < 4; j++) {
+                dbus_message_iter_append_basic(&rect_iter, DBUS_TYPE_INT32, &rect[j]);
+            }
+            dbus_message_iter_close_container(&damage_iter, &rect_iter);
+        }
+    }
+    dbus_message_iter_close_container(&struct_iter, &damage_iter);
+    
+    dbus_message_iter_close_container(&iter, &struct_iter);
+    return signal;
+}
+
+bool buffer_module_send_update_signal(struct dbus_server *server, const BufferInfo *info) {
+    if (!server || !info) {
+        SERVER_ERROR("Invalid parameters");
+        return false;
+    }
+
+    DBusMessage *signal = buffer_update_signal_new(info->buffer_id, info->surface_id, info->serial, info->damage);
+    if (!signal) return false;
+    
+    SERVER_DEBUG("Buffer update prepared: buffer=%u, surface=%u, serial=%u, damage boxes=%u",
+                info->buffer_id, info->surface_id, info->serial, info->damage ? info->damage->n_boxes : 0);
     
-    // Отправляем сигнал
-    dbus_uint32_t serial = 0;
-    if (!dbus_connection_send(conn, signal, &serial)) {
-        SERVER_ERROR("Failed to send D-Bus signal");
-    } else {
-        SERVER_DEBUG("D-Bus signal sent, serial: %u", serial);
-        dbus_connection_flush(conn);
+    /* Updates of one surface coalesce when the bus backs up */
+    return buffer_module_emit(server, signal, info->surface_id);
+}
+
+/* Reads (buffer id, surface id, serial) of an Updated signal */
+static bool buffer_update_signal_parse(DBusMessage *signal, uint32_t *buffer_id, uint32_t *surface_id, uint32_t *serial) {
+    DBusMessageIter iter, struct_iter;
+    if (!dbus_message_iter_init(signal, &iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRUCT) {
+        return false;
+    }
+    dbus_message_iter_recurse(&iter, &struct_iter);
+
+    uint32_t *fields[] = { buffer_id, surface_id, serial };
+    for (int i = 0; i < 3; i++) {
+        if (dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_UINT32) return false;
+        dbus_uint32_t value;
+        dbus_message_iter_get_basic(&struct_iter, &value);
+        *fields[i] = value;
+        dbus_message_iter_next(&struct_iter);
     }
+    return true;
+}
+
+/*
+ * Latest wins: the older serial is released right away, the newer update
+ * goes out with full damage since consumers never saw the older content.
+ */
+DBusMessage *buffer_module_merge_updates(DBusMessage *older, DBusMessage *newer, void *user_data) {
+    struct buffer_tracker *tracker = user_data;
+    uint32_t buffer_id, surface_id, serial;
+
+    if (buffer_update_signal_parse(older, &buffer_id, &surface_id, &serial)) {
+        buffer_tracker_push_event(tracker, BUFFER_TRACKER_DROPPED, "", serial);
+    }
+    dbus_message_unref(older);
+
+    if (!buffer_update_signal_parse(newer, &buffer_id, &surface_id, &serial)) {
+        return newer;
+    }
+
+    DBusMessage *merged = buffer_update_signal_new(buffer_id, surface_id, serial, NULL);
+    if (!merged) return newer;
+
+    dbus_message_unref(newer);
+    return merged;
+}
+
+void buffer_module_update_sent(DBusMessage *message, uint32_t coalesce_key, void *user_data) {
+    struct frame_timing *timing = user_data;
+    uint32_t buffer_id, surface_id, serial;
+
+    if (buffer_update_signal_parse(message, &buffer_id, &surface_id, &serial)) {
+        frame_timing_stamp_surface(timing, surface_id, serial, FRAME_STAMP_SEND, frame_timing_now());
+    }
+}
+
+bool buffer_module_send_destroyed_signal(struct dbus_server *server, uint32_t buffer_id) {
+    if (!server) return false;
+
+    DBusMessage *signal = dbus_message_new_signal(
+        "/org/skapty6260/DesktopEngine/Buffer",
+        "org.skapty6260.DesktopEngine.Buffer",
+        "BufferDestroyed");
     
-    dbus_message_unref(signal);
-}
\ No newline at end of file
+    if (!signal) {
+        SERVER_ERROR("Failed to create D-Bus signal");
+        return false;
+    }
+
+    dbus_uint32_t id = buffer_id;
+    dbus_message_append_args(signal, DBUS_TYPE_UINT32, &id, DBUS_TYPE_INVALID);
+    
+    SERVER_DEBUG("Buffer %u destroyed, notifying consumers", buffer_id);
+    return buffer_module_emit(server, signal, 0);
+}
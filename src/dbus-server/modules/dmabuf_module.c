@@ -0,0 +1,152 @@
+#include <dbus-server/modules/dmabuf_module.h>
+#include <dbus-server/typed_method.h>
+#include <logger.h>
+#include <stdlib.h>
+
+#ifdef HAVE_LINUX_DMABUF
+
+#define DMABUF_INVALID_ARGS_ERROR "org.skapty6260.DesktopEngine.Dmabuf_Feedback.Error.InvalidArgs"
+
+#define DMABUF_RESET_SURFACE_FEEDBACK_IN(A) A(UINT32, surface_id)
+DBUS_TYPED_METHOD(dmabuf_reset_surface_feedback, DMABUF_RESET_SURFACE_FEEDBACK_IN, DBUS_NO_ARGS)
+
+DBUS_MODULE *create_dmabuf_module(struct linux_dmabuf *dmabuf) {
+    DBUS_MODULE *module = module_create("Dmabuf_Feedback");
+    if (!module) {
+        DBUS_ERROR("Failed to create dmabuf module");
+        return NULL;
+    }
+
+    DBUS_INTERFACE *iface = module_add_interface(module,
+                                                "org.skapty6260.DesktopEngine.Dmabuf",
+                                                "/org/skapty6260/DesktopEngine/Dmabuf");
+    if (!iface) {
+        DBUS_ERROR("Failed to add interface to dmabuf module");
+        module_destroy(module);
+        return NULL;
+    }
+
+    /* SetSurfaceFeedback: surface id, tranches of (flags, [(drm format, modifier)]) by preference */
+    interface_add_method(iface, "SetSurfaceFeedback", "ua(ua(ut))", "", dmabuf_set_surface_feedback_handler, dmabuf);
+    /* ResetSurfaceFeedback: surface goes back to the default feedback */
+    interface_add_typed_method(iface, "ResetSurfaceFeedback", &dmabuf_reset_surface_feedback_desc, dmabuf);
+
+    DBUS_DEBUG("Dmabuf module created successfully");
+    return module;
+}
+
+static void send_empty_reply(DBusConnection *conn, DBusMessage *msg) {
+    if (dbus_message_get_no_reply(msg)) return;
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) return;
+
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+}
+
+static DBusHandlerResult send_invalid_args(DBusConnection *conn, DBusMessage *msg, const char *message) {
+    DBusMessage *error = dbus_message_new_error(msg, DMABUF_INVALID_ARGS_ERROR, message);
+    if (error) {
+        dbus_connection_send(conn, error, NULL);
+        dbus_message_unref(error);
+    }
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/* Parse one (ua(ut)) tranche, extra entries beyond the table size are ignored */
+static bool parse_tranche(DBusMessageIter *tranche_iter, struct linux_dmabuf_tranche_request *tranche) {
+    if (dbus_message_iter_get_arg_type(tranche_iter) != DBUS_TYPE_UINT32) return false;
+    dbus_message_iter_get_basic(tranche_iter, &tranche->flags);
+    dbus_message_iter_next(tranche_iter);
+
+    if (dbus_message_iter_get_arg_type(tranche_iter) != DBUS_TYPE_ARRAY) return false;
+
+    DBusMessageIter formats_iter;
+    dbus_message_iter_recurse(tranche_iter, &formats_iter);
+    while (dbus_message_iter_get_arg_type(&formats_iter) == DBUS_TYPE_STRUCT) {
+        DBusMessageIter pair_iter;
+        dbus_uint32_t format = 0;
+        dbus_uint64_t modifier = 0;
+
+        dbus_message_iter_recurse(&formats_iter, &pair_iter);
+        if (dbus_message_iter_get_arg_type(&pair_iter) != DBUS_TYPE_UINT32) return false;
+        dbus_message_iter_get_basic(&pair_iter, &format);
+        dbus_message_iter_next(&pair_iter);
+        if (dbus_message_iter_get_arg_type(&pair_iter) != DBUS_TYPE_UINT64) return false;
+        dbus_message_iter_get_basic(&pair_iter, &modifier);
+
+        if (tranche->n_formats < LINUX_DMABUF_TABLE_MAX) {
+            tranche->formats[tranche->n_formats].format = format;
+            tranche->formats[tranche->n_formats].modifier = modifier;
+            tranche->n_formats++;
+        }
+        dbus_message_iter_next(&formats_iter);
+    }
+
+    return true;
+}
+
+DBusHandlerResult dmabuf_set_surface_feedback_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+    struct linux_dmabuf *dmabuf = user_data;
+
+    DBusMessageIter iter;
+    if (!dbus_message_iter_init(msg, &iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT32) {
+        return send_invalid_args(conn, msg, "Expected surface id");
+    }
+
+    struct linux_dmabuf_feedback_request *request = calloc(1, sizeof(struct linux_dmabuf_feedback_request));
+    if (!request) {
+        return DBUS_HANDLER_RESULT_NEED_MEMORY;
+    }
+
+    dbus_message_iter_get_basic(&iter, &request->surface_id);
+    dbus_message_iter_next(&iter);
+
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+        free(request);
+        return send_invalid_args(conn, msg, "Expected tranche array");
+    }
+
+    DBusMessageIter tranches_iter;
+    dbus_message_iter_recurse(&iter, &tranches_iter);
+    while (dbus_message_iter_get_arg_type(&tranches_iter) == DBUS_TYPE_STRUCT) {
+        if (request->n_tranches == LINUX_DMABUF_MAX_TRANCHES) {
+            DBUS_WARN("Dmabuf feedback for surface %u: more than %d tranches, rest ignored",
+                      request->surface_id, LINUX_DMABUF_MAX_TRANCHES);
+            break;
+        }
+
+        DBusMessageIter tranche_iter;
+        dbus_message_iter_recurse(&tranches_iter, &tranche_iter);
+        if (!parse_tranche(&tranche_iter, &request->tranches[request->n_tranches])) {
+            free(request);
+            return send_invalid_args(conn, msg, "Malformed tranche");
+        }
+        request->n_tranches++;
+        dbus_message_iter_next(&tranches_iter);
+    }
+
+    DBUS_DEBUG("Dmabuf feedback for surface %u: %u tranche(s)", request->surface_id, request->n_tranches);
+    linux_dmabuf_request_surface_feedback(dmabuf, request);
+    send_empty_reply(conn, msg);
+
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+DBUS_TYPED_METHOD_IMPL(dmabuf_reset_surface_feedback) {
+    struct linux_dmabuf *dmabuf = user_data;
+
+    struct linux_dmabuf_feedback_request *request = calloc(1, sizeof(struct linux_dmabuf_feedback_request));
+    if (!request) {
+        error->name = DBUS_ERROR_NO_MEMORY;
+        error->message = "Out of memory";
+        return false;
+    }
+
+    request->surface_id = in->surface_id;
+    linux_dmabuf_request_surface_feedback(dmabuf, request);
+    return true;
+}
+
+#endif
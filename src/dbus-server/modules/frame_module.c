@@ -0,0 +1,49 @@
+#include <dbus-server/modules/frame_module.h>
+#include <dbus-server/typed_method.h>
+#include <logger.h>
+#include <stdlib.h>
+
+DBUS_TYPED_METHOD(frame_presented, DBUS_NO_ARGS, DBUS_NO_ARGS)
+
+#define FRAME_SET_REFRESH_RATE_IN(A) A(UINT32, refresh_mhz)
+DBUS_TYPED_METHOD(frame_set_refresh_rate, FRAME_SET_REFRESH_RATE_IN, DBUS_NO_ARGS)
+
+DBUS_MODULE *create_frame_module(struct frame_scheduler *scheduler) {
+    DBUS_MODULE *module = module_create("Frame_Scheduler");
+    if (!module) {
+        DBUS_ERROR("Failed to create frame module");
+        return NULL;
+    }
+
+    DBUS_INTERFACE *iface = module_add_interface(module,
+                                                "org.skapty6260.DesktopEngine.Frame",
+                                                "/org/skapty6260/DesktopEngine/Frame");
+    if (!iface) {
+        DBUS_ERROR("Failed to add interface to frame module");
+        module_destroy(module);
+        return NULL;
+    }
+
+    /* Presented: renderer finished presenting a frame (vblank in feedback mode) */
+    interface_add_typed_method(iface, "Presented", &frame_presented_desc, scheduler);
+    /* SetRefreshRate: virtual vblank rate in mHz, 0 = presentation feedback */
+    interface_add_typed_method(iface, "SetRefreshRate", &frame_set_refresh_rate_desc, scheduler);
+
+    DBUS_DEBUG("Frame module created successfully");
+    return module;
+}
+
+DBUS_TYPED_METHOD_IMPL(frame_presented) {
+    struct frame_scheduler *scheduler = user_data;
+
+    frame_scheduler_notify_presented(scheduler);
+    return true;
+}
+
+DBUS_TYPED_METHOD_IMPL(frame_set_refresh_rate) {
+    struct frame_scheduler *scheduler = user_data;
+
+    DBUS_DEBUG("Frame refresh rate requested: %u mHz", in->refresh_mhz);
+    frame_scheduler_request_refresh_mhz(scheduler, in->refresh_mhz);
+    return true;
+}
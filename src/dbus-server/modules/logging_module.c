@@ -0,0 +1,89 @@
+#include <dbus-server/modules/logging_module.h>
+#include <dbus-server/typed_method.h>
+#include <logger.h>
+#include <strings.h>
+
+#define LOGGING_INVALID_ARGS_ERROR "org.skapty6260.DesktopEngine.Logging.Error.InvalidArgs"
+
+/* Module and level names as printed in log lines, case-insensitive; module "all" sets every module */
+#define LOGGING_SET_LEVEL_IN(A)  A(STRING, module) A(STRING, level)
+DBUS_TYPED_METHOD(logging_set_level, LOGGING_SET_LEVEL_IN, DBUS_NO_ARGS)
+
+#define LOGGING_GET_LEVEL_IN(A)  A(STRING, module)
+#define LOGGING_GET_LEVEL_OUT(A) A(STRING, level)
+DBUS_TYPED_METHOD(logging_get_level, LOGGING_GET_LEVEL_IN, LOGGING_GET_LEVEL_OUT)
+
+static int module_from_name(const char *name) {
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        if (strcasecmp(name, logger_module_name((log_module_t)i)) == 0) return i;
+    }
+    return -1;
+}
+
+static int level_from_name(const char *name) {
+    for (int i = LOG_LEVEL_DEBUG; i <= LOG_LEVEL_FATAL; i++) {
+        if (strcasecmp(name, logger_level_name((log_level_t)i)) == 0) return i;
+    }
+    return -1;
+}
+
+DBUS_MODULE *create_logging_module(void) {
+    DBUS_MODULE *module = module_create("Logging");
+    if (!module) {
+        DBUS_ERROR("Failed to create logging module");
+        return NULL;
+    }
+
+    DBUS_INTERFACE *iface = module_add_interface(module,
+                                                "org.skapty6260.DesktopEngine.Logging",
+                                                "/org/skapty6260/DesktopEngine/Logging");
+    if (!iface) {
+        DBUS_ERROR("Failed to add interface to logging module");
+        module_destroy(module);
+        return NULL;
+    }
+
+    interface_add_typed_method(iface, "SetLevel", &logging_set_level_desc, NULL);
+    interface_add_typed_method(iface, "GetLevel", &logging_get_level_desc, NULL);
+
+    DBUS_DEBUG("Logging module created successfully");
+    return module;
+}
+
+DBUS_TYPED_METHOD_IMPL(logging_set_level) {
+    int level = level_from_name(in->level);
+    if (level < 0) {
+        error->name = LOGGING_INVALID_ARGS_ERROR;
+        error->message = "Unknown log level";
+        return false;
+    }
+
+    if (strcasecmp(in->module, "all") == 0) {
+        for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+            logger_set_module_level((log_module_t)i, (log_level_t)level);
+        }
+    } else {
+        int module = module_from_name(in->module);
+        if (module < 0) {
+            error->name = LOGGING_INVALID_ARGS_ERROR;
+            error->message = "Unknown log module";
+            return false;
+        }
+        logger_set_module_level((log_module_t)module, (log_level_t)level);
+    }
+
+    DBUS_INFO("Log level of %s set to %s", in->module, logger_level_name((log_level_t)level));
+    return true;
+}
+
+DBUS_TYPED_METHOD_IMPL(logging_get_level) {
+    int module = module_from_name(in->module);
+    if (module < 0) {
+        error->name = LOGGING_INVALID_ARGS_ERROR;
+        error->message = "Unknown log module";
+        return false;
+    }
+
+    out->level = logger_level_name(logger_get_module_level((log_module_t)module));
+    return true;
+}
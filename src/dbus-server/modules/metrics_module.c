@@ -0,0 +1,122 @@
+#include <dbus-server/modules/metrics_module.h>
+#include <dbus-server/typed_method.h>
+#include <logger.h>
+#include <stdlib.h>
+
+#define METRICS_INVALID_ARGS_ERROR "org.skapty6260.DesktopEngine.Metrics.Error.InvalidArgs"
+
+/* Renderer-side stamps of an Updated serial, CLOCK_MONOTONIC ns, 0 = not measured */
+#define METRICS_REPORT_IN(A) A(UINT32, surface_id) A(UINT32, serial) \
+                             A(UINT64, received_ns) A(UINT64, uploaded_ns) A(UINT64, presented_ns)
+DBUS_TYPED_METHOD(metrics_report, METRICS_REPORT_IN, DBUS_NO_ARGS)
+
+/* Stage names: attach_commit ... upload_present, commit_present */
+#define METRICS_GET_LATENCY_IN(A)  A(UINT32, surface_id) A(STRING, stage)
+#define METRICS_GET_LATENCY_OUT(A) A(UINT64, count) A(UINT64, p50_ns) A(UINT64, p90_ns) \
+                                   A(UINT64, p99_ns) A(UINT64, max_ns)
+DBUS_TYPED_METHOD(metrics_get_latency, METRICS_GET_LATENCY_IN, METRICS_GET_LATENCY_OUT)
+
+#define METRICS_RESET_IN(A) A(UINT32, surface_id)
+DBUS_TYPED_METHOD(metrics_reset, METRICS_RESET_IN, DBUS_NO_ARGS)
+
+DBUS_MODULE *create_metrics_module(struct frame_timing *timing) {
+    DBUS_MODULE *module = module_create("Metrics");
+    if (!module) {
+        DBUS_ERROR("Failed to create metrics module");
+        return NULL;
+    }
+
+    DBUS_INTERFACE *iface = module_add_interface(module,
+                                                "org.skapty6260.DesktopEngine.Metrics",
+                                                "/org/skapty6260/DesktopEngine/Metrics");
+    if (!iface) {
+        DBUS_ERROR("Failed to add interface to metrics module");
+        module_destroy(module);
+        return NULL;
+    }
+
+    /* Report: receive/upload/present of a frame, closes its per-surface latency stages */
+    interface_add_typed_method(iface, "Report", &metrics_report_desc, timing);
+    /* GetLatency: percentiles of one stage since the surface appeared or the last Reset */
+    interface_add_typed_method(iface, "GetLatency", &metrics_get_latency_desc, timing);
+    /* Reset: clear the histograms of one surface, 0 = all */
+    interface_add_typed_method(iface, "Reset", &metrics_reset_desc, timing);
+    /* ListSurfaces: ids of the measured surfaces */
+    interface_add_method(iface, "ListSurfaces", "", "au", metrics_list_surfaces_handler, timing);
+
+    DBUS_DEBUG("Metrics module created successfully");
+    return module;
+}
+
+DBUS_TYPED_METHOD_IMPL(metrics_report) {
+    struct frame_timing *timing = user_data;
+    const uint64_t stamps[] = { in->received_ns, in->uploaded_ns, in->presented_ns };
+
+    /* Frames recycled before the report arrived are ignored, the renderer cannot tell */
+    for (int i = 0; i < 3; i++) {
+        if (stamps[i]) {
+            frame_timing_stamp_surface(timing, in->surface_id, in->serial,
+                                       (enum frame_stamp)(FRAME_STAMP_RECEIVE + i), stamps[i]);
+        }
+    }
+    return true;
+}
+
+DBUS_TYPED_METHOD_IMPL(metrics_get_latency) {
+    struct frame_timing *timing = user_data;
+
+    int stage = frame_timing_stage_from_name(in->stage);
+    if (stage < 0) {
+        error->name = METRICS_INVALID_ARGS_ERROR;
+        error->message = "Unknown latency stage";
+        return false;
+    }
+
+    struct frame_timing_summary summary;
+    if (!frame_timing_summary(timing, in->surface_id, (enum frame_stage)stage, &summary)) {
+        error->name = METRICS_INVALID_ARGS_ERROR;
+        error->message = "Surface is not measured";
+        return false;
+    }
+
+    out->count = summary.count;
+    out->p50_ns = summary.p50;
+    out->p90_ns = summary.p90;
+    out->p99_ns = summary.p99;
+    out->max_ns = summary.max;
+    return true;
+}
+
+DBUS_TYPED_METHOD_IMPL(metrics_reset) {
+    struct frame_timing *timing = user_data;
+
+    if (!frame_timing_reset(timing, in->surface_id)) {
+        error->name = METRICS_INVALID_ARGS_ERROR;
+        error->message = "Surface is not measured";
+        return false;
+    }
+    return true;
+}
+
+DBusHandlerResult metrics_list_surfaces_handler(DBusConnection *conn, DBusMessage *msg, void *user_data) {
+    struct frame_timing *timing = user_data;
+
+    uint32_t ids[FRAME_TIMING_MAX_SURFACES];
+    uint32_t count = frame_timing_surfaces(timing, ids, FRAME_TIMING_MAX_SURFACES);
+
+    DBusMessage *reply = dbus_message_new_method_return(msg);
+    if (!reply) return DBUS_HANDLER_RESULT_NEED_MEMORY;
+
+    DBusMessageIter iter, array_iter;
+    dbus_message_iter_init_append(reply, &iter);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, DBUS_TYPE_UINT32_AS_STRING, &array_iter);
+    for (uint32_t i = 0; i < count; i++) {
+        dbus_uint32_t id = ids[i];
+        dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_UINT32, &id);
+    }
+    dbus_message_iter_close_container(&iter, &array_iter);
+
+    dbus_connection_send(conn, reply, NULL);
+    dbus_message_unref(reply);
+    return DBUS_HANDLER_RESULT_HANDLED;
+}
@@ -0,0 +1,183 @@
+#include <dbus-server/outbound.h>
+#include <logger.h>
+
+#include <sys/eventfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define OUTBOUND_MASK (DBUS_OUTBOUND_CAPACITY - 1)
+
+struct dbus_outbound *dbus_outbound_create(void) {
+    /* sizeof is a multiple of the cache line alignment */
+    struct dbus_outbound *queue = aligned_alloc(_Alignof(struct dbus_outbound), sizeof(struct dbus_outbound));
+    if (!queue) {
+        DBUS_ERROR("Failed to allocate outbound queue");
+        return NULL;
+    }
+    memset(queue, 0, sizeof(*queue));
+
+    for (size_t i = 0; i < DBUS_OUTBOUND_CAPACITY; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->wakeup_pending, false);
+    atomic_init(&queue->dropped, 0);
+
+    queue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->event_fd < 0) {
+        DBUS_ERROR("Failed to create outbound eventfd: %s", strerror(errno));
+        free(queue);
+        return NULL;
+    }
+
+    return queue;
+}
+
+/* Consumer side, NULL when empty */
+static DBusMessage *outbound_pop(struct dbus_outbound *queue, uint32_t *coalesce_key) {
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    struct dbus_outbound_cell *cell = &queue->cells[pos & OUTBOUND_MASK];
+
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) {
+        return NULL;
+    }
+
+    DBusMessage *message = cell->message;
+    *coalesce_key = cell->coalesce_key;
+    cell->message = NULL;
+
+    atomic_store_explicit(&cell->sequence, pos + DBUS_OUTBOUND_CAPACITY, memory_order_release);
+    atomic_store_explicit(&queue->dequeue_pos, pos + 1, memory_order_release);
+    return message;
+}
+
+void dbus_outbound_destroy(struct dbus_outbound *queue) {
+    if (!queue) return;
+
+    uint32_t key;
+    DBusMessage *message;
+    while ((message = outbound_pop(queue, &key))) {
+        dbus_message_unref(message);
+    }
+
+    if (queue->event_fd >= 0) close(queue->event_fd);
+    free(queue);
+}
+
+void dbus_outbound_set_merge(struct dbus_outbound *queue, DBUS_OUTBOUND_MERGE merge, void *user_data) {
+    if (!queue) return;
+    queue->merge = merge;
+    queue->merge_data = user_data;
+}
+
+void dbus_outbound_set_sent(struct dbus_outbound *queue, DBUS_OUTBOUND_SENT sent, void *user_data) {
+    if (!queue) return;
+    queue->sent = sent;
+    queue->sent_data = user_data;
+}
+
+bool dbus_outbound_push(struct dbus_outbound *queue, DBusMessage *message, uint32_t coalesce_key) {
+    if (!queue || !message) return false;
+
+    /* Coalescable messages leave headroom for the ones that must not be lost */
+    size_t limit = coalesce_key ? DBUS_OUTBOUND_CAPACITY - DBUS_OUTBOUND_RESERVED : DBUS_OUTBOUND_CAPACITY;
+
+    struct dbus_outbound_cell *cell;
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    for (;;) {
+        cell = &queue->cells[pos & OUTBOUND_MASK];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if (diff == 0) {
+            size_t used = pos - atomic_load_explicit(&queue->dequeue_pos, memory_order_acquire);
+            if (used >= limit) goto full;
+
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            goto full;
+        } else {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+
+    cell->message = message;
+    cell->coalesce_key = coalesce_key;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+
+    /* One kick per drain is enough */
+    if (!atomic_exchange(&queue->wakeup_pending, true)) {
+        uint64_t one = 1;
+        if (write(queue->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+            DBUS_ERROR("Failed to wake D-Bus thread: %s", strerror(errno));
+        }
+    }
+    return true;
+
+full:
+    if (atomic_fetch_add(&queue->dropped, 1) % 1000 == 0) {
+        DBUS_WARN("Outbound queue full (bus stalled?), %lu message(s) dropped",
+                  atomic_load(&queue->dropped));
+    }
+    dbus_message_unref(message);
+    return false;
+}
+
+/* Merge every coalescable message into the newest one with its key, keeps order otherwise */
+static void outbound_coalesce(struct dbus_outbound *queue, size_t count) {
+    if (!queue->merge || count < 2) return;
+
+    for (size_t newer = count; newer-- > 1;) {
+        struct dbus_outbound_cell *latest = &queue->batch[newer];
+        if (!latest->message || !latest->coalesce_key) continue;
+
+        for (size_t older = newer; older-- > 0;) {
+            struct dbus_outbound_cell *cell = &queue->batch[older];
+            if (!cell->message || cell->coalesce_key != latest->coalesce_key) continue;
+
+            latest->message = queue->merge(cell->message, latest->message, queue->merge_data);
+            cell->message = NULL;
+        }
+    }
+}
+
+void dbus_outbound_flush(struct dbus_outbound *queue, DBusConnection *conn) {
+    if (!queue || !conn) return;
+
+    uint64_t value;
+    if (read(queue->event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        DBUS_ERROR("Failed to read outbound eventfd: %s", strerror(errno));
+    }
+    /* Producers kick again for anything queued from here on */
+    atomic_store(&queue->wakeup_pending, false);
+
+    size_t count = 0;
+    while (count < DBUS_OUTBOUND_CAPACITY) {
+        struct dbus_outbound_cell *cell = &queue->batch[count];
+        cell->message = outbound_pop(queue, &cell->coalesce_key);
+        if (!cell->message) break;
+        count++;
+    }
+
+    outbound_coalesce(queue, count);
+
+    /* send() writes what the socket takes without blocking, the rest goes with read_write */
+    for (size_t i = 0; i < count; i++) {
+        DBusMessage *message = queue->batch[i].message;
+        if (!message) continue;
+
+        if (!dbus_connection_send(conn, message, NULL)) {
+            DBUS_ERROR("Failed to send queued D-Bus message");
+        } else if (queue->sent && queue->batch[i].coalesce_key) {
+            queue->sent(message, queue->batch[i].coalesce_key, queue->sent_data);
+        }
+        dbus_message_unref(message);
+        queue->batch[i].message = NULL;
+    }
+}
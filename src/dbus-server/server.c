@@ -1,12 +1,26 @@
 #include <dbus-server/server.h>
+#include <dbus-server/wl_loop.h>
+#include <dbus-server/worker_pool.h>
 #include <logger.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <errno.h>
-#include <poll.h> 
+
+#define NAME_OWNER_CHANGED_MATCH \
+    "type='signal',sender='" DBUS_SERVICE_DBUS "',interface='" DBUS_INTERFACE_DBUS "',member='NameOwnerChanged'"
+
+/* Single-threaded mode has no loop thread to lock against */
+static inline void server_lock(struct dbus_server *server) {
+    if (!server->wl_loop) pthread_mutex_lock(&server->mutex);
+}
+
+static inline void server_unlock(struct dbus_server *server) {
+    if (!server->wl_loop) pthread_mutex_unlock(&server->mutex);
+}
 
 /* Init dbus connection */
 static DBusConnection *create_dbus_connection() {
@@ -65,170 +79,94 @@ static int request_bus_name(DBusConnection *conn, char *name) {
     }
 }
 
-/* String concat helper */
-// static char *str_append(char *dest, const char *src) {
-//     if (!src) return dest;
-    
-//     size_t dest_len = dest ? strlen(dest) : 0;
-//     size_t src_len = strlen(src);
-    
-//     char *new_str = realloc(dest, dest_len + src_len + 1);
-//     if (!new_str) {
-//         free(dest);
-//         return NULL;
-//     }
-    
-//     memcpy(new_str + dest_len, src, src_len + 1);
-//     return new_str;
-// }
-
-/* Generate introspect xml for root path (Overview for all interfaces and nodes, and root methods) */
-static char *generate_root_introsperction_xml(struct dbus_server *server) {
-    char *introspection_data = NULL;
-    DBUS_MODULE *module = server->modules;
-    
-    /* Start with XML header */
-    introspection_data = str_append(introspection_data, 
-        "<!DOCTYPE node PUBLIC \"-//freedesktop//DTD D-BUS Object Introspection 1.0//EN\"\n"
-        "\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd\">\n"
-        "<node>\n");
-    
-    /* Add standard Introspectable interface */
-    introspection_data = str_append(introspection_data,
-        "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
-        "    <method name=\"Introspect\">\n"
-        "      <arg name=\"data\" direction=\"out\" type=\"s\"/>\n"
-        "    </method>\n"
-        "  </interface>\n");
-    
-    /* Simple array to track seen nodes (max 100 nodes) */
-    const char *seen_nodes[100];
-    int seen_count = 0;
-    
-    while (module) {
-        DBUS_INTERFACE *iface = module->interfaces;
-        
-        while (iface) {
-            if (iface->object_path && strlen(iface->object_path) > 0) {
-                /* Extract the last component as node name */
-                const char *path = iface->object_path;
-                const char *last_slash = strrchr(path, '/');
-                
-                if (last_slash && *(last_slash + 1) != '\0') {
-                    const char *node_name = last_slash + 1;
-                    
-                    /* Check if we've already seen this node */
-                    int already_seen = 0;
-                    for (int i = 0; i < seen_count; i++) {
-                        if (strcmp(seen_nodes[i], node_name) == 0) {
-                            already_seen = 1;
-                            break;
-                        }
-                    }
-                    
-                    if (!already_seen && seen_count < 100) {
-                        seen_nodes[seen_count++] = node_name;
-                        
-                        /* Add node element */
-                        introspection_data = str_append(introspection_data, "  <node name=\"");
-                        introspection_data = str_append(introspection_data, node_name);
-                        introspection_data = str_append(introspection_data, "\"/>\n");
-                    }
-                }
-            }
-            iface = iface->next;
-        }
-        module = module->next;
+/* Handle introspect call */
+static void handle_introspect(struct dbus_server *server, DBusMessage *msg, const char *path) {
+    DBusMessage *reply = NULL;
+
+    server_lock(server);
+
+    /* Rebuilt lazily after module changes, node XML is cached inside */
+    if (!server->introspect_tree) {
+        server->introspect_tree = dbus_introspect_tree_build(server->modules);
     }
-    
-    /* Close the root node */
-    introspection_data = str_append(introspection_data, "</node>\n");
-    
-    return introspection_data;
-}
 
-/* Handle introspect call */ // TODO: Refactor
-static void handle_introspect(struct dbus_server *server, DBusMessage *msg, const char *path) {
-    char *introspection_data = NULL;
-
-    /* Generate dynamic XML */
-    pthread_mutex_lock(&server->mutex);
-
-    /* First try to find a match */
-    DBUS_MODULE *module = server->modules;
-    while (module) {
-        DBUS_INTERFACE *iface = module->interfaces;
-        
-        while (iface) {
-            if (iface->object_path && strcmp(iface->object_path, path) == 0) {
-                introspection_data = module_generate_introspection_xml(module, path);
-                break;
-            }
-            iface = iface->next;
+    const char *introspection_data = dbus_introspect_xml(server->introspect_tree, path, NULL);
+    if (introspection_data) {
+        reply = dbus_message_new_method_return(msg);
+        if (reply && !dbus_message_append_args(reply, DBUS_TYPE_STRING, &introspection_data, DBUS_TYPE_INVALID)) {
+            dbus_message_unref(reply);
+            reply = NULL;
         }
-        
-        if (introspection_data) break;
-        module = module->next;
+    } else if (server->introspect_tree) {
+        reply = dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_OBJECT, "No such object path");
     }
 
-    /* If no match found, sending root path */
-    if (!introspection_data) {
-        introspection_data = generate_root_introsperction_xml(server);
-    }
-        
-    pthread_mutex_unlock(&server->mutex);
-        
+    server_unlock(server);
+
     /* Send reply */
-    DBusMessage *reply = dbus_message_new_method_return(msg);
-    if (reply && introspection_data) {
-        dbus_message_append_args(reply, DBUS_TYPE_STRING, &introspection_data, DBUS_TYPE_INVALID);
+    if (reply) {
         dbus_connection_send(server->connection, reply, NULL);
+        dbus_message_unref(reply);
     } else {
         DBUS_ERROR("Failed to create Introspect reply");
     }
-        
-    if (introspection_data) free(introspection_data);
 }
 
 /* Handle method call */
 static void handle_method_call(struct dbus_server *server, DBusMessage *msg, const char *interface, const char *method_name, const char *path) {
     DBusHandlerResult result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
-    
-    pthread_mutex_lock(&server->mutex);
-
-    /* Search through all modules for matching method */
-    DBUS_MODULE *module = server->modules;
-    while (module && result == DBUS_HANDLER_RESULT_NOT_YET_HANDLED) {
-        DBUS_METHOD *method = module_find_method(module, interface, method_name, path);
-        if (method && method->handler) {
-            /* Found handler - unlock mutex while calling handler */
-            pthread_mutex_unlock(&server->mutex);
-            
-            result = method->handler(server->connection, msg, method->user_data);
-            
-            /* Re-lock if we need to continue searching */
-            if (result == DBUS_HANDLER_RESULT_NOT_YET_HANDLED) {
-                pthread_mutex_lock(&server->mutex);
+
+    /* Read side of the table swap: the table and its methods stay alive until we leave */
+    atomic_fetch_add(&server->dispatch_readers, 1);
+
+    struct dbus_dispatch_table *table = atomic_load(&server->dispatch);
+    const char *error = DBUS_ERROR_UNKNOWN_METHOD, *error_message = "Method does not exist";
+
+    /* Registrations of the same method are tried in module order until one handles it */
+    const struct dbus_dispatch_entry *entry = dbus_dispatch_lookup(table, path, interface, method_name);
+    for (; entry && result == DBUS_HANDLER_RESULT_NOT_YET_HANDLED; entry = entry->next) {
+        DBUS_METHOD *method = entry->method;
+
+        if ((method->flags & DBUS_METHOD_TYPED) &&
+            !dbus_message_has_signature(msg, method->signature ? method->signature : "")) {
+            /* Typed handlers decode without checking, the signature is their contract */
+            error = DBUS_ERROR_INVALID_ARGS;
+            error_message = "Unexpected argument signature";
+        } else if (method->flags & DBUS_METHOD_WORKER) {
+            /* Started on first use, only the dispatching thread gets here */
+            if (!server->workers) {
+                server->workers = dbus_worker_pool_create(server);
+            }
+
+            if (!dbus_worker_pool_submit(server->workers, method->worker_handler, method->user_data, msg)) {
+                DBusMessage *reply = dbus_message_new_error(msg, DBUS_ERROR_LIMITS_EXCEEDED, "Too many pending calls");
+                if (reply) {
+                    dbus_connection_send(server->connection, reply, NULL);
+                    dbus_message_unref(reply);
+                }
             }
+            result = DBUS_HANDLER_RESULT_HANDLED;
         } else {
-            module = module->next;
+            result = method->handler(server->connection, msg, method->user_data);
         }
     }
 
-    pthread_mutex_unlock(&server->mutex);
+    atomic_fetch_sub(&server->dispatch_readers, 1);
 
-    /* If no handler found, send error */
-    if (result == DBUS_HANDLER_RESULT_NOT_YET_HANDLED) {        
-        DBusMessage *reply = dbus_message_new_error(
-            msg,
-            DBUS_ERROR_UNKNOWN_METHOD,
-            "Method does not exist"
-        );
+    /* Every method call gets a reply, even when no handler took it */
+    if (result == DBUS_HANDLER_RESULT_NEED_MEMORY) {
+        error = DBUS_ERROR_NO_MEMORY;
+        error_message = "Out of memory";
+    }
+    if (result != DBUS_HANDLER_RESULT_HANDLED) {
+        DBusMessage *reply = dbus_message_new_error(msg, error, error_message);
         if (reply) {
             dbus_connection_send(server->connection, reply, NULL);
             dbus_message_unref(reply);
         }
     }
+
+    dbus_message_unref(msg);
 }
 
 /* Process dbus message */
@@ -249,88 +187,79 @@ static void proccess_message(struct dbus_server *server, DBusMessage *msg, const
     handle_method_call(server, msg, interface, method_name, path);
 }
 
+/* Signals are never answered, the only one we match is NameOwnerChanged */
+static void handle_signal(struct dbus_server *server, DBusMessage *msg) {
+    const char *name, *old_owner, *new_owner;
+
+    if (!server->name_lost || !dbus_message_has_sender(msg, DBUS_SERVICE_DBUS) ||
+        !dbus_message_is_signal(msg, DBUS_INTERFACE_DBUS, "NameOwnerChanged")) {
+        return;
+    }
+
+    if (!dbus_message_get_args(msg, NULL,
+                               DBUS_TYPE_STRING, &name,
+                               DBUS_TYPE_STRING, &old_owner,
+                               DBUS_TYPE_STRING, &new_owner,
+                               DBUS_TYPE_INVALID)) {
+        return;
+    }
+
+    /* Unique names are never reused, an empty new owner means the peer is gone */
+    if (name[0] == ':' && new_owner[0] == '\0') {
+        server->name_lost(name, server->name_lost_data);
+    }
+}
+
+/* Pop and handle every message libdbus has read */
+void dbus_server_dispatch(struct dbus_server *server) {
+    DBusMessage *msg;
+    while ((msg = dbus_connection_pop_message(server->connection))) {
+        const char *path = dbus_message_get_path(msg);
+        const char *interface = dbus_message_get_interface(msg);
+        const char *dest = dbus_message_get_destination(msg);
+
+        /* If destination is not us, continue*/
+        if (dest && server->bus_name && strcmp(dest, server->bus_name) != 0) {
+            dbus_message_unref(msg);
+            continue;
+        }
+
+        if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_SIGNAL) {
+            handle_signal(server, msg);
+            dbus_message_unref(msg);
+            continue;
+        }
+
+        const char *method_name = dbus_message_get_member(msg);
+        proccess_message(server, msg, path, interface, method_name);
+    }
+}
+
 /* Create dbus event loop thread */
 static void *dbus_main_loop_thread(void *arg) {
     struct dbus_server *server = (struct dbus_server *)arg;
 
-    if (!server || !server->connection) {
+    if (!server || !server->connection || !server->loop) {
         DBUS_ERROR("Invalid server parameter in thread");
         return NULL;
     }
 
     DBUS_INFO("D-Bus async main loop thread started");
 
-    /* Set connection to non-blocking */
-    dbus_connection_set_exit_on_disconnect(server->connection, FALSE);
-
-    /* Enable async dispatch (This tells D-Bus to queue messages instead of dispatching immediately) */
-    dbus_connection_set_dispatch_status_function(server->connection, NULL, NULL, NULL);
-    
-    /* Add filter to intercept our messages */
+    while (atomic_load_explicit(&server->is_running, memory_order_acquire)) {
+        dbus_server_dispatch(server);
 
-    /* Get dbus fd for polling */
-    int fd = -1;
-    if (!dbus_connection_get_unix_fd(server->connection, &fd)) {
-        DBUS_ERROR("Failed to get D-Bus connection file descriptor");
-        // dbus_connection_remove_filter(server->connection, message_filter, server);
-        return NULL;
-    }
-
-    while(1) {
-        pthread_mutex_lock(&server->mutex);
-        bool running = server->is_running;
-        pthread_mutex_unlock(&server->mutex);
-
-        if (!running) break;
-
-        /* Use poll() to wait for data on the connection */
-        struct pollfd pfd = {
-            .fd = fd,
-            .events = POLLIN,
-            .revents = 0
-        };
-        
-        /* Poll with 100ms timeout (non-blocking) */
-        int ret = poll(&pfd, 1, 100);
-        
-        if (ret < 0) {
-            if (errno == EINTR) continue; /* Interrupted by signal */
-            DBUS_ERROR("poll() failed: %s", strerror(errno));
-            break;
-        }
-        
-        if (ret == 0) {
-            continue;
+        /* Outbound messages wait in our queue (where they coalesce) while libdbus still has some to write,
+         * the write watch fires when the socket drains and we flush on the next pass */
+        if (!dbus_connection_has_messages_to_send(server->connection)) {
+            dbus_outbound_flush(server->outbound, server->connection);
         }
 
-        /* Check if connection has data */
-        if (pfd.revents & POLLIN) {
-            /* Process ALL messages in queue NON-BLOCKING */
-            dbus_connection_read_write(server->connection, 0);
-    
-            DBusMessage *msg;
-            while ((msg = dbus_connection_pop_message(server->connection))) {
-                const char *path = dbus_message_get_path(msg);
-                const char *interface = dbus_message_get_interface(msg);
-                const char *dest = dbus_message_get_destination(msg);
-
-                /* If destination is not us, continue*/
-                if (dest && server->bus_name && strcmp(dest, server->bus_name) != 0) {
-                    dbus_message_unref(msg);
-                    continue;
-                }
-
-                const char *method_name = dbus_message_get_member(msg);
-                proccess_message(server, msg, path, interface, method_name);
-            }
-        }
+        /* Blocks until the bus, a timeout, the outbound queue or a stop request needs us */
+        if (dbus_loop_dispatch(server->loop) < 0) break;
     }
 
-    /* Mark thread as finished */
-    pthread_mutex_lock(&server->mutex);
-    server->thread_id = 0;
-    pthread_mutex_unlock(&server->mutex);
-
+    DBUS_INFO("D-Bus main loop thread exiting");
     return NULL;
 }
 
@@ -339,43 +268,23 @@ static int dbus_stop_main_loop(struct dbus_server *server) {
     if (!server) {
         return -1;
     }
-    
-    pthread_mutex_lock(&server->mutex);
-    if (!server->is_running) {
-        pthread_mutex_unlock(&server->mutex);
-        return 0;
-    }
 
-    /* Check if thread actually started */
-    if (server->thread_id == 0) {
-        server->is_running = false;
-        pthread_mutex_unlock(&server->mutex);
-        DBUS_INFO("D-Bus thread hasn't started yet, marking as stopped");
+    if (!atomic_exchange(&server->is_running, false)) {
         return 0;
     }
-    
-    server->is_running = false;
-    pthread_mutex_unlock(&server->mutex);
-    
+
     DBUS_INFO("Stopping D-Bus main loop...");
-    
-    int max_wait_s = 3;
-    int wait_step_s = 0.1;
-
-    for (int waited = 0; waited < max_wait_s; waited += wait_step_s) {
-        pthread_mutex_lock(&server->mutex);
-        bool thread_done = (server->thread_id == 0);
-        pthread_mutex_unlock(&server->mutex);
-        
-        if (thread_done) {
-            DBUS_INFO("D-Bus thread exited gracefully");
-            return 0;
-        }
-        
-        sleep(wait_step_s);
+
+    dbus_loop_wakeup(server->loop);
+
+    int result = pthread_join(server->thread_id, NULL);
+    if (result != 0) {
+        DBUS_ERROR("Failed to join D-Bus thread: %s", strerror(result));
+        return -1;
     }
-    
-    return -1;
+
+    DBUS_INFO("D-Bus thread exited gracefully");
+    return 0;
 }
 
 /* Release bus name */
@@ -395,11 +304,32 @@ void release_bus_name(DBusConnection *conn, const char *name) {
     }
 }
 
+/* Publish a table for the current module list (mutex held), then wait out readers of the old one */
+static void server_publish_dispatch(struct dbus_server *server) {
+    /* Introspection borrows interfaces too, regenerated on the next Introspect */
+    dbus_introspect_tree_destroy(server->introspect_tree);
+    server->introspect_tree = NULL;
+
+    struct dbus_dispatch_table *table = dbus_dispatch_table_build(server->modules);
+    if (!table) {
+        DBUS_ERROR("Method dispatch disabled until the next module change");
+    }
+
+    struct dbus_dispatch_table *old = atomic_exchange(&server->dispatch, table);
+
+    /* A lookup that saw the old table bumped the counter before loading it */
+    while (atomic_load(&server->dispatch_readers) != 0) {
+        sched_yield();
+    }
+
+    dbus_dispatch_table_destroy(old);
+}
+
 /* Add module to list end */
 void dbus_server_add_module(struct dbus_server *server, DBUS_MODULE *module) {
     if (!server || !module) return;
 
-    pthread_mutex_lock(&server->mutex);
+    server_lock(server);
     
     module->next = NULL;
 
@@ -412,25 +342,27 @@ void dbus_server_add_module(struct dbus_server *server, DBUS_MODULE *module) {
         server->modules_tail = module;
     }
 
-    pthread_mutex_unlock(&server->mutex);
+    server_publish_dispatch(server);
+
+    server_unlock(server);
 }
 
 /* Search for module by name */
 DBUS_MODULE *dbus_server_find_module(struct dbus_server *server, char *name) {
     if (!server || !name) return NULL;
     
-    pthread_mutex_lock(&server->mutex);
+    server_lock(server);
     
     DBUS_MODULE *current = server->modules;
     while (current) {
         if (strcmp(current->name, name) == 0) {
-            pthread_mutex_unlock(&server->mutex);
+            server_unlock(server);
             return current;
         }
         current = current->next;
     }
     
-    pthread_mutex_unlock(&server->mutex);
+    server_unlock(server);
     return NULL;
 }
 
@@ -438,7 +370,7 @@ DBUS_MODULE *dbus_server_find_module(struct dbus_server *server, char *name) {
 void dbus_server_remove_module(struct dbus_server *server, char *name) {
     if (!server || !name) return;
     
-    pthread_mutex_lock(&server->mutex);
+    server_lock(server);
     
     DBUS_MODULE *current = server->modules;
     DBUS_MODULE *prev = NULL;
@@ -455,24 +387,30 @@ void dbus_server_remove_module(struct dbus_server *server, char *name) {
                 server->modules_tail = prev;
             }
             
+            /* Unpublished before its methods go away */
+            server_publish_dispatch(server);
             module_destroy(current);
-            pthread_mutex_unlock(&server->mutex);
+            server_unlock(server);
             return;
         }
         prev = current;
         current = current->next;
     }
     
-    pthread_mutex_unlock(&server->mutex);
+    server_unlock(server);
 }
 
 /* Destroy all modules */
 void dbus_server_remove_all_modules(struct dbus_server *server) {
     if (!server) return;
     
-    pthread_mutex_lock(&server->mutex);
+    server_lock(server);
     
     DBUS_MODULE *current = server->modules;
+    server->modules = NULL;
+    server->modules_tail = NULL;
+    server_publish_dispatch(server);
+
     while (current) {
         DBUS_MODULE *next = current->next;
         DBUS_DEBUG("Destroying module %s", current->name);
@@ -480,10 +418,7 @@ void dbus_server_remove_all_modules(struct dbus_server *server) {
         current = next;
     }
     
-    server->modules = NULL;
-    server->modules_tail = NULL;
-    
-    pthread_mutex_unlock(&server->mutex);
+    server_unlock(server);
 }
 
 /* Server constructor */
@@ -514,8 +449,21 @@ struct dbus_server *dbus_create_server(char *bus_name) {
     }
     server->bus_name = strdup(bus_name);
 
+    server->outbound = dbus_outbound_create();
+    if (!server->outbound) {
+        release_bus_name(server->connection, server->bus_name);
+        free(server->bus_name);
+        dbus_connection_unref(server->connection);
+        free(server);
+        return NULL;
+    }
+
     server->thread_id = 0;
-    server->is_running = false;
+    atomic_init(&server->is_running, false);
+    server->loop = NULL;
+    atomic_init(&server->dispatch, NULL);
+    atomic_init(&server->dispatch_readers, 0);
+    server->workers = NULL;
     server->modules = NULL;
     server->modules_tail = NULL;
 
@@ -529,48 +477,80 @@ int dbus_start_main_loop(struct dbus_server *server) {
         return -1;
     }
 
-    pthread_mutex_lock(&server->mutex);
-    if (server->is_running) {
-        pthread_mutex_unlock(&server->mutex);
+    if (atomic_load(&server->is_running)) {
         DBUS_INFO("Main loop is already running");
         return 0;
     }
 
-    server->is_running = true;
-    pthread_mutex_unlock(&server->mutex);
+    if (server->wl_loop) {
+        DBUS_ERROR("Can't start dbus main loop: already dispatched from the event loop");
+        return -1;
+    }
+
+    dbus_connection_set_exit_on_disconnect(server->connection, FALSE);
+
+    /* Watches are registered right away, the thread only waits on them */
+    if (!server->loop) {
+        server->loop = dbus_loop_create(server->connection);
+        if (!server->loop) return -1;
+
+        if (!dbus_loop_add_wakeup_fd(server->loop, server->outbound->event_fd)) {
+            dbus_loop_destroy(server->loop);
+            server->loop = NULL;
+            return -1;
+        }
+    }
+
+    atomic_store(&server->is_running, true);
 
-    /* Create thread */
+    /* Create thread, joined by dbus_stop_main_loop */
     int result = pthread_create(&server->thread_id, NULL, dbus_main_loop_thread, server);
     if (result != 0) {
         DBUS_ERROR("Failed to create D-Bus thread: %s", strerror(result));
-        pthread_mutex_lock(&server->mutex);
-        server->is_running = false;
-        pthread_mutex_unlock(&server->mutex);
+        atomic_store(&server->is_running, false);
         return -1;
     }
 
-    /* Detach the thread so it cleans up automatically */
-    pthread_detach(server->thread_id);
-
     DBUS_INFO("D-Bus main loop started in separate thread: %lu", (unsigned long)server->thread_id);
     return 0;
 }
 
+/* Register the connection on the Wayland event loop instead of running a thread */
+int dbus_server_attach_event_loop(struct dbus_server *server, struct wl_event_loop *loop) {
+    if (!server || !server->connection || !loop) {
+        DBUS_ERROR("Can't attach dbus to event loop: server not connected");
+        return -1;
+    }
+
+    if (atomic_load(&server->is_running) || server->wl_loop) {
+        DBUS_ERROR("D-Bus is already being dispatched");
+        return -1;
+    }
+
+    dbus_connection_set_exit_on_disconnect(server->connection, FALSE);
+
+    server->wl_loop = dbus_wl_loop_create(server, loop);
+    if (!server->wl_loop) return -1;
+
+    DBUS_INFO("D-Bus dispatched from the Wayland event loop (single-threaded)");
+    return 0;
+}
+
 /* Server cleanup */
 void dbus_server_cleanup(struct dbus_server *server) {
     if (!server) return;
 
     dbus_stop_main_loop(server);
-    for (int i = 0; i < 10; i++) {
-        pthread_mutex_lock(&server->mutex);
-        bool thread_done = (server->thread_id == 0);
-        pthread_mutex_unlock(&server->mutex);
-            
-        if (thread_done) break;
-            
-        DBUS_DEBUG("Waiting for D-Bus thread to exit...");
-        sleep(1);
-    }
+
+    /* Back to libdbus' own blocking I/O for the name release below */
+    dbus_loop_destroy(server->loop);
+    server->loop = NULL;
+    dbus_wl_loop_destroy(server->wl_loop);
+    server->wl_loop = NULL;
+
+    /* Workers queue their replies on the outbound queue, stop them before it goes */
+    dbus_worker_pool_destroy(server->workers);
+    server->workers = NULL;
 
     if (server->modules) {
         dbus_server_remove_all_modules(server);
@@ -586,6 +566,12 @@ void dbus_server_cleanup(struct dbus_server *server) {
         dbus_connection_unref(server->connection);
         server->connection = NULL;
     }
+
+    dbus_outbound_destroy(server->outbound);
+    server->outbound = NULL;
+
+    dbus_dispatch_table_destroy(atomic_exchange(&server->dispatch, NULL));
+    dbus_introspect_tree_destroy(server->introspect_tree);
     
     pthread_mutex_destroy(&server->mutex);
     free(server);
@@ -596,4 +582,24 @@ void dbus_server_cleanup(struct dbus_server *server) {
 DBusConnection *dbus_server_get_connection(struct dbus_server *server) {
     if (!server) return NULL;
     return server->connection;
-}
\ No newline at end of file
+}
+
+void dbus_server_set_name_lost(struct dbus_server *server, DBUS_NAME_LOST_HANDLER handler, void *user_data) {
+    if (!server || !server->connection) return;
+
+    /* No error argument: queued without waiting, the bus applies it before our later messages */
+    if (!server->name_lost) {
+        dbus_bus_add_match(server->connection, NAME_OWNER_CHANGED_MATCH, NULL);
+    }
+
+    server->name_lost = handler;
+    server->name_lost_data = user_data;
+}
+
+bool dbus_server_send_async(struct dbus_server *server, DBusMessage *message, uint32_t coalesce_key) {
+    if (!server || !server->outbound) {
+        if (message) dbus_message_unref(message);
+        return false;
+    }
+    return dbus_outbound_push(server->outbound, message, coalesce_key);
+}
@@ -0,0 +1,232 @@
+#include <dbus-server/wl_loop.h>
+#include <dbus-server/server.h>
+#include <logger.h>
+
+#include <stdlib.h>
+
+static void wl_loop_flush_outbound(struct dbus_wl_loop *wl_loop) {
+    DBusConnection *conn = wl_loop->server->connection;
+
+    bool backlog = dbus_connection_has_messages_to_send(conn);
+    if (!backlog) {
+        dbus_outbound_flush(wl_loop->server->outbound, conn);
+    }
+
+    /* The kick is level-triggered: ignore it until the write watch drains libdbus */
+    wl_event_source_fd_update(wl_loop->outbound_source, backlog ? 0 : WL_EVENT_READABLE);
+}
+
+static void handle_dispatch_idle(void *data) {
+    struct dbus_wl_loop *wl_loop = data;
+    wl_loop->dispatch_idle = NULL;
+
+    dbus_server_dispatch(wl_loop->server);
+    wl_loop_flush_outbound(wl_loop);
+}
+
+static void schedule_dispatch(struct dbus_wl_loop *wl_loop) {
+    if (wl_loop->dispatch_idle) return;
+    wl_loop->dispatch_idle = wl_event_loop_add_idle(wl_loop->loop, handle_dispatch_idle, wl_loop);
+}
+
+static void dispatch_status_changed(DBusConnection *connection, DBusDispatchStatus status, void *data) {
+    if (status == DBUS_DISPATCH_DATA_REMAINS) {
+        schedule_dispatch(data);
+    }
+}
+
+static int handle_outbound(int fd, uint32_t mask, void *data) {
+    wl_loop_flush_outbound(data);
+    return 0;
+}
+
+/* Watches */
+
+static int handle_watch(int fd, uint32_t mask, void *data) {
+    struct dbus_wl_source *entry = data;
+    struct dbus_wl_loop *wl_loop = entry->wl_loop;
+
+    unsigned int flags = 0;
+    if (mask & WL_EVENT_READABLE) flags |= DBUS_WATCH_READABLE;
+    if (mask & WL_EVENT_WRITABLE) flags |= DBUS_WATCH_WRITABLE;
+    if (mask & WL_EVENT_ERROR) flags |= DBUS_WATCH_ERROR;
+    if (mask & WL_EVENT_HANGUP) flags |= DBUS_WATCH_HANGUP;
+
+    /* May remove the watch (disconnect), entry is not used afterwards */
+    dbus_watch_handle(entry->object, flags);
+
+    wl_loop_flush_outbound(wl_loop);
+    return 0;
+}
+
+/* Keep an event source only while the watch is enabled */
+static bool update_watch(struct dbus_wl_source *entry) {
+    DBusWatch *watch = entry->object;
+
+    if (!dbus_watch_get_enabled(watch)) {
+        if (entry->source) {
+            wl_event_source_remove(entry->source);
+            entry->source = NULL;
+        }
+        return true;
+    }
+
+    unsigned int flags = dbus_watch_get_flags(watch);
+    uint32_t mask = 0;
+    if (flags & DBUS_WATCH_READABLE) mask |= WL_EVENT_READABLE;
+    if (flags & DBUS_WATCH_WRITABLE) mask |= WL_EVENT_WRITABLE;
+
+    if (entry->source) {
+        wl_event_source_fd_update(entry->source, mask);
+        return true;
+    }
+
+    /* libwayland dups the fd, so read and write watches on one socket can coexist */
+    entry->source = wl_event_loop_add_fd(entry->wl_loop->loop, dbus_watch_get_unix_fd(watch),
+                                         mask, handle_watch, entry);
+    if (!entry->source) {
+        DBUS_ERROR("Failed to add D-Bus watch to the event loop");
+        return false;
+    }
+    return true;
+}
+
+static dbus_bool_t add_watch(DBusWatch *watch, void *data) {
+    struct dbus_wl_source *entry = calloc(1, sizeof(struct dbus_wl_source));
+    if (!entry) return FALSE;
+
+    entry->wl_loop = data;
+    entry->object = watch;
+
+    if (!update_watch(entry)) {
+        free(entry);
+        return FALSE;
+    }
+
+    dbus_watch_set_data(watch, entry, NULL);
+    return TRUE;
+}
+
+static void remove_watch(DBusWatch *watch, void *data) {
+    struct dbus_wl_source *entry = dbus_watch_get_data(watch);
+    if (!entry) return;
+
+    if (entry->source) wl_event_source_remove(entry->source);
+    dbus_watch_set_data(watch, NULL, NULL);
+    free(entry);
+}
+
+static void toggle_watch(DBusWatch *watch, void *data) {
+    struct dbus_wl_source *entry = dbus_watch_get_data(watch);
+    if (entry) update_watch(entry);
+}
+
+/* Timeouts */
+
+static void arm_timeout(struct dbus_wl_source *entry) {
+    DBusTimeout *timeout = entry->object;
+
+    int delay = 0;
+    if (dbus_timeout_get_enabled(timeout)) {
+        delay = dbus_timeout_get_interval(timeout);
+        if (delay <= 0) delay = 1; /* 0 disarms */
+    }
+    wl_event_source_timer_update(entry->source, delay);
+}
+
+static int handle_timeout(void *data) {
+    struct dbus_wl_source *entry = data;
+    struct dbus_wl_loop *wl_loop = entry->wl_loop;
+
+    /* libdbus timeouts repeat, re-arm first: handling may remove the timeout */
+    arm_timeout(entry);
+    dbus_timeout_handle(entry->object);
+
+    wl_loop_flush_outbound(wl_loop);
+    return 0;
+}
+
+static dbus_bool_t add_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_wl_source *entry = calloc(1, sizeof(struct dbus_wl_source));
+    if (!entry) return FALSE;
+
+    entry->wl_loop = data;
+    entry->object = timeout;
+    entry->source = wl_event_loop_add_timer(entry->wl_loop->loop, handle_timeout, entry);
+    if (!entry->source) {
+        DBUS_ERROR("Failed to add D-Bus timeout to the event loop");
+        free(entry);
+        return FALSE;
+    }
+
+    arm_timeout(entry);
+    dbus_timeout_set_data(timeout, entry, NULL);
+    return TRUE;
+}
+
+static void remove_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_wl_source *entry = dbus_timeout_get_data(timeout);
+    if (!entry) return;
+
+    wl_event_source_remove(entry->source);
+    dbus_timeout_set_data(timeout, NULL, NULL);
+    free(entry);
+}
+
+static void toggle_timeout(DBusTimeout *timeout, void *data) {
+    struct dbus_wl_source *entry = dbus_timeout_get_data(timeout);
+    if (entry) arm_timeout(entry);
+}
+
+struct dbus_wl_loop *dbus_wl_loop_create(struct dbus_server *server, struct wl_event_loop *loop) {
+    if (!server || !server->connection || !loop) return NULL;
+
+    struct dbus_wl_loop *wl_loop = calloc(1, sizeof(struct dbus_wl_loop));
+    if (!wl_loop) {
+        DBUS_ERROR("Failed to allocate D-Bus event loop integration");
+        return NULL;
+    }
+
+    wl_loop->server = server;
+    wl_loop->loop = loop;
+
+    wl_loop->outbound_source = wl_event_loop_add_fd(loop, server->outbound->event_fd, WL_EVENT_READABLE,
+                                                    handle_outbound, wl_loop);
+    if (!wl_loop->outbound_source) {
+        DBUS_ERROR("Failed to add outbound queue to the event loop");
+        free(wl_loop);
+        return NULL;
+    }
+
+    DBusConnection *conn = server->connection;
+    if (!dbus_connection_set_watch_functions(conn, add_watch, remove_watch, toggle_watch, wl_loop, NULL) ||
+        !dbus_connection_set_timeout_functions(conn, add_timeout, remove_timeout, toggle_timeout, wl_loop, NULL)) {
+        DBUS_ERROR("Failed to set D-Bus watch/timeout functions");
+        dbus_wl_loop_destroy(wl_loop);
+        return NULL;
+    }
+    dbus_connection_set_dispatch_status_function(conn, dispatch_status_changed, wl_loop, NULL);
+
+    /* Messages read while requesting the bus name */
+    if (dbus_connection_get_dispatch_status(conn) == DBUS_DISPATCH_DATA_REMAINS) {
+        schedule_dispatch(wl_loop);
+    }
+
+    return wl_loop;
+}
+
+void dbus_wl_loop_destroy(struct dbus_wl_loop *wl_loop) {
+    if (!wl_loop) return;
+
+    /* libdbus calls remove for every watch/timeout, which frees our entries */
+    DBusConnection *conn = wl_loop->server->connection;
+    if (conn) {
+        dbus_connection_set_dispatch_status_function(conn, NULL, NULL, NULL);
+        dbus_connection_set_watch_functions(conn, NULL, NULL, NULL, NULL, NULL);
+        dbus_connection_set_timeout_functions(conn, NULL, NULL, NULL, NULL, NULL);
+    }
+
+    if (wl_loop->dispatch_idle) wl_event_source_remove(wl_loop->dispatch_idle);
+    if (wl_loop->outbound_source) wl_event_source_remove(wl_loop->outbound_source);
+    free(wl_loop);
+}
@@ -0,0 +1,187 @@
+#include <dbus-server/worker_pool.h>
+#include <dbus-server/server.h>
+#include <logger.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define WORKER_MASK (DBUS_WORKER_QUEUE - 1)
+
+static bool worker_push(struct dbus_worker *worker, const struct dbus_worker_task *task) {
+    bool pushed = false;
+
+    pthread_mutex_lock(&worker->mutex);
+    if (worker->tail - worker->head < DBUS_WORKER_QUEUE) {
+        worker->tasks[worker->tail++ & WORKER_MASK] = *task;
+        pushed = true;
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    return pushed;
+}
+
+static bool worker_pop(struct dbus_worker *worker, struct dbus_worker_task *task) {
+    bool popped = false;
+
+    pthread_mutex_lock(&worker->mutex);
+    if (worker->head != worker->tail) {
+        *task = worker->tasks[worker->head++ & WORKER_MASK];
+        popped = true;
+    }
+    pthread_mutex_unlock(&worker->mutex);
+
+    return popped;
+}
+
+/* Own queue first, then the others starting after us */
+static bool worker_next_task(struct dbus_worker *self, struct dbus_worker_task *task) {
+    struct dbus_worker_pool *pool = self->pool;
+    size_t index = (size_t)(self - pool->workers);
+
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        if (worker_pop(&pool->workers[(index + i) % pool->n_workers], task)) return true;
+    }
+    return false;
+}
+
+static void *worker_thread(void *arg) {
+    struct dbus_worker *self = arg;
+    struct dbus_worker_pool *pool = self->pool;
+
+    while (!atomic_load(&pool->stopping)) {
+        struct dbus_worker_task task;
+        if (worker_next_task(self, &task)) {
+            task.handler(task.reply->call, task.reply, task.user_data);
+            continue;
+        }
+
+        /* Extra posts (a call already stolen) only cost one empty pass */
+        while (sem_wait(&pool->wake) < 0 && errno == EINTR);
+    }
+
+    return NULL;
+}
+
+static void deferred_reply_free(DBUS_DEFERRED_REPLY *reply) {
+    dbus_message_unref(reply->call);
+    free(reply);
+}
+
+struct dbus_worker_pool *dbus_worker_pool_create(struct dbus_server *server) {
+    struct dbus_worker_pool *pool = calloc(1, sizeof(struct dbus_worker_pool));
+    if (!pool) {
+        DBUS_ERROR("Failed to allocate worker pool");
+        return NULL;
+    }
+
+    pool->server = server;
+    atomic_init(&pool->stopping, false);
+
+    if (sem_init(&pool->wake, 0, 0) < 0) {
+        DBUS_ERROR("Failed to initialize worker pool semaphore: %s", strerror(errno));
+        free(pool);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < DBUS_WORKER_THREADS; i++) {
+        struct dbus_worker *worker = &pool->workers[i];
+        worker->pool = pool;
+        pthread_mutex_init(&worker->mutex, NULL);
+
+        int result = pthread_create(&worker->thread, NULL, worker_thread, worker);
+        if (result != 0) {
+            DBUS_ERROR("Failed to create D-Bus worker thread: %s", strerror(result));
+            pthread_mutex_destroy(&worker->mutex);
+            break;
+        }
+        pool->n_workers++;
+    }
+
+    if (pool->n_workers == 0) {
+        sem_destroy(&pool->wake);
+        free(pool);
+        return NULL;
+    }
+
+    DBUS_INFO("D-Bus worker pool started with %zu thread(s)", pool->n_workers);
+    return pool;
+}
+
+void dbus_worker_pool_destroy(struct dbus_worker_pool *pool) {
+    if (!pool) return;
+
+    atomic_store(&pool->stopping, true);
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        sem_post(&pool->wake);
+    }
+
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        struct dbus_worker_task task;
+        while (worker_pop(&pool->workers[i], &task)) {
+            deferred_reply_free(task.reply);
+        }
+        pthread_mutex_destroy(&pool->workers[i].mutex);
+    }
+
+    sem_destroy(&pool->wake);
+    free(pool);
+}
+
+bool dbus_worker_pool_submit(struct dbus_worker_pool *pool, DBUS_WORKER_HANDLER handler,
+                             void *user_data, DBusMessage *message) {
+    if (!pool || !handler || !message) return false;
+
+    DBUS_DEFERRED_REPLY *reply = calloc(1, sizeof(DBUS_DEFERRED_REPLY));
+    if (!reply) return false;
+
+    reply->server = pool->server;
+    reply->call = dbus_message_ref(message);
+
+    struct dbus_worker_task task = {
+        .handler = handler,
+        .user_data = user_data,
+        .reply = reply,
+    };
+
+    for (size_t i = 0; i < pool->n_workers; i++) {
+        struct dbus_worker *worker = &pool->workers[pool->next++ % pool->n_workers];
+        if (worker_push(worker, &task)) {
+            sem_post(&pool->wake);
+            return true;
+        }
+    }
+
+    deferred_reply_free(reply);
+    return false;
+}
+
+void dbus_deferred_reply_send(DBUS_DEFERRED_REPLY *reply, DBusMessage *response) {
+    if (!reply) {
+        if (response) dbus_message_unref(response);
+        return;
+    }
+
+    if (dbus_message_get_no_reply(reply->call)) {
+        if (response) dbus_message_unref(response);
+    } else {
+        if (!response) response = dbus_message_new_method_return(reply->call);
+
+        /* The connection thread sends it, like signals from the Wayland thread */
+        if (!response || !dbus_server_send_async(reply->server, response, 0)) {
+            DBUS_ERROR("Failed to queue reply to %s", dbus_message_get_member(reply->call));
+        }
+    }
+
+    deferred_reply_free(reply);
+}
+
+void dbus_deferred_reply_error(DBUS_DEFERRED_REPLY *reply, const char *error_name, const char *error_message) {
+    if (!reply) return;
+
+    dbus_deferred_reply_send(reply, dbus_message_new_error(reply->call, error_name, error_message));
+}
@@ -1,26 +1,36 @@
+#define _GNU_SOURCE
 #include <logger.h>
+#include <logger_ring.h>
+#include <logger_sink.h>
 #include <errno.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 // Глобальные переменные
 static logger_config_t g_config;
-static FILE* g_log_file = NULL;
-static pthread_mutex_t g_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_log_mutex = PTHREAD_MUTEX_INITIALIZER; // Сериализация вывода
 static int g_logger_initialized = 0;
 
 // Очередь сообщений
-static log_message_t g_message_queue[1000];
-static int g_queue_head = 0;
-static int g_queue_tail = 0;
-static int g_queue_size = 0;
+static log_ring_t g_ring;
 static pthread_t g_worker_thread;
-static volatile sig_atomic_t g_worker_running = 0;
+static atomic_int g_worker_running = 0;
+static atomic_ulong g_dropped_messages = 0;
+
+// Поток-источник сообщения
+static _Thread_local uint32_t t_thread_id;
+static _Thread_local log_fields_t t_fields;
 
 // Глобальный флаг graceful shutdown
 volatile sig_atomic_t g_logger_graceful_shutdown = 0;
 
+// Уровни модулей
+atomic_int g_logger_module_levels[LOG_MODULE_COUNT];
+
 // Получение строкового представления уровня
-static const char* level_to_string(log_level_t level) {
+const char* logger_level_name(log_level_t level) {
     switch (level) {
         case LOG_LEVEL_DEBUG: return "DEBUG";
         case LOG_LEVEL_INFO:  return "INFO";
@@ -32,7 +42,7 @@ static const char* level_to_string(log_level_t level) {
 }
 
 // Получение строкового представления модуля
-static const char* module_to_string(log_module_t module) {
+const char* logger_module_name(log_module_t module) {
     switch (module) {
         case LOG_MODULE_SERVER:    return "SERVER";
         case LOG_MODULE_DBUS:  return "DBUS";
@@ -41,149 +51,109 @@ static const char* module_to_string(log_module_t module) {
     }
 }
 
-// Получение цвета для уровня
-static log_color_t level_to_color(log_level_t level) {
-    switch (level) {
-        case LOG_LEVEL_DEBUG: return LOG_COLOR_CYAN;
-        case LOG_LEVEL_INFO:  return LOG_COLOR_GREEN;
-        case LOG_LEVEL_WARN:  return LOG_COLOR_YELLOW;
-        case LOG_LEVEL_ERROR: return LOG_COLOR_RED;
-        case LOG_LEVEL_FATAL: return LOG_COLOR_BRIGHT_RED;
-        default: return LOG_COLOR_WHITE;
-    }
-}
-
-// Установка цвета терминала
-static void set_terminal_color(log_color_t color) {
-    if (g_config.use_colors && g_config.log_to_console) {
-        printf("\033[1;%dm", color);
-    }
-}
-
-// Сброс цвета терминала
-static void reset_terminal_color() {
-    if (g_config.use_colors && g_config.log_to_console) {
-        printf("\033[0m");
-    }
-}
-
-// Форматирование времени
-static void format_timestamp(char* buffer, size_t size, time_t timestamp) {
-    struct tm* tm_info = localtime(&timestamp);
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", tm_info);
-}
-
-// Добавление сообщения в очередь
-static int enqueue_message(const log_message_t* message) {
-    if (g_logger_graceful_shutdown) {
-        return 0; // Не принимаем новые сообщения во время shutdown
-    }
+// Обработка сообщения: flush - сразу отдать пакет выводам
+static void process_message(const log_message_t* message, int flush) {
+    // Ротация и fdatasync - дело рабочего потока, без него - вызывающего
+    int maintain = !flush || !atomic_load(&g_worker_running);
     
     pthread_mutex_lock(&g_log_mutex);
-    
-    if (g_queue_size >= 1000) {
-        pthread_mutex_unlock(&g_log_mutex);
-        return 0;
+    if (maintain) {
+        log_sink_maintain();
     }
-    
-    g_message_queue[g_queue_tail] = *message;
-    g_queue_tail = (g_queue_tail + 1) % 1000;
-    g_queue_size++;
-    
-    pthread_mutex_unlock(&g_log_mutex);
-    return 1;
-}
-
-// Извлечение сообщения из очереди
-static int dequeue_message(log_message_t* message) {
-    pthread_mutex_lock(&g_log_mutex);
-    
-    if (g_queue_size == 0) {
-        pthread_mutex_unlock(&g_log_mutex);
-        return 0; // Очередь пуста
+    log_sink_write(message);
+    if (flush || g_config.flush_immediately || message->level == LOG_LEVEL_FATAL) {
+        log_sink_flush();
     }
-    
-    *message = g_message_queue[g_queue_head];
-    g_queue_head = (g_queue_head + 1) % 1000;
-    g_queue_size--;
-    
     pthread_mutex_unlock(&g_log_mutex);
-    return 1;
-}
-
-// Запись сообщения в файл
-static void write_to_file(const log_message_t* message) {
-    if (!g_config.log_to_file || !g_log_file) return;
     
-    char timestamp[32];
-    format_timestamp(timestamp, sizeof(timestamp), message->timestamp);
-    
-    fprintf(g_log_file, "[%s] [%s] [%s] %s\n",
-            timestamp,
-            level_to_string(message->level),
-            module_to_string(message->module),
-            message->message);
+    // Рабочий поток пересчитает срок ротации после синхронной записи
+    if (!maintain) {
+        log_ring_kick(&g_ring);
+    }
     
-    if (g_config.flush_immediately) {
-        fflush(g_log_file);
+    // Обработка FATAL уровня
+    if (message->level == LOG_LEVEL_FATAL) {
+        fprintf(stderr, "FATAL error occurred. Terminating application.\n");
+        logger_cleanup();
+        exit(EXIT_FAILURE);
     }
 }
 
-// Вывод сообщения в консоль
-static void write_to_console(const log_message_t* message) {
-    if (!g_config.log_to_console) return;
-    
-    char timestamp[32];
-    format_timestamp(timestamp, sizeof(timestamp), message->timestamp);
-    
-    set_terminal_color(level_to_color(message->level));
+// Сообщение о потерянных записях (режим LOG_OVERFLOW_DROP)
+static void report_dropped(void) {
+    unsigned long dropped = atomic_exchange(&g_dropped_messages, 0);
+    if (dropped == 0) return;
     
-    printf("[%s] [%s] [%s] %s",
-           timestamp,
-           level_to_string(message->level),
-           module_to_string(message->module),
-           message->message);
-    
-    reset_terminal_color();
-    printf("\n");
+    union {
+        log_message_t message;
+        char bytes[sizeof(log_message_t) + 64];
+    } buffer;
+    log_message_t* message = &buffer.message;
+    message->level = LOG_LEVEL_WARN;
+    message->module = LOG_MODULE_CORE;
+    message->file = __FILE__;
+    message->line = __LINE__;
+    message->function = __func__;
+    message->timestamp = logger_monotonic_ns();
+    message->thread_id = 0;
+    memset(&message->fields, 0, sizeof(message->fields));
+    message->site = NULL;
+    message->format = NULL;
+    message->length = (size_t)snprintf(message->message, 64, "%lu log messages dropped: ring buffer full", dropped);
     
-    fflush(stdout);
+    process_message(message, 0);
 }
 
-// Обработка сообщения
-static void process_message(const log_message_t* message) {
-    write_to_console(message);
-    write_to_file(message);
+// Обработка всех опубликованных записей, один пакет на проход
+static void drain_ring(void) {
+    const log_ring_header_t* header;
     
-    // Обработка FATAL уровня
-    if (message->level == LOG_LEVEL_FATAL) {
-        fprintf(stderr, "FATAL error occurred. Terminating application.\n");
-        logger_cleanup();
-        exit(EXIT_FAILURE);
+    while ((header = log_ring_peek(&g_ring)) != NULL) {
+        process_message(log_ring_payload(header), 0);
+        log_ring_release(&g_ring, header);
     }
+    report_dropped();
+    
+    pthread_mutex_lock(&g_log_mutex);
+    log_sink_flush();
+    log_sink_maintain();
+    pthread_mutex_unlock(&g_log_mutex);
 }
 
 // Функция рабочего потока
 static void* worker_thread(void* arg) {
     (void)arg;
     
-    while (g_worker_running || g_queue_size > 0) {
-        log_message_t message;
+    while (atomic_load(&g_worker_running)) {
+        drain_ring();
         
-        if (dequeue_message(&message)) {
-            process_message(&message);
-        } else {
-            // Если очередь пуста и идет shutdown - выходим
-            if (g_logger_graceful_shutdown) {
-                break;
-            }
-            sleep(0);
-        }
+        // Просыпаемся и без сообщений, когда пора ротировать файл или делать fdatasync
+        pthread_mutex_lock(&g_log_mutex);
+        int timeout = log_sink_timeout_ms();
+        pthread_mutex_unlock(&g_log_mutex);
+        log_ring_wait(&g_ring, timeout);
     }
+    drain_ring();
     
     return NULL;
 }
 
+// Резервирование места в кольце с учетом политики переполнения
+static log_message_t* reserve_message(size_t length) {
+    struct timespec backoff = { 0, 50 * 1000 };
+    
+    for (;;) {
+        log_message_t* message = log_ring_reserve(&g_ring, sizeof(log_message_t) + length + 1);
+        if (message || g_config.overflow_policy != LOG_OVERFLOW_BLOCK ||
+            !atomic_load(&g_worker_running) || g_logger_graceful_shutdown) {
+            return message;
+        }
+        
+        log_ring_kick(&g_ring);
+        nanosleep(&backoff, NULL);
+    }
+}
+
 // Инициализация логгера
 int logger_init(const logger_config_t* config) {
     if (g_logger_initialized) {
@@ -192,28 +162,35 @@ int logger_init(const logger_config_t* config) {
     
     g_config = *config;
     
-    // Открытие файла лога
-    if (g_config.log_to_file && g_config.log_file_path[0] != '\0') {
-        g_log_file = fopen(g_config.log_file_path, "a");
-        if (!g_log_file) {
-            fprintf(stderr, "ERROR: Cannot open log file: %s\n", g_config.log_file_path);
-            g_config.log_to_file = 0;
-        }
+    // Уровни модулей: общий уровень, если не задан свой
+    for (int i = 0; i < LOG_MODULE_COUNT; i++) {
+        int level = g_config.module_levels[i] >= 0 ? g_config.module_levels[i] : (int)g_config.level;
+        atomic_store(&g_logger_module_levels[i], level);
     }
     
+    // Консоль и файл лога
+    log_sink_open(&g_config);
+    
     // Запуск асинхронного рабочего потока
     if (g_config.async_enabled) {
-        g_worker_running = 1;
-        if (pthread_create(&g_worker_thread, NULL, worker_thread, NULL) != 0) {
-            fprintf(stderr, "ERROR: Cannot create logger worker thread\n");
+        if (!log_ring_init(&g_ring, LOGGER_RING_SIZE)) {
+            fprintf(stderr, "ERROR: Cannot allocate logger ring buffer\n");
             g_config.async_enabled = 0;
+        } else {
+            atomic_store(&g_worker_running, 1);
+            if (pthread_create(&g_worker_thread, NULL, worker_thread, NULL) != 0) {
+                fprintf(stderr, "ERROR: Cannot create logger worker thread\n");
+                atomic_store(&g_worker_running, 0);
+                g_config.async_enabled = 0;
+                log_ring_destroy(&g_ring);
+            }
         }
     }
     
     g_logger_initialized = 1;
     
     LOG_INFO(LOG_MODULE_CORE, "Logger initialized. Level: %s, Async: %s", 
-             level_to_string(g_config.level),
+             logger_level_name(g_config.level),
              g_config.async_enabled ? "enabled" : "disabled");
     
     return 1;
@@ -227,51 +204,174 @@ void logger_cleanup(void) {
     g_logger_graceful_shutdown = 1;
     
     // Остановка рабочего потока
-    if (g_config.async_enabled && g_worker_running) {
-        g_worker_running = 0;
+    if (g_config.async_enabled && atomic_exchange(&g_worker_running, 0)) {
+        log_ring_kick(&g_ring);
         
-        // Простая версия - ждем завершения потока без таймаута
-        pthread_join(g_worker_thread, NULL);
+        // FATAL из самого рабочего потока: ждать некого
+        if (!pthread_equal(pthread_self(), g_worker_thread)) {
+            pthread_join(g_worker_thread, NULL);
+            
+            // Записи, опубликованные после последнего прохода потока
+            drain_ring();
+            log_ring_destroy(&g_ring);
+        }
     }
     
-    // Закрытие файла
-    if (g_log_file) {
-        fclose(g_log_file);
-        g_log_file = NULL;
-    }
+    // Остаток пакета и закрытие файла
+    pthread_mutex_lock(&g_log_mutex);
+    log_sink_close();
+    pthread_mutex_unlock(&g_log_mutex);
     
     g_logger_initialized = 0;
     g_logger_graceful_shutdown = 0; // Сбрасываем флаг
 }
 
+// Уровень модуля на лету
+void logger_set_module_level(log_module_t module, log_level_t level) {
+    if ((unsigned)module >= LOG_MODULE_COUNT) return;
+    atomic_store_explicit(&g_logger_module_levels[module], (int)level, memory_order_relaxed);
+}
+
+log_level_t logger_get_module_level(log_module_t module) {
+    if ((unsigned)module >= LOG_MODULE_COUNT) return LOG_LEVEL_FATAL;
+    return (log_level_t)atomic_load_explicit(&g_logger_module_levels[module], memory_order_relaxed);
+}
+
+// Публикация сообщения: data - готовый текст или упакованные аргументы
+static void submit_message(const log_message_t* header, const void* data, size_t length) {
+    // Асинхронная обработка через кольцевой буфер
+    log_message_t* message = NULL;
+    if (g_config.async_enabled && !g_logger_graceful_shutdown) {
+        message = reserve_message(length);
+        if (!message && g_config.overflow_policy == LOG_OVERFLOW_DROP) {
+            atomic_fetch_add(&g_dropped_messages, 1);
+            return;
+        }
+    }
+    
+    // Синхронная обработка: выключен async, shutdown или переполнение
+    union {
+        log_message_t message;
+        char bytes[sizeof(log_message_t) + LOGGER_MAX_MESSAGE];
+    } buffer;
+    int async = message != NULL;
+    if (!async) {
+        message = &buffer.message;
+    }
+    
+    *message = *header;
+    message->length = length;
+    memcpy(message->message, data, length);
+    message->message[length] = '\0';
+    
+    if (async) {
+        log_ring_commit(&g_ring, message);
+    } else {
+        process_message(message, 1);
+    }
+}
+
+// Разбор формата места вызова, один раз на место
+static int site_deferred(log_site_t* site, const char* format) {
+    int state = atomic_load_explicit(&site->state, memory_order_acquire);
+    
+    if (state == LOG_SITE_UNPARSED) {
+        if (atomic_compare_exchange_strong(&site->state, &state, LOG_SITE_PARSING)) {
+            int n_args = log_format_parse(format, site->args, LOG_FORMAT_MAX_ARGS);
+            site->format = format;
+            site->n_args = n_args < 0 ? 0 : (uint8_t)n_args;
+            state = n_args < 0 ? LOG_SITE_TEXT : LOG_SITE_DEFERRED;
+            atomic_store_explicit(&site->state, state, memory_order_release);
+        }
+    }
+    
+    // Пока другой поток разбирает формат - обычный путь
+    return state == LOG_SITE_DEFERRED && site->format == format;
+}
+
+// Форматирование на месте вызова
+static void log_text(const log_message_t* header, const char* format, va_list args) {
+    char text[LOGGER_MAX_MESSAGE];
+    int written = vsnprintf(text, sizeof(text), format, args);
+    
+    size_t length = written < 0 ? 0 : (size_t)written;
+    if (length >= sizeof(text)) {
+        length = sizeof(text) - 1;
+    }
+    
+    submit_message(header, text, length);
+}
+
+// gettid() один раз на поток
+static uint32_t current_thread_id(void) {
+    if (t_thread_id == 0) {
+        t_thread_id = (uint32_t)syscall(SYS_gettid);
+    }
+    return t_thread_id;
+}
+
+void logger_set_fields(const log_fields_t* fields) {
+    if (fields) {
+        t_fields = *fields;
+    } else {
+        memset(&t_fields, 0, sizeof(t_fields));
+    }
+}
+
 // Основная функция логирования
 void logger_log(log_level_t level, log_module_t module, const char* file, int line, 
                 const char* function, const char* format, ...) {
-    if (!g_logger_initialized || level < g_config.level) {
+    if (!g_logger_initialized || (unsigned)module >= LOG_MODULE_COUNT || !LOG_ENABLED(level, module)) {
         return;
     }
     
-    log_message_t message;
-    message.level = level;
-    message.module = module;
-    message.file = file;
-    message.line = line;
-    message.function = function;
-    message.timestamp = time(NULL);
+    log_message_t header = {
+        .level = level,
+        .module = module,
+        .file = file,
+        .line = line,
+        .function = function,
+        .timestamp = logger_monotonic_ns(),
+        .thread_id = current_thread_id(),
+        .fields = t_fields,
+    };
     
-    // Форматирование сообщения
     va_list args;
     va_start(args, format);
-    vsnprintf(message.message, sizeof(message.message), format, args);
+    log_text(&header, format, args);
     va_end(args);
+}
+
+// Логирование из макросов: аргументы копируются, форматирование откладывается
+void logger_log_site(log_site_t* site, const char* format, ...) {
+    // Уровень уже проверен в макросе
+    if (!g_logger_initialized) {
+        return;
+    }
     
-    // Синхронная или асинхронная обработка
-    if (g_config.async_enabled) {
-        if (!enqueue_message(&message)) {
-            // Если очередь переполнена, пишем синхронно
-            process_message(&message);
-        }
+    log_message_t header = {
+        .level = site->level,
+        .module = site->module,
+        .file = site->file,
+        .line = site->line,
+        .function = site->function,
+        .timestamp = logger_monotonic_ns(),
+        .thread_id = current_thread_id(),
+        .fields = t_fields,
+        .site = site,
+    };
+    
+    va_list args;
+    va_start(args, format);
+    if (site_deferred(site, format)) {
+        // Как и в log_text: место под '\0', который дописывает submit_message
+        uint8_t packed[LOGGER_MAX_MESSAGE];
+        size_t length = log_format_pack(site->args, site->n_args, args, packed, sizeof(packed) - 1);
+        
+        header.format = format;
+        submit_message(&header, packed, length);
     } else {
-        process_message(&message);
+        log_text(&header, format, args);
     }
-}
\ No newline at end of file
+    va_end(args);
+}
@@ -0,0 +1,295 @@
+#include <logger_format.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define SPEC_LITERAL -1         /* %% */
+#define SPEC_UNSUPPORTED -2
+
+typedef struct {
+    const char *start;          /* '%' */
+    const char *end;            /* One past the conversion */
+    int star_width;
+    int star_precision;
+    int type;                   /* log_arg_type_t or SPEC_* */
+} format_spec_t;
+
+enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_BIG_L };
+
+static int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static int integer_type(int length) {
+    switch (length) {
+        case LEN_L:  return LOG_ARG_LONG;
+        case LEN_LL: return LOG_ARG_LLONG;
+        case LEN_J:  return LOG_ARG_INTMAX;
+        case LEN_Z:  return LOG_ARG_SIZE;
+        case LEN_T:  return LOG_ARG_PTRDIFF;
+        default:     return LOG_ARG_INT;
+    }
+}
+
+/* Next conversion in p, false when there is none left */
+static int next_spec(const char *p, format_spec_t *spec) {
+    p = strchr(p, '%');
+    if (!p) return 0;
+
+    spec->start = p++;
+    spec->star_width = 0;
+    spec->star_precision = 0;
+
+    while (*p && strchr("-+ #0'", *p)) p++;
+
+    if (*p == '*') {
+        spec->star_width = 1;
+        p++;
+    } else {
+        while (is_digit(*p)) p++;
+    }
+
+    int precision = *p == '.';
+    if (precision) {
+        p++;
+        if (*p == '*') {
+            spec->star_precision = 1;
+            p++;
+        } else {
+            while (is_digit(*p)) p++;
+        }
+    }
+
+    int length = LEN_NONE;
+    switch (*p) {
+        case 'h': length = p[1] == 'h' ? LEN_HH : LEN_H; break;
+        case 'l': length = p[1] == 'l' ? LEN_LL : LEN_L; break;
+        case 'j': length = LEN_J; break;
+        case 'z': length = LEN_Z; break;
+        case 't': length = LEN_T; break;
+        case 'L': length = LEN_BIG_L; break;
+    }
+    if (length != LEN_NONE) p += (length == LEN_HH || length == LEN_LL) ? 2 : 1;
+
+    switch (*p) {
+        case '%':
+            spec->type = SPEC_LITERAL;
+            break;
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            spec->type = integer_type(length);
+            break;
+        case 'c':
+            spec->type = LOG_ARG_INT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            spec->type = length == LEN_BIG_L ? LOG_ARG_LDOUBLE : LOG_ARG_DOUBLE;
+            break;
+        case 's':
+            /* With a precision the argument need not be NUL-terminated, pack would read past it */
+            spec->type = length == LEN_L || precision ? SPEC_UNSUPPORTED : LOG_ARG_STRING;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_POINTER;
+            break;
+        default:
+            spec->type = SPEC_UNSUPPORTED;
+            break;
+    }
+
+    spec->end = *p ? p + 1 : p;
+    return 1;
+}
+
+static size_t fixed_size(int type) {
+    switch (type) {
+        case LOG_ARG_LDOUBLE: return sizeof(long double);
+        case LOG_ARG_STRING:  return sizeof(uint32_t) + 1;
+        default:              return sizeof(uint64_t);
+    }
+}
+
+int log_format_parse(const char *format, uint8_t *types, size_t max) {
+    format_spec_t spec;
+    size_t n = 0;
+
+    for (const char *p = format; next_spec(p, &spec); p = spec.end) {
+        if (spec.type == SPEC_LITERAL) continue;
+        if (spec.type == SPEC_UNSUPPORTED) return -1;
+
+        size_t needed = (size_t)(spec.star_width + spec.star_precision) + 1;
+        if (n + needed > max) return -1;
+
+        if (spec.star_width) types[n++] = LOG_ARG_INT;
+        if (spec.star_precision) types[n++] = LOG_ARG_INT;
+        types[n++] = (uint8_t)spec.type;
+    }
+
+    return (int)n;
+}
+
+size_t log_format_pack(const uint8_t *types, size_t n_types, va_list args, uint8_t *out, size_t size) {
+    /* Strings share whatever the fixed-size values leave */
+    size_t reserved = 0;
+    for (size_t i = 0; i < n_types; i++) reserved += fixed_size(types[i]);
+    if (reserved > size) return 0;
+
+    size_t pos = 0;
+    for (size_t i = 0; i < n_types; i++) {
+        uint64_t value;
+        reserved -= fixed_size(types[i]);
+
+        switch (types[i]) {
+            case LOG_ARG_INT:     value = (uint64_t)va_arg(args, int); break;
+            case LOG_ARG_LONG:    value = (uint64_t)va_arg(args, long); break;
+            case LOG_ARG_LLONG:   value = (uint64_t)va_arg(args, long long); break;
+            case LOG_ARG_INTMAX:  value = (uint64_t)va_arg(args, intmax_t); break;
+            case LOG_ARG_SIZE:    value = (uint64_t)va_arg(args, size_t); break;
+            case LOG_ARG_PTRDIFF: value = (uint64_t)va_arg(args, ptrdiff_t); break;
+            case LOG_ARG_POINTER: value = (uint64_t)(uintptr_t)va_arg(args, void *); break;
+            case LOG_ARG_DOUBLE: {
+                double d = va_arg(args, double);
+                memcpy(&value, &d, sizeof(value));
+                break;
+            }
+            case LOG_ARG_LDOUBLE: {
+                long double d = va_arg(args, long double);
+                memcpy(out + pos, &d, sizeof(d));
+                pos += sizeof(d);
+                continue;
+            }
+            case LOG_ARG_STRING: {
+                const char *s = va_arg(args, const char *);
+                uint32_t length = UINT32_MAX;
+                size_t budget = size - pos - reserved - sizeof(uint32_t) - 1;
+
+                if (s) {
+                    size_t n = strlen(s);
+                    length = (uint32_t)(n < budget ? n : budget);
+                }
+                memcpy(out + pos, &length, sizeof(length));
+                pos += sizeof(length);
+                if (s) {
+                    memcpy(out + pos, s, length);
+                    pos += length;
+                }
+                out[pos++] = '\0';
+                continue;
+            }
+            default:
+                return pos;
+        }
+
+        memcpy(out + pos, &value, sizeof(value));
+        pos += sizeof(value);
+    }
+
+    return pos;
+}
+
+static int read_value(const uint8_t **p, const uint8_t *end, void *value, size_t size) {
+    if ((size_t)(end - *p) < size) return 0;
+    memcpy(value, *p, size);
+    *p += size;
+    return 1;
+}
+
+static int read_int(const uint8_t **p, const uint8_t *end, int *value) {
+    uint64_t raw;
+    if (!read_value(p, end, &raw, sizeof(raw))) return 0;
+    *value = (int)raw;
+    return 1;
+}
+
+size_t log_format_render(const char *format, const uint8_t *packed, size_t length, char *out, size_t size) {
+    const uint8_t *p = packed;
+    const uint8_t *end = packed + length;
+    size_t pos = 0;
+    format_spec_t spec;
+
+    if (size == 0) return 0;
+    out[0] = '\0';
+
+#define RENDER(...) do { \
+        int written_ = snprintf(out + pos, size - pos, __VA_ARGS__); \
+        if (written_ > 0) pos += (size_t)written_ < size - pos ? (size_t)written_ : size - pos - 1; \
+    } while (0)
+
+    const char *literal = format;
+    while (pos < size - 1 && next_spec(literal, &spec)) {
+        RENDER("%.*s", (int)(spec.start - literal), literal);
+        literal = spec.end;
+
+        if (spec.type == SPEC_LITERAL) {
+            RENDER("%%");
+            continue;
+        }
+
+        /* Re-create the conversion with '*' replaced by the recorded values */
+        char conversion[64];
+        size_t c = 0;
+        int stars[2];
+        int n_stars = 0;
+        if (spec.star_width && !read_int(&p, end, &stars[n_stars++])) break;
+        if (spec.star_precision && !read_int(&p, end, &stars[n_stars++])) break;
+
+        int star = 0;
+        for (const char *s = spec.start; s < spec.end && c < sizeof(conversion) - 12; s++) {
+            if (*s == '*') {
+                c += (size_t)snprintf(conversion + c, sizeof(conversion) - c, "%d", stars[star++]);
+            } else {
+                conversion[c++] = *s;
+            }
+        }
+        conversion[c] = '\0';
+
+        uint64_t value = 0;
+        if (spec.type != LOG_ARG_LDOUBLE && spec.type != LOG_ARG_STRING &&
+            !read_value(&p, end, &value, sizeof(value))) {
+            break;
+        }
+
+        switch (spec.type) {
+            case LOG_ARG_INT:     RENDER(conversion, (int)value); break;
+            case LOG_ARG_LONG:    RENDER(conversion, (long)value); break;
+            case LOG_ARG_LLONG:   RENDER(conversion, (long long)value); break;
+            case LOG_ARG_INTMAX:  RENDER(conversion, (intmax_t)value); break;
+            case LOG_ARG_SIZE:    RENDER(conversion, (size_t)value); break;
+            case LOG_ARG_PTRDIFF: RENDER(conversion, (ptrdiff_t)value); break;
+            case LOG_ARG_POINTER: RENDER(conversion, (void *)(uintptr_t)value); break;
+            case LOG_ARG_DOUBLE: {
+                double d;
+                memcpy(&d, &value, sizeof(d));
+                RENDER(conversion, d);
+                break;
+            }
+            case LOG_ARG_LDOUBLE: {
+                long double d;
+                if (!read_value(&p, end, &d, sizeof(d))) return pos;
+                RENDER(conversion, d);
+                break;
+            }
+            case LOG_ARG_STRING: {
+                uint32_t n;
+                if (!read_value(&p, end, &n, sizeof(n))) return pos;
+                if (n == UINT32_MAX) {
+                    RENDER(conversion, "(null)");
+                    n = 0;
+                } else if ((size_t)(end - p) < (size_t)n + 1) {
+                    return pos;
+                } else {
+                    RENDER(conversion, (const char *)p);
+                }
+                p += n + 1;
+                break;
+            }
+            default:
+                return pos;
+        }
+    }
+
+    if (pos < size - 1) RENDER("%s", literal);
+
+#undef RENDER
+
+    return pos;
+}
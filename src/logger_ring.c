@@ -0,0 +1,133 @@
+#include <logger_ring.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static size_t record_size(size_t length) {
+    return (sizeof(log_ring_header_t) + length + LOG_RING_ALIGN - 1) & ~(size_t)(LOG_RING_ALIGN - 1);
+}
+
+int log_ring_init(log_ring_t *ring, size_t size) {
+    if (size < 2 * LOG_RING_ALIGN || (size & (size - 1)) != 0) return 0;
+
+    memset(ring, 0, sizeof(*ring));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->sleeping, false);
+
+    /* Zeroed memory reads as "not committed" everywhere */
+    ring->data = calloc(1, size);
+    if (!ring->data) return 0;
+
+    ring->event_fd = eventfd(0, EFD_CLOEXEC);
+    if (ring->event_fd < 0) {
+        free(ring->data);
+        ring->data = NULL;
+        return 0;
+    }
+
+    ring->size = size;
+    return 1;
+}
+
+void log_ring_destroy(log_ring_t *ring) {
+    if (!ring->data) return;
+
+    close(ring->event_fd);
+    free(ring->data);
+    ring->data = NULL;
+}
+
+void *log_ring_reserve(log_ring_t *ring, size_t length) {
+    size_t total = record_size(length);
+    if (total > ring->size / 2) return NULL;
+
+    uint64_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t room, need;
+
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        room = ring->size - (size_t)(pos & (ring->size - 1));
+        need = total <= room ? total : room + total;
+
+        if (pos + need - tail > ring->size) return NULL;
+
+        if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + need,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (need != total) {
+        /* Wrap: the rest of the buffer becomes an empty, already committed record */
+        log_ring_header_t *pad = (log_ring_header_t *)(ring->data + (pos & (ring->size - 1)));
+        pad->kind = LOG_RING_PAD;
+        pad->length = 0;
+        atomic_store_explicit(&pad->size, (uint32_t)room, memory_order_release);
+        pos += room;
+    }
+
+    log_ring_header_t *header = (log_ring_header_t *)(ring->data + (pos & (ring->size - 1)));
+    header->kind = LOG_RING_RECORD;
+    header->length = (uint32_t)length;
+    return log_ring_payload(header);
+}
+
+void log_ring_commit(log_ring_t *ring, void *payload) {
+    log_ring_header_t *header = (log_ring_header_t *)payload - 1;
+
+    atomic_store_explicit(&header->size, (uint32_t)record_size(header->length), memory_order_release);
+
+    /* Pairs with the fence in log_ring_wait: either we see sleeping or it sees the record */
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->sleeping, memory_order_relaxed) &&
+        atomic_exchange(&ring->sleeping, false)) {
+        log_ring_kick(ring);
+    }
+}
+
+const log_ring_header_t *log_ring_peek(log_ring_t *ring) {
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        log_ring_header_t *header = (log_ring_header_t *)(ring->data + (tail & (ring->size - 1)));
+
+        if (atomic_load_explicit(&header->size, memory_order_acquire) == 0) return NULL;
+        if (header->kind != LOG_RING_PAD) return header;
+
+        log_ring_release(ring, header);
+    }
+}
+
+void log_ring_release(log_ring_t *ring, const log_ring_header_t *header) {
+    uint32_t size = atomic_load_explicit(&header->size, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    /* Old payload bytes must not look like a committed header on the next lap */
+    memset((void *)header, 0, size);
+    atomic_store_explicit(&ring->tail, tail + size, memory_order_release);
+}
+
+void log_ring_wait(log_ring_t *ring, int timeout_ms) {
+    atomic_store(&ring->sleeping, true);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!log_ring_peek(ring)) {
+        struct pollfd pfd = { .fd = ring->event_fd, .events = POLLIN };
+        if (poll(&pfd, 1, timeout_ms) > 0) {
+            uint64_t value;
+            while (read(ring->event_fd, &value, sizeof(value)) < 0 && errno == EINTR);
+        }
+    }
+
+    atomic_store(&ring->sleeping, false);
+}
+
+void log_ring_kick(log_ring_t *ring) {
+    uint64_t one = 1;
+    ssize_t result = write(ring->event_fd, &one, sizeof(one));
+    (void)result;
+}
@@ -0,0 +1,629 @@
+#include <logger_sink.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+// Linux UIO_MAXIOV; limits.h объявляет IOV_MAX только с _XOPEN_SOURCE
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static logger_config_t* g_config;
+
+// Файл лога
+static int g_log_fd = -1;
+static uint64_t g_file_size = 0;
+static uint64_t g_file_written = 0;         // Байт с момента открытия
+static uint64_t g_file_opened = 0;          // CLOCK_MONOTONIC, нс
+static uint64_t g_last_sync = 0;
+static int g_unsynced = 0;
+
+// Номера мест в бинарном файле, поколение меняется с каждым файлом
+static uint32_t g_binary_sites = 0;
+static uint32_t g_binary_generation = 0;
+
+// Пакет текстовых строк: общий для консоли и текстового файла
+static struct {
+    char data[LOGGER_BATCH_SIZE];
+    size_t length;
+    size_t n_lines;
+    struct {
+        uint32_t offset;
+        uint32_t length;                    // С '\n'
+        log_level_t level;
+    } lines[LOGGER_BATCH_LINES];
+} g_text;
+
+// Пакет для файла в бинарном или JSON формате
+static struct {
+    char data[LOGGER_BATCH_SIZE];
+    size_t length;
+} g_file;
+
+// Сокет journald (протокол sd-journal, датаграмма на сообщение)
+static int g_journal_fd = -1;
+static struct sockaddr_un g_journal_addr;
+
+static struct iovec g_console_iov[LOGGER_BATCH_LINES * 3];
+static char g_colors[LOG_LEVEL_FATAL + 1][16];
+static const char g_color_reset[] = "\033[0m\n";
+
+// Кэш форматирования времени
+static struct {
+    int64_t offset_ns;          // CLOCK_REALTIME - CLOCK_MONOTONIC
+    int64_t offset_second;      // Секунда, в которую смещение обновлено
+    int64_t second;             // Секунда CLOCK_REALTIME, для которой собран prefix
+    size_t prefix_length;
+    char prefix[24];            // "YYYY-mm-dd HH:MM:SS"
+} g_time_cache = { .offset_second = -1, .second = -1 };
+
+// Получение цвета для уровня
+static log_color_t level_to_color(log_level_t level) {
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return LOG_COLOR_CYAN;
+        case LOG_LEVEL_INFO:  return LOG_COLOR_GREEN;
+        case LOG_LEVEL_WARN:  return LOG_COLOR_YELLOW;
+        case LOG_LEVEL_ERROR: return LOG_COLOR_RED;
+        case LOG_LEVEL_FATAL: return LOG_COLOR_BRIGHT_RED;
+        default: return LOG_COLOR_WHITE;
+    }
+}
+
+// Разница CLOCK_REALTIME - CLOCK_MONOTONIC
+static int64_t realtime_offset_ns(void) {
+    struct timespec real;
+    clock_gettime(CLOCK_REALTIME, &real);
+    uint64_t mono = logger_monotonic_ns();
+    return (int64_t)real.tv_sec * 1000000000ll + real.tv_nsec - (int64_t)mono;
+}
+
+// Перевод в CLOCK_REALTIME, смещение обновляется раз в секунду
+static int64_t to_realtime_ns(uint64_t monotonic) {
+    int64_t realtime = (int64_t)monotonic + g_time_cache.offset_ns;
+    if (realtime / 1000000000ll != g_time_cache.offset_second) {
+        g_time_cache.offset_ns = realtime_offset_ns();
+        realtime = (int64_t)monotonic + g_time_cache.offset_ns;
+        g_time_cache.offset_second = realtime / 1000000000ll;
+    }
+    return realtime;
+}
+
+// Форматирование времени: дата кэшируется на секунду, на сообщение - только микросекунды
+static size_t format_timestamp(char* buffer, size_t size, uint64_t monotonic) {
+    if (g_config->timestamp_format == LOG_TIMESTAMP_RAW) {
+        int written = snprintf(buffer, size, "%llu", (unsigned long long)monotonic);
+        return written < 0 ? 0 : (size_t)written;
+    }
+
+    int64_t realtime = to_realtime_ns(monotonic);
+    int64_t second = realtime / 1000000000ll;
+    if (second != g_time_cache.second) {
+        time_t seconds = (time_t)second;
+        struct tm tm_info;
+        localtime_r(&seconds, &tm_info);
+        g_time_cache.prefix_length = strftime(g_time_cache.prefix, sizeof(g_time_cache.prefix),
+                                              "%Y-%m-%d %H:%M:%S", &tm_info);
+        g_time_cache.second = second;
+    }
+
+    if (size < g_time_cache.prefix_length + 8) return 0;
+    memcpy(buffer, g_time_cache.prefix, g_time_cache.prefix_length);
+
+    char* suffix = buffer + g_time_cache.prefix_length;
+    unsigned int usec = (unsigned int)((realtime % 1000000000ll) / 1000);
+    suffix[0] = '.';
+    for (int i = 6; i >= 1; i--) {
+        suffix[i] = (char)('0' + usec % 10);
+        usec /= 10;
+    }
+    suffix[7] = '\0';
+    return g_time_cache.prefix_length + 7;
+}
+
+// writev с дозаписью после частичной записи
+static size_t writev_all(int fd, struct iovec* iov, int count) {
+    size_t total = 0;
+
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count > IOV_MAX ? IOV_MAX : count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        total += (size_t)written;
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+
+    return total;
+}
+
+static void write_log_file(const void* data, size_t length) {
+    struct iovec iov = { (void*)data, length };
+    size_t written = writev_all(g_log_fd, &iov, 1);
+
+    g_file_size += written;
+    g_file_written += written;
+    g_unsynced = 1;
+}
+
+// Открытие файла лога только на дозапись
+static int open_log_file(void) {
+    g_log_fd = open(g_config->log_file_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (g_log_fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    g_file_size = fstat(g_log_fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    g_file_written = 0;
+    g_file_opened = logger_monotonic_ns();
+    g_last_sync = g_file_opened;
+
+    // Заголовок в начале каждого файла: номера мест начинаются заново
+    if (g_config->file_format == LOG_FILE_BINARY) {
+        log_binary_header_t header = { .version = LOG_BINARY_VERSION, .pointer_size = sizeof(void*) };
+        memcpy(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic));
+        write_log_file(&header, sizeof(header));
+
+        g_binary_generation++;
+        g_binary_sites = 0;
+        g_file_written = 0;
+    }
+
+    return 1;
+}
+
+static void sync_log_file(void) {
+    if (g_unsynced) {
+        fdatasync(g_log_fd);
+        g_unsynced = 0;
+    }
+    g_last_sync = logger_monotonic_ns();
+}
+
+// Ротация: path -> path.1 -> ... -> path.rotate_keep
+static void rotate_log_file(void) {
+    char from[PATH_MAX];
+    char to[PATH_MAX];
+    const char* path = g_config->log_file_path;
+
+    if (g_config->sync_interval_ms > 0) {
+        sync_log_file();
+    }
+    close(g_log_fd);
+    g_log_fd = -1;
+
+    if (g_config->rotate_keep > 0) {
+        for (int i = g_config->rotate_keep - 1; i >= 1; i--) {
+            snprintf(from, sizeof(from), "%s.%d", path, i);
+            snprintf(to, sizeof(to), "%s.%d", path, i + 1);
+            rename(from, to);
+        }
+        snprintf(to, sizeof(to), "%s.1", path);
+        rename(path, to);
+    } else {
+        unlink(path);
+    }
+
+    if (!open_log_file()) {
+        fprintf(stderr, "ERROR: Cannot reopen log file after rotation: %s\n", path);
+        g_config->log_to_file = 0;
+    }
+}
+
+// Байт файла, еще не записанных из пакетов
+static size_t batched_file_bytes(void) {
+    return g_file.length + (g_config->file_format == LOG_FILE_TEXT ? g_text.length : 0);
+}
+
+static void flush_console(void) {
+    int count = 0;
+
+    if (!g_config->use_colors) {
+        g_console_iov[count++] = (struct iovec){ g_text.data, g_text.length };
+    } else {
+        // Цвет и сброс - статические строки, сама строка без '\n'
+        for (size_t i = 0; i < g_text.n_lines; i++) {
+            const char* color = g_colors[g_text.lines[i].level];
+            g_console_iov[count++] = (struct iovec){ (void*)color, strlen(color) };
+            g_console_iov[count++] = (struct iovec){ g_text.data + g_text.lines[i].offset,
+                                                     g_text.lines[i].length - 1 };
+            g_console_iov[count++] = (struct iovec){ (void*)g_color_reset, sizeof(g_color_reset) - 1 };
+        }
+    }
+
+    writev_all(STDOUT_FILENO, g_console_iov, count);
+}
+
+// Только запись пакетов: ротация посреди сообщения разорвала бы SITE и EVENT по разным файлам
+static void flush_batches(void) {
+    if (g_text.n_lines > 0) {
+        if (g_config->log_to_console) {
+            flush_console();
+        }
+        if (g_config->file_format == LOG_FILE_TEXT && g_log_fd >= 0) {
+            write_log_file(g_text.data, g_text.length);
+        }
+        g_text.length = 0;
+        g_text.n_lines = 0;
+    }
+
+    if (g_file.length > 0) {
+        if (g_log_fd >= 0) {
+            write_log_file(g_file.data, g_file.length);
+        }
+        g_file.length = 0;
+    }
+}
+
+// Только запись: ротация и fdatasync - в log_sink_maintain на рабочем потоке
+void log_sink_flush(void) {
+    flush_batches();
+}
+
+// Ротация по размеру (с учетом пакета) и времени, затем fdatasync по расписанию
+void log_sink_maintain(void) {
+    if (g_log_fd < 0) return;
+
+    uint64_t now = logger_monotonic_ns();
+    size_t batched = batched_file_bytes();
+    int rotate_by_size = g_config->rotate_size > 0 && g_file_size + batched >= g_config->rotate_size;
+    int rotate_by_age = g_config->rotate_age > 0 && g_file_written + batched > 0 &&
+                        now - g_file_opened >= (uint64_t)g_config->rotate_age * 1000000000ull;
+    if (rotate_by_size || rotate_by_age) {
+        flush_batches();
+        rotate_log_file();
+        return;
+    }
+
+    if (g_config->sync_interval_ms > 0 && g_unsynced &&
+        now - g_last_sync >= (uint64_t)g_config->sync_interval_ms * 1000000ull) {
+        sync_log_file();
+    }
+}
+
+// Строка "[время] [УРОВЕНЬ] [МОДУЛЬ] текст\n" в пакет
+static void batch_text(const log_message_t* message, const char* text, size_t length) {
+    size_t needed = 96 + length;
+    if (g_text.n_lines == LOGGER_BATCH_LINES || g_text.length + needed > sizeof(g_text.data)) {
+        flush_batches();
+    }
+
+    char* line = g_text.data + g_text.length;
+    char timestamp[32];
+    format_timestamp(timestamp, sizeof(timestamp), message->timestamp);
+
+    int prefix = snprintf(line, needed, "[%s] [%s] [%s] ",
+                          timestamp,
+                          logger_level_name(message->level),
+                          logger_module_name(message->module));
+    size_t line_length = prefix < 0 ? 0 : (size_t)prefix;
+
+    memcpy(line + line_length, text, length);
+    line_length += length;
+    line[line_length++] = '\n';
+
+    g_text.lines[g_text.n_lines].offset = (uint32_t)g_text.length;
+    g_text.lines[g_text.n_lines].length = (uint32_t)line_length;
+    g_text.lines[g_text.n_lines].level = message->level <= LOG_LEVEL_FATAL ? message->level : LOG_LEVEL_FATAL;
+    g_text.n_lines++;
+    g_text.length += line_length;
+}
+
+// Запись из нескольких частей в пакет файла, целиком
+static void batch_file(const void* data[], const size_t lengths[], int count) {
+    size_t needed = 0;
+    for (int i = 0; i < count; i++) needed += lengths[i];
+
+    if (g_file.length + needed > sizeof(g_file.data)) {
+        flush_batches();
+        if (needed > sizeof(g_file.data)) return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        memcpy(g_file.data + g_file.length, data[i], lengths[i]);
+        g_file.length += lengths[i];
+    }
+}
+
+// Запись сообщения в бинарный файл
+static void write_binary(const log_message_t* message, const char* text, size_t length) {
+    log_binary_record_t record = {
+        .level = (uint8_t)message->level,
+        .module = (uint8_t)message->module,
+        .timestamp = to_realtime_ns(message->timestamp),
+        .monotonic = (int64_t)message->timestamp,
+        .line = (uint32_t)message->line,
+    };
+
+    // Отложенное форматирование: описание места пишется один раз на файл
+    if (message->format) {
+        log_site_t* site = message->site;
+        if (site->binary_id == 0 || site->binary_generation != g_binary_generation) {
+            site->binary_id = ++g_binary_sites;
+            site->binary_generation = g_binary_generation;
+
+            log_binary_record_t site_record = record;
+            const void* parts[] = { &site_record, site->file, site->function, site->format };
+            size_t lengths[] = { sizeof(site_record), strlen(site->file) + 1,
+                                 strlen(site->function) + 1, strlen(site->format) + 1 };
+
+            site_record.type = LOG_BINARY_SITE;
+            site_record.id = site->binary_id;
+            site_record.timestamp = 0;
+            site_record.monotonic = 0;
+            site_record.length = (uint32_t)(lengths[1] + lengths[2] + lengths[3]);
+            batch_file(parts, lengths, 4);
+        }
+
+        record.type = LOG_BINARY_EVENT;
+        record.id = site->binary_id;
+        record.length = (uint32_t)message->length;
+        const void* parts[] = { &record, message->message };
+        size_t lengths[] = { sizeof(record), message->length };
+        batch_file(parts, lengths, 2);
+    } else {
+        record.type = LOG_BINARY_TEXT;
+        record.length = (uint32_t)length;
+        const void* parts[] = { &record, text };
+        size_t lengths[] = { sizeof(record), length };
+        batch_file(parts, lengths, 2);
+    }
+}
+
+// Строка JSON со спецсимволами в виде escape-последовательностей
+static size_t json_string(char* out, size_t size, const char* value, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    size_t pos = 0;
+
+    if (size < 3) return 0;
+    out[pos++] = '"';
+    for (size_t i = 0; i < length && pos + 7 < size; i++) {
+        unsigned char c = (unsigned char)value[i];
+        if (c == '"' || c == '\\') {
+            out[pos++] = '\\';
+            out[pos++] = (char)c;
+        } else if (c == '\n') {
+            out[pos++] = '\\';
+            out[pos++] = 'n';
+        } else if (c == '\t') {
+            out[pos++] = '\\';
+            out[pos++] = 't';
+        } else if (c < 0x20) {
+            memcpy(out + pos, "\\u00", 4);
+            out[pos + 4] = hex[c >> 4];
+            out[pos + 5] = hex[c & 0xf];
+            pos += 6;
+        } else {
+            out[pos++] = (char)c;
+        }
+    }
+    out[pos++] = '"';
+    return pos;
+}
+
+// Запись сообщения в файл JSON lines
+static void write_json(const log_message_t* message, const char* text, size_t length) {
+    char line[LOGGER_MAX_MESSAGE * 2 + 1024];
+    char number[64];
+    size_t pos;
+
+    int written = snprintf(line, sizeof(line),
+                           "{\"ts\":%lld,\"ts_mono\":%llu,\"level\":\"%s\",\"module\":\"%s\",\"tid\":%u,\"line\":%d",
+                           (long long)to_realtime_ns(message->timestamp), (unsigned long long)message->timestamp,
+                           logger_level_name(message->level), logger_module_name(message->module),
+                           message->thread_id, message->line);
+    pos = written > 0 ? (size_t)written : 0;
+
+#define JSON_LITERAL(literal) do { \
+        memcpy(line + pos, literal, sizeof(literal) - 1); \
+        pos += sizeof(literal) - 1; \
+    } while (0)
+#define JSON_NUMBER(format, value) do { \
+        int n_ = snprintf(number, sizeof(number), format, value); \
+        memcpy(line + pos, number, (size_t)n_); \
+        pos += (size_t)n_; \
+    } while (0)
+
+    // Имена файла и функции короткие, для msg остается не меньше LOGGER_MAX_MESSAGE * 2
+    JSON_LITERAL(",\"file\":");
+    pos += json_string(line + pos, 256, message->file, strlen(message->file));
+    JSON_LITERAL(",\"func\":");
+    pos += json_string(line + pos, 128, message->function, strlen(message->function));
+
+    if (message->fields.client_pid) JSON_NUMBER(",\"client_pid\":%d", (int)message->fields.client_pid);
+    if (message->fields.surface_id) JSON_NUMBER(",\"surface_id\":%u", message->fields.surface_id);
+    if (message->fields.buffer_id) JSON_NUMBER(",\"buffer_id\":%u", message->fields.buffer_id);
+
+    JSON_LITERAL(",\"msg\":");
+    pos += json_string(line + pos, sizeof(line) - pos - 2, text, length);
+    JSON_LITERAL("}\n");
+
+#undef JSON_NUMBER
+#undef JSON_LITERAL
+
+    const void* parts[] = { line };
+    size_t lengths[] = { pos };
+    batch_file(parts, lengths, 1);
+}
+
+// Поле journald: KEY=value\n, значение с переводом строки - в бинарной форме
+static size_t journal_field(char* out, size_t size, const char* key, const char* value, size_t length) {
+    size_t key_length = strlen(key);
+    if (key_length + length + 10 > size) return 0;
+
+    memcpy(out, key, key_length);
+    size_t pos = key_length;
+
+    if (memchr(value, '\n', length)) {
+        out[pos++] = '\n';
+        uint64_t le_length = length;
+        for (int i = 0; i < 8; i++) {
+            out[pos++] = (char)((le_length >> (8 * i)) & 0xff);
+        }
+    } else {
+        out[pos++] = '=';
+    }
+
+    memcpy(out + pos, value, length);
+    pos += length;
+    out[pos++] = '\n';
+    return pos;
+}
+
+static int journal_priority(log_level_t level) {
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return 7;
+        case LOG_LEVEL_INFO:  return 6;
+        case LOG_LEVEL_WARN:  return 4;
+        case LOG_LEVEL_ERROR: return 3;
+        default:              return 2;
+    }
+}
+
+// Отправка сообщения в journald, при переполнении сокета сообщение теряется
+static void write_journal(const log_message_t* message, const char* text, size_t length) {
+    char entry[LOGGER_MAX_MESSAGE + 1024];
+    char number[32];
+    size_t pos = 0;
+
+#define JOURNAL_FIELD(key, value, value_length) \
+    pos += journal_field(entry + pos, sizeof(entry) - pos, key, value, value_length)
+#define JOURNAL_NUMBER(key, format, value) do { \
+        int n_ = snprintf(number, sizeof(number), format, value); \
+        JOURNAL_FIELD(key, number, (size_t)n_); \
+    } while (0)
+
+    JOURNAL_FIELD("MESSAGE", text, length);
+    JOURNAL_NUMBER("PRIORITY", "%d", journal_priority(message->level));
+    JOURNAL_FIELD("SYSLOG_IDENTIFIER", "desktop_engine", strlen("desktop_engine"));
+    JOURNAL_FIELD("CODE_FILE", message->file, strlen(message->file));
+    JOURNAL_NUMBER("CODE_LINE", "%d", message->line);
+    JOURNAL_FIELD("CODE_FUNC", message->function, strlen(message->function));
+    JOURNAL_NUMBER("TID", "%u", message->thread_id);
+    JOURNAL_FIELD("DE_MODULE", logger_module_name(message->module), strlen(logger_module_name(message->module)));
+    JOURNAL_NUMBER("DE_MONOTONIC_NS", "%llu", (unsigned long long)message->timestamp);
+    if (message->fields.client_pid) JOURNAL_NUMBER("DE_CLIENT_PID", "%d", (int)message->fields.client_pid);
+    if (message->fields.surface_id) JOURNAL_NUMBER("DE_SURFACE_ID", "%u", message->fields.surface_id);
+    if (message->fields.buffer_id) JOURNAL_NUMBER("DE_BUFFER_ID", "%u", message->fields.buffer_id);
+
+#undef JOURNAL_NUMBER
+#undef JOURNAL_FIELD
+
+    sendto(g_journal_fd, entry, pos, MSG_DONTWAIT | MSG_NOSIGNAL,
+           (const struct sockaddr*)&g_journal_addr, sizeof(g_journal_addr));
+}
+
+void log_sink_write(const log_message_t* message) {
+    char rendered[LOGGER_MAX_MESSAGE];
+    const char* text = message->message;
+    size_t length = message->length;
+
+    int file_format = g_log_fd >= 0 ? (int)g_config->file_format : -1;
+    int text_lines = g_config->log_to_console || file_format == LOG_FILE_TEXT;
+
+    // Отложенное форматирование упакованных аргументов: бинарному файлу оно не нужно
+    if (message->format && (text_lines || file_format == LOG_FILE_JSON || g_journal_fd >= 0)) {
+        length = log_format_render(message->format, (const uint8_t*)message->message, message->length,
+                                   rendered, sizeof(rendered));
+        text = rendered;
+    }
+
+    if (text_lines) {
+        batch_text(message, text, length);
+    }
+    if (file_format == LOG_FILE_BINARY) {
+        write_binary(message, text, length);
+    } else if (file_format == LOG_FILE_JSON) {
+        write_json(message, text, length);
+    }
+    if (g_journal_fd >= 0) {
+        write_journal(message, text, length);
+    }
+}
+
+void log_sink_open(logger_config_t* config) {
+    g_config = config;
+    g_time_cache.offset_ns = realtime_offset_ns();
+    g_time_cache.offset_second = -1;
+    g_time_cache.second = -1;
+
+    for (int level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_FATAL; level++) {
+        snprintf(g_colors[level], sizeof(g_colors[level]), "\033[1;%dm", level_to_color((log_level_t)level));
+    }
+
+    // Открытие файла лога
+    if (config->log_to_file && config->log_file_path[0] != '\0') {
+        if (!open_log_file()) {
+            fprintf(stderr, "ERROR: Cannot open log file: %s\n", config->log_file_path);
+            config->log_to_file = 0;
+        }
+    }
+
+    // Сокет journald: адрес заменяемый, например заглушкой в тестовом стенде
+    if (config->log_to_journal) {
+        memset(&g_journal_addr, 0, sizeof(g_journal_addr));
+        g_journal_addr.sun_family = AF_UNIX;
+        memcpy(g_journal_addr.sun_path, config->journal_socket_path, sizeof(g_journal_addr.sun_path) - 1);
+
+        g_journal_fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (g_journal_fd < 0) {
+            fprintf(stderr, "ERROR: Cannot create journal socket: %s\n", strerror(errno));
+            config->log_to_journal = 0;
+        }
+    }
+}
+
+void log_sink_close(void) {
+    log_sink_flush();
+
+    // Закрытие файла
+    if (g_log_fd >= 0) {
+        if (g_config->sync_interval_ms > 0) {
+            sync_log_file();
+        }
+        close(g_log_fd);
+        g_log_fd = -1;
+    }
+
+    if (g_journal_fd >= 0) {
+        close(g_journal_fd);
+        g_journal_fd = -1;
+    }
+}
+
+int log_sink_timeout_ms(void) {
+    if (g_log_fd < 0) return -1;
+
+    uint64_t now = logger_monotonic_ns();
+    uint64_t deadline = UINT64_MAX;
+    size_t batched = batched_file_bytes();
+
+    if (g_config->rotate_size > 0 && g_file_size + batched >= g_config->rotate_size) return 0;
+    if (g_config->rotate_age > 0 && g_file_written + batched > 0) {
+        deadline = g_file_opened + (uint64_t)g_config->rotate_age * 1000000000ull;
+    }
+    if (g_config->sync_interval_ms > 0 && g_unsynced) {
+        uint64_t sync = g_last_sync + (uint64_t)g_config->sync_interval_ms * 1000000ull;
+        if (sync < deadline) deadline = sync;
+    }
+
+    if (deadline == UINT64_MAX) return -1;
+    if (deadline <= now) return 0;
+    // Округление вверх: не просыпаться чуть раньше срока
+    uint64_t timeout_ms = (deadline - now + 999999ull) / 1000000ull;
+    return timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms;
+}
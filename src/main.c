@@ -7,6 +7,12 @@
 
 #include <dbus-server/server.h>
 #include <dbus-server/modules/buffer_module.h>
+#include <dbus-server/modules/frame_module.h>
+#include <dbus-server/modules/dmabuf_module.h>
+#include <dbus-server/modules/logging_module.h>
+#include <dbus-server/modules/metrics_module.h>
+#include <wayland/frame_scheduler.h>
+#include <wayland/frame_timing.h>
 
 #define EXIT_AND_ERROR(msg) \
     do { \
@@ -28,18 +34,57 @@ static void signal_handler(int signal) {
     }
 }
 
-static void init_dbus_modules(struct dbus_server *dbus_server) {
+static void init_dbus_modules(struct dbus_server *dbus_server, struct server *server) {
     if (!dbus_server) return;
     
     LOG_DEBUG(LOG_MODULE_CORE, "Initializing D-Bus modules...");
     
-    DBUS_MODULE *buffer_module = create_buffer_module();
+    DBUS_MODULE *buffer_module = create_buffer_module(server->buffer_tracker, server->buffer_ring);
     if (buffer_module) {
         dbus_server_add_module(dbus_server, buffer_module);
+        /* Latest-wins for per-surface updates backed up behind a slow bus */
+        dbus_outbound_set_merge(dbus_server->outbound, buffer_module_merge_updates, server->buffer_tracker);
+        dbus_outbound_set_sent(dbus_server->outbound, buffer_module_update_sent, server->frame_timing);
+        /* Consumers that die without Unsubscribe */
+        dbus_server_set_name_lost(dbus_server, buffer_module_name_lost, server->buffer_tracker);
         LOG_DEBUG(LOG_MODULE_CORE, "Buffer module added successfully");
     } else {
         LOG_WARN(LOG_MODULE_CORE, "Failed to create buffer module");
     }
+
+    DBUS_MODULE *frame_module = create_frame_module(server->frame_scheduler);
+    if (frame_module) {
+        dbus_server_add_module(dbus_server, frame_module);
+        LOG_DEBUG(LOG_MODULE_CORE, "Frame module added successfully");
+    } else {
+        LOG_WARN(LOG_MODULE_CORE, "Failed to create frame module");
+    }
+
+#ifdef HAVE_LINUX_DMABUF
+    DBUS_MODULE *dmabuf_module = create_dmabuf_module(server->linux_dmabuf);
+    if (dmabuf_module) {
+        dbus_server_add_module(dbus_server, dmabuf_module);
+        LOG_DEBUG(LOG_MODULE_CORE, "Dmabuf module added successfully");
+    } else {
+        LOG_WARN(LOG_MODULE_CORE, "Failed to create dmabuf module");
+    }
+#endif
+
+    DBUS_MODULE *logging_module = create_logging_module();
+    if (logging_module) {
+        dbus_server_add_module(dbus_server, logging_module);
+        LOG_DEBUG(LOG_MODULE_CORE, "Logging module added successfully");
+    } else {
+        LOG_WARN(LOG_MODULE_CORE, "Failed to create logging module");
+    }
+
+    DBUS_MODULE *metrics_module = create_metrics_module(server->frame_timing);
+    if (metrics_module) {
+        dbus_server_add_module(dbus_server, metrics_module);
+        LOG_DEBUG(LOG_MODULE_CORE, "Metrics module added successfully");
+    } else {
+        LOG_WARN(LOG_MODULE_CORE, "Failed to create metrics module");
+    }
     
     LOG_INFO(LOG_MODULE_CORE, "D-Bus modules initialized");
 }
@@ -62,6 +107,8 @@ int main(int argc, char **argv) {
     }
 
     server_init(&server);
+    frame_scheduler_set_refresh_rate(server.frame_scheduler, server_config.refresh_rate);
+    frame_timing_set_dump_interval(server.frame_timing, server_config.metrics_interval);
 
     /* Signal handling for graceful shutdown */
     global_server = &server;
@@ -85,10 +132,13 @@ int main(int argc, char **argv) {
         EXIT_AND_ERROR("Failed to create dbus server");
     }
 
-    init_dbus_modules(dbus_server);
+    init_dbus_modules(dbus_server, &server);
     server_set_dbus(&server, dbus_server);
 
-    if (dbus_start_main_loop(dbus_server) != 0) {
+    int dbus_result = server_config.dbus_inline
+        ? dbus_server_attach_event_loop(dbus_server, wl_display_get_event_loop(server.display))
+        : dbus_start_main_loop(dbus_server);
+    if (dbus_result != 0) {
         if (dbus_server->bus_name) {
             release_bus_name(dbus_server->connection, dbus_server->bus_name);
             free(dbus_server->bus_name);
@@ -99,7 +149,7 @@ int main(int argc, char **argv) {
             dbus_server->connection = NULL;
         }
         free(dbus_server);
-        EXIT_AND_ERROR("Failed to run dbus main loop in different thread");
+        EXIT_AND_ERROR("Failed to run dbus main loop");
     }
 
     /* Test bed (test client) */
@@ -116,6 +166,8 @@ int main(int argc, char **argv) {
 
     LOG_INFO(LOG_MODULE_CORE, "DesktopEngine server shutdown");
 
+    /* Buffer destructors run in server_cleanup, keep them off the freed connection */
+    server_set_dbus(&server, NULL);
     dbus_server_cleanup(dbus_server);
     server_cleanup(&server);
     logger_cleanup();
@@ -1,7 +1,20 @@
 #include <wayland/buffer.h>
+#include <wayland/buffer_ring.h>
+#include <wayland/server.h>
+#include <dbus-server/server.h>
+#include <dbus-server/modules/buffer_module.h>
 #include <logger.h>
 #include <stdlib.h>
 
+/* Wayland thread only */
+static uint32_t next_buffer_id = 1;
+
+static uint32_t buffer_next_id(void) {
+    uint32_t id = next_buffer_id++;
+    if (next_buffer_id == 0) next_buffer_id = 1;
+    return id;
+}
+
 enum pixel_format wl_shm_format_to_pixel_format(uint32_t wl_format) {
     switch (wl_format) {
         case WL_SHM_FORMAT_ARGB8888: return PIXEL_FORMAT_ARGB8888;
@@ -19,43 +32,76 @@ enum pixel_format drm_format_to_pixel_format(uint32_t drm_format) {
 }
 
 struct buffer *buffer_create_shm(struct wl_resource *resource, 
-                                 uint32_t id, int32_t offset, int32_t width, 
-                                 int32_t height, int32_t stride, uint32_t format,
-                                 int fd) {  // Добавляем fd параметр
+                                 struct shm_pool *pool, int32_t offset, int32_t width, 
+                                 int32_t height, int32_t stride, uint32_t format) {
     struct buffer *buf = calloc(1, sizeof(struct buffer));
     if (!buf) {
         SERVER_ERROR("Failed to allocate buffer");
         return NULL;
     }
     
+    buf->id = buffer_next_id();
     buf->type = WL_BUFFER_SHM;
+    wl_list_init(&buf->busy_link);
     buf->width = width;
     buf->height = height;
     buf->resource = resource;
+    buf->shm.pool = shm_pool_ref(pool);
+    buf->shm.offset = offset;
     buf->shm.stride = stride;
-    buf->shm.fd = fd;
+    buf->shm.format = format;
+    buf->shm.fd = pool->fd;
     
     buf->size = buf->shm.stride * buf->height;
     buf->format = wl_shm_format_to_pixel_format(format);
     
-    SERVER_DEBUG("SHM buffer created: %dx%d, stride=%d, fd=%d, data=%p, size=%zu", 
-                width, height, stride, fd, buf->shm.data, buf->size);
+    SERVER_DEBUG("SHM buffer created: %dx%d, stride=%d, format=0x%x, fd=%d, offset=%zu, data=%p, size=%zu", 
+                width, height, stride, format, pool->fd, buf->shm.offset, shm_buffer_get_data(buf), buf->size);
     
     return buf;
 }
 
-struct buffer *buffer_create_dmabuf(int fd, uint32_t width, uint32_t height, uint32_t drm_format, uint64_t modifier, uint32_t stride) {
+void *shm_buffer_get_data(const struct buffer *buffer) {
+    if (!buffer || buffer->type != WL_BUFFER_SHM || !buffer->shm.pool || !buffer->shm.pool->data) {
+        return NULL;
+    }
+    return (uint8_t *)buffer->shm.pool->data + buffer->shm.offset;
+}
+
+struct buffer *buffer_create_dmabuf(struct wl_resource *resource, const struct dmabuf_attributes *attribs) {
     struct buffer *buf = calloc(1, sizeof(struct buffer));
-    if (!buf) return NULL;
+    if (!buf) {
+        SERVER_ERROR("Failed to allocate buffer");
+        return NULL;
+    }
     
+    buf->id = buffer_next_id();
     buf->type = WL_BUFFER_DMA_BUF;
-    buf->width = width;
-    buf->height = height;
-    buf->dmabuf.fd = fd;
-    buf->dmabuf.modifier = modifier;
-    buf->dmabuf.stride = stride;
-    buf->size = stride * height;
-    buf->format = drm_format_to_pixel_format(drm_format);
+    wl_list_init(&buf->link);
+    wl_list_init(&buf->busy_link);
+    buf->width = attribs->width;
+    buf->height = attribs->height;
+    buf->resource = resource;
+    buf->dmabuf = *attribs;
+    buf->size = (size_t)attribs->stride[0] * attribs->height;
+    buf->format = drm_format_to_pixel_format(attribs->format);
+    
+    SERVER_DEBUG("DMA-BUF buffer created: %dx%d, format=0x%08x, modifier=0x%016llx, planes=%u, fd=%d, stride=%u",
+                attribs->width, attribs->height, attribs->format, (unsigned long long)attribs->modifier,
+                attribs->num_planes, attribs->fd[0], attribs->stride[0]);
     
     return buf;
-}
\ No newline at end of file
+}
+
+void buffer_publish_destroyed(struct server *server, struct buffer *buffer) {
+    if (!server || !buffer) return;
+
+    /* Ring consumers learn it in order with the updates, D-Bus covers a full ring */
+    bool ring_done = buffer_ring_publish_destroyed(server->buffer_ring, buffer);
+    if (ring_done && buffer->dbus_epoch == 0) return;
+
+    if (!server->dbus_server) return;
+    if (!buffer_module_send_destroyed_signal(server->dbus_server, buffer->id)) {
+        SERVER_WARN("BUFFER: destroy of buffer %u not delivered, consumers keep a stale mapping", buffer->id);
+    }
+}
@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+#include <wayland/buffer_ring.h>
+#include <wayland/buffer.h>
+#include <logger.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct buffer_ring_channel {
+    char *consumer;                 /* D-Bus unique name */
+    uint32_t generation;
+    uint32_t last_serial;           /* Serial of the last pushed update */
+    struct buffer_ring_header *header;
+    size_t map_size;
+    int socket_fd;                  /* Server end of the socketpair */
+    int event_fd;
+    uint64_t overflows;
+};
+
+static void channel_destroy(struct buffer_ring_channel *channel) {
+    if (!channel) return;
+
+    if (channel->header) munmap(channel->header, channel->map_size);
+    if (channel->socket_fd >= 0) close(channel->socket_fd);
+    if (channel->event_fd >= 0) close(channel->event_fd);
+    free(channel->consumer);
+    free(channel);
+}
+
+static struct buffer_ring_record *channel_slot(struct buffer_ring_channel *channel, uint32_t index) {
+    uint32_t slot = index & (BUFFER_RING_CAPACITY - 1);
+    return (struct buffer_ring_record *)(channel->header->records + (size_t)slot * sizeof(struct buffer_ring_record));
+}
+
+/* Slot of the consumer's channel, -1 when it has none (mutex held) */
+static int ring_find_consumer(struct buffer_ring *ring, const char *consumer) {
+    for (int i = 0; i < BUFFER_RING_MAX_CHANNELS; i++) {
+        if (ring->channels[i] && strcmp(ring->channels[i]->consumer, consumer) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+struct buffer_ring *buffer_ring_create(void) {
+    struct buffer_ring *ring = calloc(1, sizeof(struct buffer_ring));
+    if (!ring) {
+        SERVER_ERROR("Failed to allocate buffer ring");
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&ring->mutex, NULL) != 0) {
+        SERVER_ERROR("Failed to initialize buffer ring mutex");
+        free(ring);
+        return NULL;
+    }
+
+    ring->next_generation = 1;
+    return ring;
+}
+
+void buffer_ring_destroy(struct buffer_ring *ring) {
+    if (!ring) return;
+
+    for (int i = 0; i < BUFFER_RING_MAX_CHANNELS; i++) {
+        channel_destroy(ring->channels[i]);
+    }
+    pthread_mutex_destroy(&ring->mutex);
+    free(ring);
+}
+
+uint32_t buffer_ring_open(struct buffer_ring *ring, const char *consumer, struct buffer_ring_fds *fds) {
+    if (!ring || !consumer || !fds) return 0;
+
+    struct buffer_ring_channel *channel = calloc(1, sizeof(struct buffer_ring_channel));
+    if (!channel) return 0;
+
+    int sockets[2] = { -1, -1 };
+    fds->memfd = -1;
+    fds->socket_fd = -1;
+    fds->event_fd = -1;
+    channel->socket_fd = -1;
+    channel->event_fd = -1;
+
+    channel->consumer = strdup(consumer);
+    if (!channel->consumer) goto err;
+
+    channel->map_size = sizeof(struct buffer_ring_header) +
+                        (size_t)BUFFER_RING_CAPACITY * sizeof(struct buffer_ring_record);
+
+    fds->memfd = memfd_create("desktop-engine-buffer-ring", MFD_CLOEXEC);
+    if (fds->memfd < 0 || ftruncate(fds->memfd, channel->map_size) < 0) {
+        SERVER_ERROR("BUFFER RING: failed to create memfd: %s", strerror(errno));
+        goto err;
+    }
+
+    void *map = mmap(NULL, channel->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds->memfd, 0);
+    if (map == MAP_FAILED) {
+        SERVER_ERROR("BUFFER RING: mmap failed: %s", strerror(errno));
+        goto err;
+    }
+    channel->header = map;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) < 0) {
+        SERVER_ERROR("BUFFER RING: socketpair failed: %s", strerror(errno));
+        goto err;
+    }
+    channel->socket_fd = sockets[0];
+    fds->socket_fd = sockets[1];
+
+    channel->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (channel->event_fd < 0) {
+        SERVER_ERROR("BUFFER RING: eventfd failed: %s", strerror(errno));
+        goto err;
+    }
+    fds->event_fd = dup(channel->event_fd);
+    if (fds->event_fd < 0) {
+        SERVER_ERROR("BUFFER RING: dup failed: %s", strerror(errno));
+        goto err;
+    }
+
+    struct buffer_ring_header *header = channel->header;
+    header->magic = BUFFER_RING_MAGIC;
+    header->version = BUFFER_RING_VERSION;
+    header->capacity = BUFFER_RING_CAPACITY;
+    header->record_size = sizeof(struct buffer_ring_record);
+    atomic_init(&header->head, 0);
+    atomic_init(&header->tail, 0);
+
+    /* Reopening replaces the consumer's channel, others keep theirs */
+    pthread_mutex_lock(&ring->mutex);
+    int slot = ring_find_consumer(ring, consumer);
+    for (int i = 0; slot < 0 && i < BUFFER_RING_MAX_CHANNELS; i++) {
+        if (!ring->channels[i]) slot = i;
+    }
+    if (slot < 0) {
+        pthread_mutex_unlock(&ring->mutex);
+        SERVER_WARN("BUFFER RING: too many channels, %s stays on D-Bus", consumer);
+        goto err;
+    }
+
+    channel->generation = ring->next_generation++;
+    if (ring->next_generation == 0) ring->next_generation = 1;
+    channel_destroy(ring->channels[slot]);
+    ring->channels[slot] = channel;
+    pthread_mutex_unlock(&ring->mutex);
+
+    SERVER_INFO("BUFFER RING: channel %u opened for %s (%d records)", channel->generation, consumer,
+                BUFFER_RING_CAPACITY);
+    return channel->generation;
+
+err:
+    if (fds->memfd >= 0) close(fds->memfd);
+    if (fds->socket_fd >= 0) close(fds->socket_fd);
+    if (fds->event_fd >= 0) close(fds->event_fd);
+    fds->memfd = fds->socket_fd = fds->event_fd = -1;
+    channel_destroy(channel);
+    return 0;
+}
+
+void buffer_ring_cancel(struct buffer_ring *ring, uint32_t generation) {
+    if (!ring || generation == 0) return;
+
+    pthread_mutex_lock(&ring->mutex);
+    for (int i = 0; i < BUFFER_RING_MAX_CHANNELS; i++) {
+        if (ring->channels[i] && ring->channels[i]->generation == generation) {
+            channel_destroy(ring->channels[i]);
+            ring->channels[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+void buffer_ring_close(struct buffer_ring *ring, const char *consumer) {
+    if (!ring || !consumer) return;
+
+    pthread_mutex_lock(&ring->mutex);
+    int slot = ring_find_consumer(ring, consumer);
+    if (slot >= 0) {
+        SERVER_INFO("BUFFER RING: channel %u of %s closed", ring->channels[slot]->generation, consumer);
+        channel_destroy(ring->channels[slot]);
+        ring->channels[slot] = NULL;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+static uint32_t buffer_collect_fds(struct buffer *buffer, int *fds) {
+    switch (buffer->type) {
+        case WL_BUFFER_SHM:
+            fds[0] = buffer->shm.fd;
+            return 1;
+        case WL_BUFFER_DMA_BUF:
+            for (uint32_t i = 0; i < buffer->dmabuf.num_planes && i < BUFFER_RING_MAX_FDS; i++) {
+                fds[i] = buffer->dmabuf.fd[i];
+            }
+            return buffer->dmabuf.num_planes < BUFFER_RING_MAX_FDS ? buffer->dmabuf.num_planes : BUFFER_RING_MAX_FDS;
+        default:
+            return 0;
+    }
+}
+
+/* Announce the buffer fds on the socket, 0 on success or an errno */
+static int channel_send_fds(struct buffer_ring_channel *channel, struct buffer *buffer) {
+    int fds[BUFFER_RING_MAX_FDS];
+    uint32_t n_fds = buffer_collect_fds(buffer, fds);
+    if (n_fds == 0) return EINVAL;
+
+    struct buffer_ring_fd_msg msg = {
+        .buffer_id = buffer->id,
+        .n_fds = n_fds,
+    };
+    struct iovec iov = {
+        .iov_base = &msg,
+        .iov_len = sizeof(msg),
+    };
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * BUFFER_RING_MAX_FDS)];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr header = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = CMSG_SPACE(sizeof(int) * n_fds),
+    };
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * n_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * n_fds);
+
+    if (sendmsg(channel->socket_fd, &header, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        return errno;
+    }
+    return 0;
+}
+
+/* Only the consumer frees slots, so a free one stays free until channel_push */
+static bool channel_has_space(struct buffer_ring_channel *channel) {
+    struct buffer_ring_header *header = channel->header;
+    uint32_t head = atomic_load_explicit(&header->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&header->tail, memory_order_acquire);
+
+    if (head - tail < BUFFER_RING_CAPACITY) return true;
+
+    if (channel->overflows++ % 1000 == 0) {
+        SERVER_WARN("BUFFER RING: consumer is behind, %llu record(s) went over D-Bus",
+                    (unsigned long long)channel->overflows);
+    }
+    return false;
+}
+
+static void channel_push(struct buffer_ring_channel *channel, const struct buffer_ring_record *record) {
+    struct buffer_ring_header *header = channel->header;
+    uint32_t head = atomic_load_explicit(&header->head, memory_order_relaxed);
+
+    *channel_slot(channel, head) = *record;
+    atomic_store_explicit(&header->head, head + 1, memory_order_release);
+
+    uint64_t one = 1;
+    if (write(channel->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        SERVER_ERROR("BUFFER RING: failed to kick consumer: %s", strerror(errno));
+    }
+}
+
+/* The fds must be on the socket before the consumer can see the id, false skips this channel */
+static bool channel_announce(struct buffer_ring *ring, int slot, struct buffer *buffer) {
+    struct buffer_ring_channel *channel = ring->channels[slot];
+    if (buffer->ring_generation[slot] == channel->generation) return true;
+
+    int err = channel_send_fds(channel, buffer);
+    if (err == EPIPE || err == ECONNRESET) {
+        SERVER_INFO("BUFFER RING: consumer %s of channel %u went away", channel->consumer, channel->generation);
+        channel_destroy(channel);
+        ring->channels[slot] = NULL;
+        return false;
+    }
+    if (err != 0) {
+        SERVER_WARN("BUFFER RING: failed to pass fds of buffer %u to %s: %s", buffer->id, channel->consumer,
+                    strerror(err));
+        return false;
+    }
+
+    buffer->ring_generation[slot] = channel->generation;
+    return true;
+}
+
+bool buffer_ring_publish(struct buffer_ring *ring, struct buffer *buffer,
+                         const struct buffer_ring_record *record) {
+    if (!ring || !buffer || !record) return false;
+
+    bool published = false;
+    pthread_mutex_lock(&ring->mutex);
+    for (int i = 0; i < BUFFER_RING_MAX_CHANNELS; i++) {
+        struct buffer_ring_channel *channel = ring->channels[i];
+        if (!channel || !channel_has_space(channel) || !channel_announce(ring, i, buffer)) continue;
+
+        channel_push(channel, record);
+        channel->last_serial = record->serial;
+        published = true;
+    }
+    pthread_mutex_unlock(&ring->mutex);
+
+    return published;
+}
+
+bool buffer_ring_delivered(struct buffer_ring *ring, const char *consumer, uint32_t serial) {
+    if (!ring || !consumer) return false;
+
+    pthread_mutex_lock(&ring->mutex);
+    int slot = ring_find_consumer(ring, consumer);
+    bool delivered = slot >= 0 && ring->channels[slot]->last_serial == serial;
+    pthread_mutex_unlock(&ring->mutex);
+
+    return delivered;
+}
+
+bool buffer_ring_publish_destroyed(struct buffer_ring *ring, struct buffer *buffer) {
+    if (!ring || !buffer) return true;
+
+    struct buffer_ring_record record = {
+        .kind = BUFFER_RING_RECORD_DESTROYED,
+        .buffer_id = buffer->id,
+    };
+
+    /* Consumers of other channels never got the fds */
+    bool done = true;
+    pthread_mutex_lock(&ring->mutex);
+    for (int i = 0; i < BUFFER_RING_MAX_CHANNELS; i++) {
+        struct buffer_ring_channel *channel = ring->channels[i];
+        if (!channel || buffer->ring_generation[i] != channel->generation) continue;
+
+        if (channel_has_space(channel)) {
+            channel_push(channel, &record);
+        } else {
+            done = false;
+        }
+    }
+    pthread_mutex_unlock(&ring->mutex);
+
+    return done;
+}
@@ -0,0 +1,345 @@
+#include <wayland/buffer_tracker.h>
+#include <wayland/buffer.h>
+#include <wayland/buffer_ring.h>
+#include <wayland/server.h>
+#include <logger.h>
+
+#include <sys/eventfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+static uint64_t monotonic_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void buffer_tracker_release(struct buffer *buffer) {
+    wl_list_remove(&buffer->busy_link);
+    wl_list_init(&buffer->busy_link);
+    buffer->busy = false;
+    buffer->pending_consumers = 0;
+
+    if (buffer->resource) {
+        wl_buffer_send_release(buffer->resource);
+    }
+}
+
+/* Arm the timeout for the oldest busy buffer, or disarm when idle */
+static void buffer_tracker_update_timeout(struct buffer_tracker *tracker) {
+    if (wl_list_empty(&tracker->busy)) {
+        wl_event_source_timer_update(tracker->timeout_source, 0);
+        return;
+    }
+
+    /* busy is ordered by deadline, oldest at the tail */
+    struct buffer *oldest = wl_container_of(tracker->busy.prev, oldest, busy_link);
+    uint64_t now = monotonic_now_ms();
+    int delay = oldest->busy_deadline_ms > now ? (int)(oldest->busy_deadline_ms - now) : 1;
+
+    wl_event_source_timer_update(tracker->timeout_source, delay);
+}
+
+static int consumer_find(struct buffer_tracker *tracker, const char *name) {
+    for (int i = 0; i < BUFFER_TRACKER_MAX_CONSUMERS; i++) {
+        if ((tracker->consumer_mask & (1u << i)) && strcmp(tracker->consumers[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Stop waiting for a consumer on every busy buffer */
+static void consumer_clear_pending(struct buffer_tracker *tracker, uint32_t slot_bit) {
+    struct buffer *buffer, *tmp;
+    wl_list_for_each_safe(buffer, tmp, &tracker->busy, busy_link) {
+        buffer->pending_consumers &= ~slot_bit;
+        if (buffer->pending_consumers == 0) {
+            buffer_tracker_release(buffer);
+        }
+    }
+}
+
+static void consumer_remove(struct buffer_tracker *tracker, int slot) {
+    uint32_t slot_bit = 1u << slot;
+
+    SERVER_INFO("BUFFER: consumer %s removed", tracker->consumers[slot]);
+
+    tracker->consumer_mask &= ~slot_bit;
+    tracker->late_mask &= ~slot_bit;
+    tracker->consumers[slot][0] = '\0';
+    consumer_clear_pending(tracker, slot_bit);
+}
+
+static void handle_subscribe(struct buffer_tracker *tracker, const char *sender) {
+    if (consumer_find(tracker, sender) >= 0) return;
+
+    for (int i = 0; i < BUFFER_TRACKER_MAX_CONSUMERS; i++) {
+        if (!(tracker->consumer_mask & (1u << i))) {
+            strncpy(tracker->consumers[i], sender, BUFFER_TRACKER_NAME_MAX - 1);
+            tracker->consumers[i][BUFFER_TRACKER_NAME_MAX - 1] = '\0';
+            tracker->consumer_mask |= 1u << i;
+            if (++tracker->consumer_epoch == 0) tracker->consumer_epoch = 1;
+            SERVER_INFO("BUFFER: consumer %s subscribed", sender);
+            return;
+        }
+    }
+
+    SERVER_WARN("BUFFER: too many consumers, %s not subscribed", sender);
+}
+
+static void handle_ack(struct buffer_tracker *tracker, const char *sender, uint32_t serial) {
+    int slot = consumer_find(tracker, sender);
+    if (slot < 0) return;
+
+    if (tracker->late_mask & (1u << slot)) {
+        tracker->late_mask &= ~(1u << slot);
+        SERVER_INFO("BUFFER: consumer %s releases buffers again", sender);
+    }
+
+    struct buffer *buffer;
+    wl_list_for_each(buffer, &tracker->busy, busy_link) {
+        if (buffer->busy_serial != serial) continue;
+
+        buffer->pending_consumers &= ~(1u << slot);
+        if (buffer->pending_consumers == 0) {
+            buffer_tracker_release(buffer);
+        }
+        return;
+    }
+}
+
+/* The D-Bus copy of serial is gone, consumers that got it over their ring still read it */
+static void handle_drop(struct buffer_tracker *tracker, uint32_t serial) {
+    struct buffer *buffer;
+    wl_list_for_each(buffer, &tracker->busy, busy_link) {
+        if (buffer->busy_serial == serial) {
+            buffer->pending_consumers &= buffer->ring_consumers;
+            if (buffer->pending_consumers == 0) {
+                buffer_tracker_release(buffer);
+            }
+            return;
+        }
+    }
+}
+
+static int handle_events(int fd, uint32_t mask, void *data) {
+    struct buffer_tracker *tracker = data;
+
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+
+    /* Copy out under the lock, process without it */
+    struct buffer_tracker_event events[BUFFER_TRACKER_QUEUE_SIZE];
+    uint32_t count;
+
+    pthread_mutex_lock(&tracker->queue_mutex);
+    count = tracker->queue_count;
+    for (uint32_t i = 0; i < count; i++) {
+        events[i] = tracker->queue[(tracker->queue_head + i) % BUFFER_TRACKER_QUEUE_SIZE];
+    }
+    tracker->queue_head = (tracker->queue_head + count) % BUFFER_TRACKER_QUEUE_SIZE;
+    tracker->queue_count = 0;
+    pthread_mutex_unlock(&tracker->queue_mutex);
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct buffer_tracker_event *event = &events[i];
+
+        switch (event->type) {
+            case BUFFER_TRACKER_SUBSCRIBE:
+                handle_subscribe(tracker, event->sender);
+                break;
+            case BUFFER_TRACKER_GONE:
+                buffer_ring_close(tracker->server->buffer_ring, event->sender);
+                /* fall through */
+            case BUFFER_TRACKER_UNSUBSCRIBE: {
+                int slot = consumer_find(tracker, event->sender);
+                if (slot >= 0) consumer_remove(tracker, slot);
+                break;
+            }
+            case BUFFER_TRACKER_ACK:
+                handle_ack(tracker, event->sender, event->serial);
+                break;
+            case BUFFER_TRACKER_DROPPED:
+                handle_drop(tracker, event->serial);
+                break;
+        }
+    }
+
+    buffer_tracker_update_timeout(tracker);
+    return 0;
+}
+
+/*
+ * Overdue buffers go back to the client without the missing acks. A stall
+ * or a lost ack says nothing about the consumer being gone, so it keeps
+ * its subscription and gets the next frames as usual.
+ */
+static int handle_timeout(void *data) {
+    struct buffer_tracker *tracker = data;
+    uint64_t now = monotonic_now_ms();
+
+    struct buffer *buffer, *tmp;
+    wl_list_for_each_reverse_safe(buffer, tmp, &tracker->busy, busy_link) {
+        if (buffer->busy_deadline_ms > now) break;
+
+        /* Warn once per stall, not for every frame it covers */
+        uint32_t late = buffer->pending_consumers & tracker->consumer_mask & ~tracker->late_mask;
+        for (int i = 0; i < BUFFER_TRACKER_MAX_CONSUMERS; i++) {
+            if (late & (1u << i)) {
+                SERVER_WARN("BUFFER: consumer %s did not release buffer %u in %d ms, releasing it",
+                            tracker->consumers[i], buffer->busy_serial, BUFFER_TRACKER_RELEASE_TIMEOUT_MS);
+            }
+        }
+        tracker->late_mask |= late;
+
+        buffer_tracker_release(buffer);
+    }
+
+    buffer_tracker_update_timeout(tracker);
+    return 0;
+}
+
+struct buffer_tracker *buffer_tracker_create(struct server *server) {
+    struct buffer_tracker *tracker = calloc(1, sizeof(struct buffer_tracker));
+    if (!tracker) {
+        SERVER_ERROR("Failed to allocate buffer tracker");
+        return NULL;
+    }
+
+    tracker->server = server;
+    tracker->next_serial = 1;
+    tracker->consumer_epoch = 1;
+    wl_list_init(&tracker->busy);
+
+    if (pthread_mutex_init(&tracker->queue_mutex, NULL) != 0) {
+        SERVER_ERROR("Failed to initialize buffer tracker mutex");
+        free(tracker);
+        return NULL;
+    }
+
+    tracker->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (tracker->event_fd < 0) {
+        SERVER_ERROR("Failed to create buffer tracker eventfd: %s", strerror(errno));
+        buffer_tracker_destroy(tracker);
+        return NULL;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    tracker->event_source = wl_event_loop_add_fd(loop, tracker->event_fd, WL_EVENT_READABLE, handle_events, tracker);
+    tracker->timeout_source = wl_event_loop_add_timer(loop, handle_timeout, tracker);
+    if (!tracker->event_source || !tracker->timeout_source) {
+        SERVER_ERROR("Failed to add buffer tracker to event loop");
+        buffer_tracker_destroy(tracker);
+        return NULL;
+    }
+
+    return tracker;
+}
+
+void buffer_tracker_destroy(struct buffer_tracker *tracker) {
+    if (!tracker) return;
+
+    struct buffer *buffer, *tmp;
+    wl_list_for_each_safe(buffer, tmp, &tracker->busy, busy_link) {
+        wl_list_remove(&buffer->busy_link);
+        wl_list_init(&buffer->busy_link);
+        buffer->busy = false;
+    }
+
+    if (tracker->event_source) wl_event_source_remove(tracker->event_source);
+    if (tracker->timeout_source) wl_event_source_remove(tracker->timeout_source);
+    if (tracker->event_fd >= 0) close(tracker->event_fd);
+
+    pthread_mutex_destroy(&tracker->queue_mutex);
+    free(tracker);
+}
+
+uint32_t buffer_tracker_mark_busy(struct buffer_tracker *tracker, struct buffer *buffer) {
+    if (!tracker || !buffer) return 0;
+
+    uint32_t serial = tracker->next_serial++;
+    if (tracker->next_serial == 0) tracker->next_serial = 1;
+
+    /* Re-committed while still busy: restart with the new content */
+    wl_list_remove(&buffer->busy_link);
+    wl_list_init(&buffer->busy_link);
+
+    buffer->busy_serial = serial;
+    buffer->pending_consumers = tracker->consumer_mask;
+    buffer->ring_consumers = 0;
+
+    if (buffer->pending_consumers == 0) {
+        /* Nobody reads the buffer, client may reuse it right away */
+        buffer->busy = true;
+        buffer_tracker_release(buffer);
+        return serial;
+    }
+
+    buffer->busy = true;
+    buffer->busy_deadline_ms = monotonic_now_ms() + BUFFER_TRACKER_RELEASE_TIMEOUT_MS;
+    wl_list_insert(&tracker->busy, &buffer->busy_link);
+
+    buffer_tracker_update_timeout(tracker);
+    return serial;
+}
+
+void buffer_tracker_drop(struct buffer_tracker *tracker, uint32_t serial) {
+    if (!tracker) return;
+
+    handle_drop(tracker, serial);
+    buffer_tracker_update_timeout(tracker);
+}
+
+bool buffer_tracker_needs_signal(struct buffer_tracker *tracker, struct buffer *buffer) {
+    if (!tracker || !buffer) return false;
+
+    buffer->ring_consumers = 0;
+    for (int i = 0; i < BUFFER_TRACKER_MAX_CONSUMERS; i++) {
+        if ((tracker->consumer_mask & (1u << i)) &&
+            buffer_ring_delivered(tracker->server->buffer_ring, tracker->consumers[i], buffer->busy_serial)) {
+            buffer->ring_consumers |= 1u << i;
+        }
+    }
+    return (tracker->consumer_mask & ~buffer->ring_consumers) != 0;
+}
+
+void buffer_tracker_forget(struct buffer *buffer) {
+    if (!buffer) return;
+
+    wl_list_remove(&buffer->busy_link);
+    wl_list_init(&buffer->busy_link);
+    buffer->busy = false;
+}
+
+void buffer_tracker_push_event(struct buffer_tracker *tracker, enum buffer_tracker_event_type type,
+                               const char *sender, uint32_t serial) {
+    if (!tracker || !sender) return;
+
+    pthread_mutex_lock(&tracker->queue_mutex);
+    if (tracker->queue_count == BUFFER_TRACKER_QUEUE_SIZE) {
+        pthread_mutex_unlock(&tracker->queue_mutex);
+        /* A lost ack holds the buffer until its release deadline */
+        SERVER_WARN("BUFFER: consumer event queue full, dropping event from %s", sender);
+        return;
+    }
+
+    struct buffer_tracker_event *event =
+        &tracker->queue[(tracker->queue_head + tracker->queue_count) % BUFFER_TRACKER_QUEUE_SIZE];
+    event->type = type;
+    event->serial = serial;
+    strncpy(event->sender, sender, BUFFER_TRACKER_NAME_MAX - 1);
+    event->sender[BUFFER_TRACKER_NAME_MAX - 1] = '\0';
+    tracker->queue_count++;
+    pthread_mutex_unlock(&tracker->queue_mutex);
+
+    uint64_t one = 1;
+    if (write(tracker->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        SERVER_ERROR("BUFFER: failed to wake Wayland loop: %s", strerror(errno));
+    }
+}
@@ -1,6 +1,7 @@
 #include <wayland/compositor.h>
 #include <logger.h>
 #include <wayland/server.h>
+#include <wayland/frame_timing.h>
 #include <stdlib.h>
 
 static void compositor_create_surface(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
@@ -22,14 +23,16 @@ static void compositor_create_surface(struct wl_client *client, struct wl_resour
         return;
     }
     
+    surface->id = ++server->next_surface_id;
     surface->resource = surface_resource;
-    // surface->buffer = NULL;
     surface->server = server;
     surface->xdg_surface = NULL;
     surface->xdg_toplevel = NULL;
+    surface->timing = frame_timing_surface_acquire(server->frame_timing, surface->id);
     wl_list_init(&surface->link);
+    surface_init_state(surface);
     
-    wl_resource_set_implementation(surface_resource, &surface_implementation, surface, NULL); // TODO: destructor
+    wl_resource_set_implementation(surface_resource, &surface_implementation, surface, surface_resource_destroy);
 
     SERVER_DEBUG("COMPOSITOR: Creating wl_surface id=%u, surface_implementation.attach=%p", 
                 id, surface_implementation.attach);
@@ -1,8 +1,13 @@
 #include <wayland/compositor.h>
 #include <wayland/server.h>
 #include <wayland/buffer.h>
+#include <wayland/frame_scheduler.h>
+#include <wayland/buffer_tracker.h>
+#include <wayland/buffer_ring.h>
+#include <wayland/frame_timing.h>
 #include <logger.h>
 #include <stdlib.h>
+#include <string.h>
 #include <dbus-server/modules/buffer_module.h>
 #include <dbus-server/server.h>
 
@@ -58,23 +63,326 @@ static const char* buffer_type_to_string(struct buffer *buffer) {
     }
 }
 
-static void surface_destroy(struct wl_client *client, struct wl_resource *resource) {
+/* Drop the state's buffer reference when the client destroys the wl_buffer */
+static void surface_state_handle_buffer_destroy(struct wl_listener *listener, void *data) {
+    struct surface_state *state = wl_container_of(listener, state, buffer_destroy);
+
+    wl_list_remove(&state->buffer_destroy.link);
+    wl_list_init(&state->buffer_destroy.link);
+    state->buffer = NULL;
+}
+
+static void surface_state_set_buffer(struct surface_state *state, struct buffer *buffer) {
+    if (state->buffer == buffer) return;
+
+    wl_list_remove(&state->buffer_destroy.link);
+    wl_list_init(&state->buffer_destroy.link);
+    state->buffer = buffer;
+
+    if (buffer && buffer->resource) {
+        wl_resource_add_destroy_listener(buffer->resource, &state->buffer_destroy);
+    }
+}
+
+static void surface_state_init(struct surface_state *state) {
+    state->committed = 0;
+    state->buffer = NULL;
+    state->buffer_destroy.notify = surface_state_handle_buffer_destroy;
+    wl_list_init(&state->buffer_destroy.link);
+    region_init(&state->surface_damage);
+    region_init(&state->buffer_damage);
+    wl_list_init(&state->frame_callbacks);
+    state->dx = 0;
+    state->dy = 0;
+    state->scale = 1;
+    state->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+    state->width = 0;
+    state->height = 0;
+}
+
+static void surface_state_finish(struct surface_state *state) {
+    surface_state_set_buffer(state, NULL);
+
+    struct wl_resource *callback, *tmp;
+    wl_resource_for_each_safe(callback, tmp, &state->frame_callbacks) {
+        wl_resource_destroy(callback);
+    }
+}
+
+void surface_init_state(struct surface *surface) {
+    surface_state_init(&surface->pending);
+    surface_state_init(&surface->current);
+}
+
+/* Surface-local size from buffer size, buffer_transform and buffer_scale */
+static void surface_state_update_size(struct surface_state *state) {
+    if (!state->buffer) {
+        state->width = 0;
+        state->height = 0;
+        return;
+    }
+
+    int32_t width = state->buffer->width;
+    int32_t height = state->buffer->height;
+
+    /* 90 and 270 degree transforms (flipped or not) swap the axes */
+    if (state->transform & WL_OUTPUT_TRANSFORM_90) {
+        int32_t tmp = width;
+        width = height;
+        height = tmp;
+    }
+
+    state->width = width / state->scale;
+    state->height = height / state->scale;
+}
+
+/* Inverse of an output transform (only plain 90/270 differ from their inverse) */
+static int32_t output_transform_invert(int32_t transform) {
+    if ((transform & WL_OUTPUT_TRANSFORM_90) && !(transform & WL_OUTPUT_TRANSFORM_FLIPPED)) {
+        transform ^= WL_OUTPUT_TRANSFORM_180;
+    }
+    return transform;
+}
+
+/* Merge pending surface and buffer damage into current, in buffer coordinates */
+static void surface_state_apply_damage(struct surface_state *pending, struct surface_state *current,
+                                       uint32_t prev_width, uint32_t prev_height) {
+    struct buffer *buffer = current->buffer;
+
+    region_clear(&current->buffer_damage);
+
+    if (!buffer) {
+        region_clear(&pending->surface_damage);
+        region_clear(&pending->buffer_damage);
+        return;
+    }
+
+    if (buffer->width != prev_width || buffer->height != prev_height) {
+        /* Consumers can not reuse old content of a different size */
+        region_add_rect(&current->buffer_damage, 0, 0, buffer->width, buffer->height);
+        current->committed |= SURFACE_STATE_DAMAGE;
+    } else {
+        struct region *damage = &pending->surface_damage;
+
+        /* surface-local -> transformed buffer space -> buffer space */
+        region_scale(damage, current->scale);
+        region_transform(damage, damage, output_transform_invert(current->transform),
+                         current->width * current->scale, current->height * current->scale);
+
+        region_union(&current->buffer_damage, damage);
+        region_union(&current->buffer_damage, &pending->buffer_damage);
+        region_intersect_rect(&current->buffer_damage, 0, 0, buffer->width, buffer->height);
+    }
+
+    region_clear(&pending->surface_damage);
+    region_clear(&pending->buffer_damage);
+}
+
+/* Move every committed pending field into current in one step */
+static void surface_state_apply(struct surface *surface) {
+    struct surface_state *pending = &surface->pending;
+    struct surface_state *current = &surface->current;
+
+    uint32_t prev_width = current->buffer ? current->buffer->width : 0;
+    uint32_t prev_height = current->buffer ? current->buffer->height : 0;
+
+    if (pending->committed & SURFACE_STATE_BUFFER) {
+        surface_state_set_buffer(current, pending->buffer);
+        surface_state_set_buffer(pending, NULL);
+    }
+
+    if (pending->committed & SURFACE_STATE_OFFSET) {
+        current->dx = pending->dx;
+        current->dy = pending->dy;
+        pending->dx = 0;
+        pending->dy = 0;
+    } else {
+        current->dx = 0;
+        current->dy = 0;
+    }
+
+    if (pending->committed & SURFACE_STATE_SCALE) {
+        current->scale = pending->scale;
+    }
+
+    if (pending->committed & SURFACE_STATE_TRANSFORM) {
+        current->transform = pending->transform;
+    }
+
+    /* Frame callbacks are double-buffered too, queue behind unsent ones */
+    wl_list_insert_list(current->frame_callbacks.prev, &pending->frame_callbacks);
+    wl_list_init(&pending->frame_callbacks);
+
+    current->committed = pending->committed;
+    pending->committed = 0;
+
+    surface_state_update_size(current);
+    surface_state_apply_damage(pending, current, prev_width, prev_height);
+}
+
+/* Ring record of an update, damage clipped to BUFFER_RING_MAX_DAMAGE */
+static void surface_fill_ring_record(struct buffer_ring_record *record, const BufferInfo *info) {
+    memset(record, 0, sizeof(*record));
+    record->kind = BUFFER_RING_RECORD_UPDATE;
+    record->surface_id = info->surface_id;
+    record->buffer_id = info->buffer_id;
+    record->serial = info->serial;
+    record->type = info->type == WL_BUFFER_DMA_BUF ? BUFFER_RING_TYPE_DMABUF : BUFFER_RING_TYPE_SHM;
+    record->format = info->format;
+    record->width = info->width;
+    record->height = info->height;
+    record->modifier = info->modifier;
+
+    record->n_planes = 1;
+    record->offset[0] = info->offset;
+    record->stride[0] = info->stride;
+    for (uint32_t i = 0; i < info->extra_planes && record->n_planes < BUFFER_RING_MAX_FDS; i++) {
+        record->offset[record->n_planes] = info->plane_offsets[i];
+        record->stride[record->n_planes] = info->plane_strides[i];
+        record->n_planes++;
+    }
+
+    const struct region *damage = info->damage;
+    for (uint32_t i = 0; damage && i < damage->n_boxes && i < BUFFER_RING_MAX_DAMAGE; i++) {
+        const struct region_box *box = &damage->boxes[i];
+        record->damage[i][0] = box->x1;
+        record->damage[i][1] = box->y1;
+        record->damage[i][2] = box->x2 - box->x1;
+        record->damage[i][3] = box->y2 - box->y1;
+        record->n_damage++;
+    }
+}
+
+/* Publish committed surface content to D-Bus consumers (one update per commit) */
+static void surface_publish_update(struct surface *surface, uint32_t serial) {
+    struct buffer *buffer = surface->current.buffer;
+
+    if (!buffer) return;
+
+    if (!surface->server || !surface->server->dbus_server) {
+        SERVER_DEBUG("No D-Bus server available for sending buffer update");
+        return;
+    }
+
+    struct dbus_server *dbus_server = surface->server->dbus_server;
+
+    BufferInfo info = {
+        .width = buffer->width,
+        .height = buffer->height,
+        .format_str = pixel_format_to_string(buffer->format),
+        .size = buffer->size,
+        .type = buffer->type,
+        .damage = &surface->current.buffer_damage,
+        .serial = serial,
+        .surface_id = surface->id,
+        .buffer_id = buffer->id,
+        .modifier = DRM_FORMAT_MOD_LINEAR
+    };
+
+    switch (buffer->type) {
+        case WL_BUFFER_SHM:
+            info.stride = buffer->shm.stride;
+            info.format = buffer->shm.format;
+            info.fd = buffer->shm.fd;
+            info.offset = buffer->shm.offset;
+            break;
+        case WL_BUFFER_DMA_BUF:
+            info.stride = buffer->dmabuf.stride[0];
+            info.format = buffer->dmabuf.format;
+            info.fd = buffer->dmabuf.fd[0];
+            info.offset = buffer->dmabuf.offset[0];
+            info.modifier = buffer->dmabuf.modifier;
+            info.extra_planes = buffer->dmabuf.num_planes - 1;
+            for (uint32_t i = 1; i < buffer->dmabuf.num_planes; i++) {
+                info.plane_fds[i - 1] = buffer->dmabuf.fd[i];
+                info.plane_offsets[i - 1] = buffer->dmabuf.offset[i];
+                info.plane_strides[i - 1] = buffer->dmabuf.stride[i];
+            }
+            break;
+        default:
+            SERVER_DEBUG("Buffer type %s is not forwarded", buffer_type_to_string(buffer));
+            return;
+    }
+
+    /* Steady state goes through the shared-memory rings, D-Bus covers everyone they missed */
+    struct buffer_ring_record record;
+    surface_fill_ring_record(&record, &info);
+    /* Stamped before either transport sees the update: the consumer (ring) or the
+     * D-Bus thread (buffer_module_update_sent) may stamp later steps before we return.
+     * Registration and signal building of the D-Bus fallback count as enqueue_send */
+    uint64_t enqueue_ns = frame_timing_now();
+    frame_timing_stamp(surface->timing, serial, FRAME_STAMP_ENQUEUE, enqueue_ns);
+
+    /* Without any ring the signal also feeds passive listeners (no subscription) */
+    struct buffer_tracker *tracker = surface->server->buffer_tracker;
+    if (buffer_ring_publish(surface->server->buffer_ring, buffer, &record) &&
+        !buffer_tracker_needs_signal(tracker, buffer)) {
+        /* The consumer sees the record as soon as it is published */
+        frame_timing_stamp(surface->timing, serial, FRAME_STAMP_SEND, enqueue_ns);
+        return;
+    }
+
+    /* fds go out once per buffer, new subscribers bump the epoch to get them too */
+    if (buffer->dbus_epoch != tracker->consumer_epoch) {
+        if (!buffer_module_send_registered_signal(dbus_server, &info)) {
+            buffer_tracker_drop(tracker, serial);
+            return;
+        }
+        buffer->dbus_epoch = tracker->consumer_epoch;
+    }
+
+    /* Queued for the D-Bus thread, only ring consumers will ack a dropped update */
+    if (!buffer_module_send_update_signal(dbus_server, &info)) {
+        buffer_tracker_drop(tracker, serial);
+        return;
+    }
+    SERVER_DEBUG("D-Bus update signal queued for buffer %u", buffer->id);
+}
+
+/* wl_surface resource destructor */
+void surface_resource_destroy(struct wl_resource *resource) {
     struct surface *surface = wl_resource_get_user_data(resource);
-    
+
     SERVER_DEBUG("SURFACE: Resource destroyed, surface=%p", surface);
-    
-    if (surface) {
-        wl_list_remove(&surface->link);
-        free(surface);
-    }
+
+    if (!surface) return;
+
+    frame_timing_surface_release(surface->timing);
+    surface_state_finish(&surface->pending);
+    surface_state_finish(&surface->current);
+    wl_list_remove(&surface->link);
+    free(surface);
+}
+
+static void surface_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
 }
 
 static void surface_damage(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {
-    SERVER_DEBUG("SURFACE DAMAGE CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface || width <= 0 || height <= 0) return;
+
+    region_add_rect(&surface->pending.surface_damage, x, y, width, height);
+    surface->pending.committed |= SURFACE_STATE_DAMAGE;
+    SERVER_DEBUG("SURFACE DAMAGE: %d,%d %dx%d", x, y, width, height);
+}
+
+static void frame_callback_resource_destroy(struct wl_resource *resource) {
+    wl_list_remove(wl_resource_get_link(resource));
 }
 
 static void surface_frame(struct wl_client *client, struct wl_resource *resource, uint32_t callback) {
-    SERVER_DEBUG("SURFACE FRAME CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
+
+    struct wl_resource *callback_resource = wl_resource_create(client, &wl_callback_interface, 1, callback);
+    if (!callback_resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(callback_resource, NULL, NULL, frame_callback_resource_destroy);
+    wl_list_insert(surface->pending.frame_callbacks.prev, wl_resource_get_link(callback_resource));
 }
 
 static void surface_set_opaque_region(struct wl_client *client, struct wl_resource *resource, struct wl_resource *region) {
@@ -85,96 +393,126 @@ static void surface_set_input_region(struct wl_client *client, struct wl_resourc
     SERVER_DEBUG("SURFACE SET_INPUT_REGION CALLED");
 }
 
+/* Client pid, surface and buffer ids on every log message of this request */
+static void surface_set_log_fields(struct wl_client *client, struct surface *surface, struct buffer *buffer) {
+    pid_t pid = 0;
+    wl_client_get_credentials(client, &pid, NULL, NULL);
+
+    log_fields_t fields = {
+        .client_pid = pid,
+        .surface_id = surface->id,
+        .buffer_id = buffer ? buffer->id : 0,
+    };
+    logger_set_fields(&fields);
+}
+
 static void surface_commit(struct wl_client *client, struct wl_resource *resource) {
-    // struct surface *surface = wl_resource_get_user_data(resource);
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
 
-    // if (!surface) return;
-    
-    // if (surface->pending_changes.attach == true) {
-    //     if (surface->buffer) {
-    //         wl_buffer_send_release(surface->buffer);
-    //     }
-
-    //     // Set new buffer (May be NULL to detach)
-    //     if (surface->pending_buffer) {
-    //         surface->buffer = surface->pending_buffer;
-    //         surface->pending_buffer = NULL; // Передача владения
-
-    //         // Обновляем размеры поверхности (Should add get buffer size)
-    //         int width, height;
-    //         // if (get_buffer_size(surface->buffer, &width, &height)) {
-    //         //     // Применяем масштабирование
-    //         //     surface->width = width / surface->buffer_scale;
-    //         //     surface->height = height / surface->buffer_scale;
-    //         // }
-    //         SERVER_DEBUG("Surface committed: buffer=%p, size=%dx%d", surface->buffer, surface->width, surface->height);
-    //     } else {
-    //         // Buffer detach
-    //         surface->width = 0;
-    //         surface->height = 0;
-    //         SERVER_DEBUG("Surface committed: buffer detached");
-    //     }
-
-    //     surface->pending_changes.attach = false;
-    // }
-    SERVER_DEBUG("SURFACE COMMIT CALLED");
+    uint64_t commit_ns = frame_timing_now();
+    surface_state_apply(surface);
+    surface_set_log_fields(client, surface, surface->current.buffer);
+    uint32_t committed = surface->current.committed;
+
+    SERVER_DEBUG("Surface committed: fields=0x%x, buffer=%p, size=%dx%d, scale=%d, transform=%d, damage boxes=%u",
+                 committed, surface->current.buffer, surface->current.width, surface->current.height,
+                 surface->current.scale, surface->current.transform, surface->current.buffer_damage.n_boxes);
+
+    if (surface->current.buffer && (committed & (SURFACE_STATE_BUFFER | SURFACE_STATE_DAMAGE))) {
+        /* Busy until every consumer acked this serial */
+        uint32_t serial = buffer_tracker_mark_busy(surface->server->buffer_tracker, surface->current.buffer);
+        frame_timing_commit(surface->timing, serial, commit_ns);
+        surface_publish_update(surface, serial);
+    }
+
+    if (!wl_list_empty(&surface->current.frame_callbacks)) {
+        frame_scheduler_schedule(surface->server->frame_scheduler);
+    }
+
+    logger_set_fields(NULL);
 }
 
 static void surface_set_buffer_transform(struct wl_client *client, struct wl_resource *resource, int32_t transform) {
-    SERVER_DEBUG("SURFACE SET_BUFFER_TRANSFORM CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
+
+    if (transform < WL_OUTPUT_TRANSFORM_NORMAL || transform > WL_OUTPUT_TRANSFORM_FLIPPED_270) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_TRANSFORM,
+                               "Invalid buffer transform: %d", transform);
+        return;
+    }
+
+    surface->pending.transform = transform;
+    surface->pending.committed |= SURFACE_STATE_TRANSFORM;
 }
 
 static void surface_set_buffer_scale(struct wl_client *client, struct wl_resource *resource, int32_t scale) {
-    SERVER_DEBUG("SURFACE SET_BUFFER_SCALE CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
+
+    if (scale < 1) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_SCALE,
+                               "Invalid buffer scale: %d", scale);
+        return;
+    }
+
+    surface->pending.scale = scale;
+    surface->pending.committed |= SURFACE_STATE_SCALE;
 }
 
 static void surface_damage_buffer(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y, int32_t width, int32_t height) {
-    SERVER_DEBUG("SURFACE DAMAGE BUFFER CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface || width <= 0 || height <= 0) return;
+
+    region_add_rect(&surface->pending.buffer_damage, x, y, width, height);
+    surface->pending.committed |= SURFACE_STATE_DAMAGE;
+    SERVER_DEBUG("SURFACE DAMAGE BUFFER: %d,%d %dx%d", x, y, width, height);
 }
 
 static void surface_offset(struct wl_client *client, struct wl_resource *resource, int32_t x, int32_t y) {
-    SERVER_DEBUG("SURFACE OFFSET CALLED");
+    struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
+
+    surface->pending.dx = x;
+    surface->pending.dy = y;
+    surface->pending.committed |= SURFACE_STATE_OFFSET;
 }
 
 static void surface_headless_attach(struct wl_client *client, struct wl_resource *resource, struct wl_resource *buffer_resource, int32_t x, int32_t y) {
-    SERVER_DEBUG(">>>>>> ENTERING surface_headless_attach <<<<<<");
     SERVER_DEBUG("resource=%p, buffer=%p, x=%d, y=%d", resource, buffer_resource, x, y);
     
     struct surface *surface = wl_resource_get_user_data(resource);
+    if (!surface) return;
 
-    if (!surface || !buffer_resource) return;
-    
-    struct buffer *buffer = wl_resource_get_user_data(buffer_resource);
-    SERVER_DEBUG("Called attach buffer with type: %s, size: %i or %iX%i\nBuffer data pointer: %p", 
-                 buffer_type_to_string(buffer), buffer->size, buffer->width, buffer->height, buffer->shm.data);
-
-    // Отправляем D-Bus сигнал о новом буфере
-    if (surface->server && surface->server->dbus_server) {
-        // Получаем D-Bus соединение
-        DBusConnection *conn = surface->server->dbus_server->connection;
-        
-        if (conn) {
-            // Создаем BufferInfo
-            BufferInfo info = {
-                .width = buffer->width,
-                .height = buffer->height,
-                .stride = buffer->width * 4,  // Предполагаем 32 бита на пиксель
-                .format = buffer->type == WL_BUFFER_SHM ? WL_SHM_FORMAT_XRGB8888 : 0,
-                .format_str = buffer_type_to_string(buffer),
-                .size = buffer->size,
-                .type = buffer->type,
-                .fd = buffer->shm.fd
-            };
-            
-            // Отправляем сигнал
-            buffer_module_send_update_signal(conn, &info);
-            SERVER_DEBUG("D-Bus update signal sent for buffer %dx%d", buffer->width, buffer->height);
-        } else {
-            SERVER_DEBUG("No D-Bus connection available");
-        }
-    } else {
-        SERVER_DEBUG("No D-Bus server available for sending buffer update");
+    /* Since wl_surface v5 the offset goes through wl_surface.offset */
+    if ((x != 0 || y != 0) && wl_resource_get_version(resource) >= WL_SURFACE_OFFSET_SINCE_VERSION) {
+        wl_resource_post_error(resource, WL_SURFACE_ERROR_INVALID_OFFSET,
+                               "Attach offset must be zero since version %d", WL_SURFACE_OFFSET_SINCE_VERSION);
+        return;
+    }
+
+    struct buffer *buffer = buffer_resource ? wl_resource_get_user_data(buffer_resource) : NULL;
+    surface_set_log_fields(client, surface, buffer);
+    if (buffer) {
+        SERVER_DEBUG("Called attach buffer with type: %s, size: %zu or %ux%u\nBuffer data pointer: %p", 
+                     buffer_type_to_string(buffer), buffer->size, buffer->width, buffer->height, shm_buffer_get_data(buffer));
+    }
+
+    /* Only stage the buffer here, surface_commit applies and publishes it */
+    surface_state_set_buffer(&surface->pending, buffer);
+    if (buffer) {
+        frame_timing_attach(surface->timing, frame_timing_now());
+    }
+    surface->pending.committed |= SURFACE_STATE_BUFFER;
+
+    if (x != 0 || y != 0) {
+        surface->pending.dx = x;
+        surface->pending.dy = y;
+        surface->pending.committed |= SURFACE_STATE_OFFSET;
     }
+
+    logger_set_fields(NULL);
 }
 
 const struct wl_surface_interface surface_implementation = {
@@ -0,0 +1,231 @@
+#include <wayland/frame_scheduler.h>
+#include <wayland/server.h>
+#include <logger.h>
+
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+/* Liveness fallback while vblanks are driven by presentation feedback */
+#define FRAME_SCHEDULER_FEEDBACK_TIMEOUT_NS (1000 * NSEC_PER_MSEC)
+
+/* requested_refresh_mhz value meaning "no request pending" */
+#define FRAME_SCHEDULER_NO_REQUEST UINT32_MAX
+
+static uint64_t monotonic_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts = {
+        .tv_sec = ns / NSEC_PER_SEC,
+        .tv_nsec = ns % NSEC_PER_SEC,
+    };
+    return ts;
+}
+
+static void frame_scheduler_disarm(struct frame_scheduler *scheduler) {
+    if (!scheduler->armed) return;
+
+    struct itimerspec its = {0};
+    timerfd_settime(scheduler->timer_fd, 0, &its, NULL);
+    scheduler->armed = false;
+}
+
+/* Start the periodic timer, phase aligned to the virtual vblank grid */
+static void frame_scheduler_arm(struct frame_scheduler *scheduler) {
+    if (scheduler->armed) return;
+
+    uint64_t interval = scheduler->refresh_mhz ? scheduler->interval_ns : FRAME_SCHEDULER_FEEDBACK_TIMEOUT_NS;
+    uint64_t now = monotonic_now_ns();
+    uint64_t next = (now / interval + 1) * interval;
+
+    struct itimerspec its = {
+        .it_interval = ns_to_timespec(interval),
+        .it_value = ns_to_timespec(next),
+    };
+
+    if (timerfd_settime(scheduler->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        SERVER_ERROR("FRAME: timerfd_settime failed: %s", strerror(errno));
+        return;
+    }
+    scheduler->armed = true;
+}
+
+/* Send wl_callback.done to every presented surface, returns number of surfaces served */
+static int frame_scheduler_dispatch(struct frame_scheduler *scheduler) {
+    uint32_t time_ms = (uint32_t)(monotonic_now_ns() / NSEC_PER_MSEC);
+    int served = 0;
+
+    struct surface *surface;
+    wl_list_for_each(surface, &scheduler->server->surfaces, link) {
+        if (wl_list_empty(&surface->current.frame_callbacks)) continue;
+
+        /* Approximation: mapped counts as presented, see frame_scheduler.h.
+         * Unmapped surfaces keep their callbacks */
+        if (!surface->current.buffer) continue;
+
+        struct wl_resource *callback, *tmp;
+        wl_resource_for_each_safe(callback, tmp, &surface->current.frame_callbacks) {
+            wl_callback_send_done(callback, time_ms);
+            wl_resource_destroy(callback);
+        }
+        served++;
+    }
+
+    scheduler->vblank_count++;
+    return served;
+}
+
+static int handle_timer(int fd, uint32_t mask, void *data) {
+    struct frame_scheduler *scheduler = data;
+
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+
+    if (expirations > 1) {
+        SERVER_DEBUG("FRAME: missed %llu vblank(s)", (unsigned long long)(expirations - 1));
+    }
+
+    /* Nothing to pace, stop ticking until the next commit with callbacks */
+    if (frame_scheduler_dispatch(scheduler) == 0) {
+        frame_scheduler_disarm(scheduler);
+    }
+
+    return 0;
+}
+
+static void frame_scheduler_set_refresh_mhz(struct frame_scheduler *scheduler, uint32_t refresh_mhz) {
+    scheduler->refresh_mhz = refresh_mhz;
+    scheduler->interval_ns = refresh_mhz ? (NSEC_PER_SEC * 1000ULL) / refresh_mhz : 0;
+
+    /* Re-arm with the new period */
+    if (scheduler->armed) {
+        frame_scheduler_disarm(scheduler);
+        frame_scheduler_arm(scheduler);
+    }
+
+    if (refresh_mhz) {
+        SERVER_INFO("FRAME: refresh rate set to %u.%03u Hz", refresh_mhz / 1000, refresh_mhz % 1000);
+    } else {
+        SERVER_INFO("FRAME: refresh driven by renderer presentation feedback");
+    }
+}
+
+static int handle_event(int fd, uint32_t mask, void *data) {
+    struct frame_scheduler *scheduler = data;
+
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+
+    unsigned int refresh_mhz = atomic_exchange(&scheduler->requested_refresh_mhz, FRAME_SCHEDULER_NO_REQUEST);
+    if (refresh_mhz != FRAME_SCHEDULER_NO_REQUEST) {
+        frame_scheduler_set_refresh_mhz(scheduler, refresh_mhz);
+    }
+
+    /* Presentation feedback is the vblank in feedback mode */
+    if (atomic_exchange(&scheduler->presented, 0) > 0 && scheduler->refresh_mhz == 0) {
+        frame_scheduler_dispatch(scheduler);
+
+        /* Restart the liveness fallback from now */
+        frame_scheduler_disarm(scheduler);
+        frame_scheduler_arm(scheduler);
+    }
+
+    return 0;
+}
+
+static void frame_scheduler_kick(struct frame_scheduler *scheduler) {
+    uint64_t one = 1;
+    if (write(scheduler->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        SERVER_ERROR("FRAME: failed to wake Wayland loop: %s", strerror(errno));
+    }
+}
+
+struct frame_scheduler *frame_scheduler_create(struct server *server) {
+    struct frame_scheduler *scheduler = calloc(1, sizeof(struct frame_scheduler));
+    if (!scheduler) {
+        SERVER_ERROR("Failed to allocate frame scheduler");
+        return NULL;
+    }
+
+    scheduler->server = server;
+    scheduler->armed = false;
+    scheduler->event_fd = -1;
+    atomic_init(&scheduler->requested_refresh_mhz, FRAME_SCHEDULER_NO_REQUEST);
+    atomic_init(&scheduler->presented, 0);
+
+    scheduler->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (scheduler->timer_fd < 0) {
+        SERVER_ERROR("Failed to create frame timerfd: %s", strerror(errno));
+        goto err;
+    }
+
+    scheduler->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (scheduler->event_fd < 0) {
+        SERVER_ERROR("Failed to create frame eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    scheduler->timer_source = wl_event_loop_add_fd(loop, scheduler->timer_fd, WL_EVENT_READABLE, handle_timer, scheduler);
+    scheduler->event_source = wl_event_loop_add_fd(loop, scheduler->event_fd, WL_EVENT_READABLE, handle_event, scheduler);
+    if (!scheduler->timer_source || !scheduler->event_source) {
+        SERVER_ERROR("Failed to add frame scheduler to event loop");
+        goto err;
+    }
+
+    frame_scheduler_set_refresh_mhz(scheduler, FRAME_SCHEDULER_DEFAULT_REFRESH * 1000);
+    return scheduler;
+
+err:
+    frame_scheduler_destroy(scheduler);
+    return NULL;
+}
+
+void frame_scheduler_destroy(struct frame_scheduler *scheduler) {
+    if (!scheduler) return;
+
+    if (scheduler->timer_source) wl_event_source_remove(scheduler->timer_source);
+    if (scheduler->event_source) wl_event_source_remove(scheduler->event_source);
+    if (scheduler->timer_fd >= 0) close(scheduler->timer_fd);
+    if (scheduler->event_fd >= 0) close(scheduler->event_fd);
+
+    free(scheduler);
+}
+
+void frame_scheduler_schedule(struct frame_scheduler *scheduler) {
+    if (!scheduler) return;
+    frame_scheduler_arm(scheduler);
+}
+
+void frame_scheduler_set_refresh_rate(struct frame_scheduler *scheduler, uint32_t refresh_hz) {
+    if (!scheduler) return;
+    frame_scheduler_set_refresh_mhz(scheduler, refresh_hz * 1000);
+}
+
+void frame_scheduler_request_refresh_mhz(struct frame_scheduler *scheduler, uint32_t refresh_mhz) {
+    if (!scheduler || refresh_mhz == FRAME_SCHEDULER_NO_REQUEST) return;
+
+    atomic_store(&scheduler->requested_refresh_mhz, refresh_mhz);
+    frame_scheduler_kick(scheduler);
+}
+
+void frame_scheduler_notify_presented(struct frame_scheduler *scheduler) {
+    if (!scheduler) return;
+
+    atomic_fetch_add(&scheduler->presented, 1);
+    frame_scheduler_kick(scheduler);
+}
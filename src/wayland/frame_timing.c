@@ -0,0 +1,318 @@
+#include <wayland/frame_timing.h>
+#include <wayland/server.h>
+#include <logger.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *stage_names[FRAME_STAGE_COUNT] = {
+    [FRAME_STAGE_ATTACH_COMMIT] = "attach_commit",
+    [FRAME_STAGE_COMMIT_ENQUEUE] = "commit_enqueue",
+    [FRAME_STAGE_ENQUEUE_SEND] = "enqueue_send",
+    [FRAME_STAGE_SEND_RECEIVE] = "send_receive",
+    [FRAME_STAGE_RECEIVE_UPLOAD] = "receive_upload",
+    [FRAME_STAGE_UPLOAD_PRESENT] = "upload_present",
+    [FRAME_STAGE_TOTAL] = "commit_present",
+};
+
+static uint32_t histogram_bucket(uint64_t ns) {
+    if (ns < (1u << FRAME_HISTOGRAM_SUB_BITS)) return (uint32_t)ns;
+    if (ns >> FRAME_HISTOGRAM_MAX_BITS) return FRAME_HISTOGRAM_BUCKETS - 1;
+
+    uint32_t exponent = 63 - (uint32_t)__builtin_clzll(ns);
+    uint32_t shift = exponent - FRAME_HISTOGRAM_SUB_BITS;
+    uint32_t sub = (uint32_t)(ns >> shift) & ((1u << FRAME_HISTOGRAM_SUB_BITS) - 1);
+    return ((shift + 1) << FRAME_HISTOGRAM_SUB_BITS) + sub;
+}
+
+/* Highest value that falls into the bucket */
+static uint64_t histogram_bucket_value(uint32_t bucket) {
+    if (bucket < (1u << FRAME_HISTOGRAM_SUB_BITS)) return bucket;
+
+    uint32_t shift = (bucket >> FRAME_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub = bucket & ((1u << FRAME_HISTOGRAM_SUB_BITS) - 1);
+    return (((1ull << FRAME_HISTOGRAM_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+static void histogram_record(struct frame_histogram *histogram, uint64_t ns) {
+    atomic_fetch_add_explicit(&histogram->buckets[histogram_bucket(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&histogram->max, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed));
+}
+
+static void histogram_reset(struct frame_histogram *histogram) {
+    for (uint32_t i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++) {
+        atomic_store_explicit(&histogram->buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&histogram->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+}
+
+static void histogram_summary(struct frame_histogram *histogram, struct frame_timing_summary *summary) {
+    static const double quantiles[] = { 0.50, 0.90, 0.99 };
+    uint64_t *values[] = { &summary->p50, &summary->p90, &summary->p99 };
+
+    memset(summary, 0, sizeof(*summary));
+    summary->count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    summary->max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    if (summary->count == 0) return;
+
+    uint64_t seen = 0;
+    uint32_t bucket = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t rank = (uint64_t)(quantiles[i] * (double)summary->count);
+        if (rank == 0) rank = 1;
+
+        while (bucket < FRAME_HISTOGRAM_BUCKETS - 1 &&
+               seen + atomic_load_explicit(&histogram->buckets[bucket], memory_order_relaxed) < rank) {
+            seen += atomic_load_explicit(&histogram->buckets[bucket], memory_order_relaxed);
+            bucket++;
+        }
+
+        /* Never report more than the real maximum */
+        uint64_t value = histogram_bucket_value(bucket);
+        *values[i] = value < summary->max ? value : summary->max;
+    }
+}
+
+static struct frame_timing_surface *find_surface(struct frame_timing *timing, uint32_t surface_id) {
+    if (!timing || surface_id == 0) return NULL;
+
+    for (int i = 0; i < FRAME_TIMING_MAX_SURFACES; i++) {
+        if (atomic_load_explicit(&timing->surfaces[i].surface_id, memory_order_acquire) == surface_id) {
+            return &timing->surfaces[i];
+        }
+    }
+    return NULL;
+}
+
+static void surface_reset(struct frame_timing_surface *surface) {
+    for (int i = 0; i < FRAME_STAGE_COUNT; i++) {
+        histogram_reset(&surface->stages[i]);
+    }
+}
+
+static void dump_surface(struct frame_timing_surface *surface, uint32_t surface_id) {
+    char line[768];
+    size_t length = 0;
+
+    for (int i = 0; i < FRAME_STAGE_COUNT && length < sizeof(line); i++) {
+        struct frame_timing_summary summary;
+        histogram_summary(&surface->stages[i], &summary);
+        if (summary.count == 0) continue;
+
+        int written = snprintf(line + length, sizeof(line) - length, "%s%s %llu/%llu/%llu",
+                               length ? ", " : "", stage_names[i],
+                               (unsigned long long)(summary.p50 / 1000), (unsigned long long)(summary.p99 / 1000),
+                               (unsigned long long)(summary.max / 1000));
+        if (written > 0) length += (size_t)written;
+    }
+    if (length == 0) return;
+
+    log_fields_t fields = { .surface_id = surface_id };
+    logger_set_fields(&fields);
+    SERVER_INFO("FRAME TIMING surface %u (p50/p99/max us): %s", surface_id, line);
+    logger_set_fields(NULL);
+}
+
+static int handle_dump(void *data) {
+    struct frame_timing *timing = data;
+
+    for (int i = 0; i < FRAME_TIMING_MAX_SURFACES; i++) {
+        uint32_t surface_id = atomic_load_explicit(&timing->surfaces[i].surface_id, memory_order_relaxed);
+        if (surface_id) {
+            dump_surface(&timing->surfaces[i], surface_id);
+        }
+    }
+
+    if (timing->dump_interval_ms > 0) {
+        wl_event_source_timer_update(timing->dump_source, timing->dump_interval_ms);
+    }
+    return 0;
+}
+
+struct frame_timing *frame_timing_create(struct server *server) {
+    struct frame_timing *timing = calloc(1, sizeof(struct frame_timing));
+    if (!timing) {
+        SERVER_ERROR("Failed to allocate frame timing");
+        return NULL;
+    }
+
+    timing->server = server;
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    timing->dump_source = wl_event_loop_add_timer(loop, handle_dump, timing);
+    if (!timing->dump_source) {
+        SERVER_ERROR("Failed to add frame timing to event loop");
+        frame_timing_destroy(timing);
+        return NULL;
+    }
+
+    return timing;
+}
+
+void frame_timing_destroy(struct frame_timing *timing) {
+    if (!timing) return;
+
+    if (timing->dump_source) wl_event_source_remove(timing->dump_source);
+    free(timing);
+}
+
+void frame_timing_set_dump_interval(struct frame_timing *timing, int seconds) {
+    if (!timing) return;
+
+    timing->dump_interval_ms = seconds > 0 ? seconds * 1000 : 0;
+    /* 0 disarms the timer */
+    wl_event_source_timer_update(timing->dump_source, timing->dump_interval_ms);
+}
+
+struct frame_timing_surface *frame_timing_surface_acquire(struct frame_timing *timing, uint32_t surface_id) {
+    if (!timing || surface_id == 0) return NULL;
+
+    for (int i = 0; i < FRAME_TIMING_MAX_SURFACES; i++) {
+        struct frame_timing_surface *surface = &timing->surfaces[i];
+        if (atomic_load_explicit(&surface->surface_id, memory_order_relaxed) != 0) continue;
+
+        surface->attach_ns = 0;
+        surface->next_frame = 0;
+        for (int j = 0; j < FRAME_TIMING_IN_FLIGHT; j++) {
+            atomic_store_explicit(&surface->frames[j].serial, 0, memory_order_relaxed);
+        }
+        surface_reset(surface);
+
+        atomic_store_explicit(&surface->surface_id, surface_id, memory_order_release);
+        return surface;
+    }
+
+    SERVER_DEBUG("FRAME TIMING: no free slot for surface %u", surface_id);
+    return NULL;
+}
+
+void frame_timing_surface_release(struct frame_timing_surface *surface) {
+    if (!surface) return;
+    atomic_store_explicit(&surface->surface_id, 0, memory_order_release);
+}
+
+void frame_timing_attach(struct frame_timing_surface *surface, uint64_t now) {
+    if (!surface) return;
+    surface->attach_ns = now;
+}
+
+void frame_timing_commit(struct frame_timing_surface *surface, uint32_t serial, uint64_t now) {
+    if (!surface || serial == 0) return;
+
+    /* Recycle the oldest slot, frames that never got further are dropped */
+    struct frame_timing_frame *frame = &surface->frames[surface->next_frame++ & (FRAME_TIMING_IN_FLIGHT - 1)];
+    atomic_store_explicit(&frame->serial, 0, memory_order_relaxed);
+    for (int i = 0; i < FRAME_STAMP_COUNT; i++) {
+        atomic_store_explicit(&frame->stamps[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&frame->recorded, 0, memory_order_relaxed);
+    atomic_store_explicit(&frame->stamps[FRAME_STAMP_ATTACH], surface->attach_ns, memory_order_relaxed);
+    atomic_store_explicit(&frame->stamps[FRAME_STAMP_COMMIT], now, memory_order_relaxed);
+    atomic_store_explicit(&frame->serial, serial, memory_order_release);
+
+    if (surface->attach_ns && now >= surface->attach_ns) {
+        histogram_record(&surface->stages[FRAME_STAGE_ATTACH_COMMIT], now - surface->attach_ns);
+    }
+    surface->attach_ns = 0;
+}
+
+/*
+ * Both ends are stored before they are read (seq_cst), so of two racing
+ * stamps at least one sees the whole interval; the recorded bit makes sure
+ * only one of them adds it.
+ */
+static void frame_record_stage(struct frame_timing_surface *surface, struct frame_timing_frame *frame,
+                               enum frame_stage stage, enum frame_stamp from, enum frame_stamp to) {
+    uint64_t start = atomic_load(&frame->stamps[from]);
+    uint64_t end = atomic_load(&frame->stamps[to]);
+    if (!start || !end || end < start) return;
+
+    uint32_t bit = 1u << stage;
+    if (atomic_fetch_or_explicit(&frame->recorded, bit, memory_order_relaxed) & bit) return;
+    histogram_record(&surface->stages[stage], end - start);
+}
+
+bool frame_timing_stamp(struct frame_timing_surface *surface, uint32_t serial, enum frame_stamp stamp, uint64_t ns) {
+    if (!surface || serial == 0 || stamp <= FRAME_STAMP_COMMIT || stamp >= FRAME_STAMP_COUNT || ns == 0) {
+        return false;
+    }
+
+    struct frame_timing_frame *frame = NULL;
+    for (int i = 0; i < FRAME_TIMING_IN_FLIGHT; i++) {
+        if (atomic_load_explicit(&surface->frames[i].serial, memory_order_acquire) == serial) {
+            frame = &surface->frames[i];
+            break;
+        }
+    }
+    if (!frame) return false;
+
+    atomic_store(&frame->stamps[stamp], ns);
+
+    /* Stage N ends at stamp N + 1; intervals with a skipped end (no upload stamp) never complete */
+    frame_record_stage(surface, frame, (enum frame_stage)(stamp - 1), stamp - 1, stamp);
+    if (stamp + 1 < FRAME_STAMP_COUNT) {
+        frame_record_stage(surface, frame, (enum frame_stage)stamp, stamp, stamp + 1);
+    }
+    if (stamp == FRAME_STAMP_PRESENT) {
+        frame_record_stage(surface, frame, FRAME_STAGE_TOTAL, FRAME_STAMP_COMMIT, FRAME_STAMP_PRESENT);
+    }
+    return true;
+}
+
+bool frame_timing_stamp_surface(struct frame_timing *timing, uint32_t surface_id, uint32_t serial,
+                                enum frame_stamp stamp, uint64_t ns) {
+    return frame_timing_stamp(find_surface(timing, surface_id), serial, stamp, ns);
+}
+
+bool frame_timing_summary(struct frame_timing *timing, uint32_t surface_id, enum frame_stage stage,
+                          struct frame_timing_summary *summary) {
+    struct frame_timing_surface *surface = find_surface(timing, surface_id);
+    if (!surface || stage >= FRAME_STAGE_COUNT || !summary) return false;
+
+    histogram_summary(&surface->stages[stage], summary);
+    return true;
+}
+
+uint32_t frame_timing_surfaces(struct frame_timing *timing, uint32_t *ids, uint32_t max) {
+    uint32_t count = 0;
+    if (!timing) return 0;
+
+    for (int i = 0; i < FRAME_TIMING_MAX_SURFACES && count < max; i++) {
+        uint32_t surface_id = atomic_load_explicit(&timing->surfaces[i].surface_id, memory_order_relaxed);
+        if (surface_id) ids[count++] = surface_id;
+    }
+    return count;
+}
+
+bool frame_timing_reset(struct frame_timing *timing, uint32_t surface_id) {
+    if (!timing) return false;
+
+    if (surface_id != 0) {
+        struct frame_timing_surface *surface = find_surface(timing, surface_id);
+        if (!surface) return false;
+        surface_reset(surface);
+        return true;
+    }
+
+    for (int i = 0; i < FRAME_TIMING_MAX_SURFACES; i++) {
+        surface_reset(&timing->surfaces[i]);
+    }
+    return true;
+}
+
+const char *frame_timing_stage_name(enum frame_stage stage) {
+    return stage < FRAME_STAGE_COUNT ? stage_names[stage] : "unknown";
+}
+
+int frame_timing_stage_from_name(const char *name) {
+    for (int i = 0; i < FRAME_STAGE_COUNT; i++) {
+        if (strcmp(name, stage_names[i]) == 0) return i;
+    }
+    return -1;
+}
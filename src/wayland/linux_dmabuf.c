@@ -0,0 +1,802 @@
+#define _GNU_SOURCE
+#include <wayland/linux_dmabuf.h>
+#include <wayland/server.h>
+#include <wayland/buffer.h>
+#include <wayland/buffer_tracker.h>
+#include <logger.h>
+
+#include <drm/drm_fourcc.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_LINUX_DMABUF
+#include "linux-dmabuf-unstable-v1-protocol.h"
+
+/* Consumers mmap plane 0 and upload it, so only linear RGB layouts for now */
+static const struct {
+    uint32_t format;
+    uint32_t num_planes;
+} supported_formats[] = {
+    { DRM_FORMAT_ARGB8888, 1 },
+    { DRM_FORMAT_XRGB8888, 1 },
+};
+
+/* MOD_INVALID: implicit modifier, what udmabuf/memfd exporters and pre-v3 clients use */
+static const uint64_t supported_modifiers[] = {
+    DRM_FORMAT_MOD_LINEAR,
+    DRM_FORMAT_MOD_INVALID,
+};
+
+#define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+
+struct linux_dmabuf_params {
+    struct wl_resource *resource;
+    struct linux_dmabuf *dmabuf;
+    struct dmabuf_attributes attribs;
+    bool has_modifier;
+    bool used;
+};
+
+/* Format table entry layout mandated by the protocol */
+struct format_table_entry {
+    uint32_t format;
+    uint32_t pad;
+    uint64_t modifier;
+};
+
+/* Renderer tranches for one surface, dropped with the surface */
+struct surface_feedback_override {
+    struct wl_list link;
+    struct surface *surface;
+    struct wl_listener surface_destroy;
+    struct linux_dmabuf_feedback feedback;
+};
+
+/* zwp_linux_dmabuf_feedback_v1 from get_surface_feedback */
+struct surface_feedback {
+    struct wl_list link;
+    struct wl_resource *resource;
+    struct surface *surface;            /* NULL once the surface is gone */
+    struct wl_listener surface_destroy;
+};
+
+static int format_num_planes(uint32_t format) {
+    for (size_t i = 0; i < ARRAY_LENGTH(supported_formats); i++) {
+        if (supported_formats[i].format == format) {
+            return supported_formats[i].num_planes;
+        }
+    }
+    return -1;
+}
+
+bool linux_dmabuf_format_supported(uint32_t format, uint64_t modifier) {
+    if (format_num_planes(format) < 0) return false;
+
+    for (size_t i = 0; i < ARRAY_LENGTH(supported_modifiers); i++) {
+        if (supported_modifiers[i] == modifier) return true;
+    }
+    return false;
+}
+
+static void dmabuf_attributes_finish(struct dmabuf_attributes *attribs) {
+    for (int i = 0; i < BUFFER_DMABUF_MAX_PLANES; i++) {
+        if (attribs->fd[i] >= 0) {
+            close(attribs->fd[i]);
+            attribs->fd[i] = -1;
+        }
+    }
+    attribs->num_planes = 0;
+}
+
+/* wl_buffer backed by dmabufs */
+
+static void dmabuf_buffer_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct wl_buffer_interface dmabuf_buffer_implementation = {
+    .destroy = dmabuf_buffer_handle_destroy,
+};
+
+static void dmabuf_buffer_destructor(struct wl_resource *resource) {
+    struct buffer *buffer = wl_resource_get_user_data(resource);
+    if (!buffer) return;
+
+    SERVER_DEBUG("DMA-BUF buffer destroyed: %dx%d", buffer->width, buffer->height);
+    buffer_tracker_forget(buffer);
+    buffer_publish_destroyed(buffer->server, buffer);
+    dmabuf_attributes_finish(&buffer->dmabuf);
+    free(buffer);
+}
+
+/* zwp_linux_buffer_params_v1 */
+
+static void params_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void params_add(struct wl_client *client, struct wl_resource *resource, int32_t fd,
+                       uint32_t plane_idx, uint32_t offset, uint32_t stride,
+                       uint32_t modifier_hi, uint32_t modifier_lo) {
+    struct linux_dmabuf_params *params = wl_resource_get_user_data(resource);
+
+    if (params->used) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED,
+                               "params was already used to create a wl_buffer");
+        close(fd);
+        return;
+    }
+
+    if (plane_idx >= BUFFER_DMABUF_MAX_PLANES) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_IDX,
+                               "plane index %u is too high", plane_idx);
+        close(fd);
+        return;
+    }
+
+    if (params->attribs.fd[plane_idx] >= 0) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_PLANE_SET,
+                               "a dmabuf has already been added for plane %u", plane_idx);
+        close(fd);
+        return;
+    }
+
+    uint64_t modifier = ((uint64_t)modifier_hi << 32) | modifier_lo;
+    if (params->has_modifier && params->attribs.modifier != modifier) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_FORMAT,
+                               "sent modifier 0x%llx for plane %u, expected 0x%llx to match other planes",
+                               (unsigned long long)modifier, plane_idx,
+                               (unsigned long long)params->attribs.modifier);
+        close(fd);
+        return;
+    }
+
+    params->attribs.modifier = modifier;
+    params->has_modifier = true;
+    params->attribs.fd[plane_idx] = fd;
+    params->attribs.offset[plane_idx] = offset;
+    params->attribs.stride[plane_idx] = stride;
+}
+
+/* Protocol checks, posts the error and returns false on violation */
+static bool params_validate(struct wl_resource *resource, struct dmabuf_attributes *attribs) {
+    uint32_t num_planes = 0;
+    for (int i = 0; i < BUFFER_DMABUF_MAX_PLANES; i++) {
+        if (attribs->fd[i] >= 0) num_planes = i + 1;
+    }
+
+    if (num_planes == 0) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE,
+                               "no dmabuf has been added to the params");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_planes; i++) {
+        if (attribs->fd[i] < 0) {
+            wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE,
+                                   "no dmabuf has been added for plane %u", i);
+            return false;
+        }
+    }
+
+    int expected_planes = format_num_planes(attribs->format);
+    if (expected_planes > 0 && (uint32_t)expected_planes != num_planes) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INCOMPLETE,
+                               "format 0x%08x needs %d plane(s), got %u", attribs->format,
+                               expected_planes, num_planes);
+        return false;
+    }
+    attribs->num_planes = num_planes;
+
+    if (attribs->width <= 0 || attribs->height <= 0) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_DIMENSIONS,
+                               "invalid width %d or height %d", attribs->width, attribs->height);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_planes; i++) {
+        uint64_t offset = attribs->offset[i];
+        uint64_t stride = attribs->stride[i];
+        /* Only plane 0 is known to span the full height */
+        uint64_t end = i == 0 ? offset + stride * (uint64_t)attribs->height : offset + stride;
+
+        if (end > UINT32_MAX) {
+            wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS,
+                                   "size overflow for plane %u", i);
+            return false;
+        }
+
+        /* Not every exporter supports seeking, skip the size check then */
+        off_t size = lseek(attribs->fd[i], 0, SEEK_END);
+        if (size == -1) continue;
+
+        if (offset >= (uint64_t)size || end > (uint64_t)size) {
+            wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_OUT_OF_BOUNDS,
+                                   "plane %u (offset %u, stride %u) exceeds dmabuf size %lld",
+                                   i, attribs->offset[i], attribs->stride[i], (long long)size);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* buffer_id == 0: params.create (created/failed events), otherwise params.create_immed */
+static void params_create_common(struct wl_client *client, struct wl_resource *resource, uint32_t buffer_id,
+                                 int32_t width, int32_t height, uint32_t format, uint32_t flags) {
+    struct linux_dmabuf_params *params = wl_resource_get_user_data(resource);
+
+    if (params->used) {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_ALREADY_USED,
+                               "params was already used to create a wl_buffer");
+        return;
+    }
+    params->used = true;
+
+    struct dmabuf_attributes *attribs = &params->attribs;
+    attribs->width = width;
+    attribs->height = height;
+    attribs->format = format;
+    attribs->flags = flags;
+
+    if (!params_validate(resource, attribs)) return;
+
+    /* Valid request we cannot import: not a protocol error */
+    if (!linux_dmabuf_format_supported(format, attribs->modifier)) {
+        SERVER_DEBUG("DMA-BUF: unsupported format 0x%08x / modifier 0x%llx",
+                     format, (unsigned long long)attribs->modifier);
+        goto failed;
+    }
+
+    if (flags & ~ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT) {
+        SERVER_DEBUG("DMA-BUF: unsupported flags 0x%x", flags);
+        goto failed;
+    }
+
+    struct wl_resource *buffer_resource = wl_resource_create(client, &wl_buffer_interface, 1, buffer_id);
+    if (!buffer_resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    struct buffer *buffer = buffer_create_dmabuf(buffer_resource, attribs);
+    if (!buffer) {
+        wl_resource_destroy(buffer_resource);
+        goto failed;
+    }
+
+    buffer->server = params->dmabuf->server;
+
+    /* Ownership of the fds moved to the buffer */
+    for (int i = 0; i < BUFFER_DMABUF_MAX_PLANES; i++) {
+        attribs->fd[i] = -1;
+    }
+    attribs->num_planes = 0;
+
+    wl_resource_set_implementation(buffer_resource, &dmabuf_buffer_implementation, buffer, dmabuf_buffer_destructor);
+
+    if (buffer_id == 0) {
+        zwp_linux_buffer_params_v1_send_created(resource, buffer_resource);
+    }
+    return;
+
+failed:
+    if (buffer_id == 0) {
+        zwp_linux_buffer_params_v1_send_failed(resource);
+    } else {
+        wl_resource_post_error(resource, ZWP_LINUX_BUFFER_PARAMS_V1_ERROR_INVALID_WL_BUFFER,
+                               "importing the supplied dmabufs failed");
+    }
+}
+
+static void params_create(struct wl_client *client, struct wl_resource *resource,
+                          int32_t width, int32_t height, uint32_t format, uint32_t flags) {
+    params_create_common(client, resource, 0, width, height, format, flags);
+}
+
+static void params_create_immed(struct wl_client *client, struct wl_resource *resource, uint32_t buffer_id,
+                                int32_t width, int32_t height, uint32_t format, uint32_t flags) {
+    params_create_common(client, resource, buffer_id, width, height, format, flags);
+}
+
+static const struct zwp_linux_buffer_params_v1_interface params_implementation = {
+    .destroy = params_destroy,
+    .add = params_add,
+    .create = params_create,
+    .create_immed = params_create_immed,
+};
+
+static void params_resource_destroy(struct wl_resource *resource) {
+    struct linux_dmabuf_params *params = wl_resource_get_user_data(resource);
+    if (!params) return;
+
+    dmabuf_attributes_finish(&params->attribs);
+    free(params);
+}
+
+/* zwp_linux_dmabuf_feedback_v1 */
+
+static void feedback_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static const struct zwp_linux_dmabuf_feedback_v1_interface feedback_implementation = {
+    .destroy = feedback_handle_destroy,
+};
+
+static void send_device(struct wl_resource *resource, dev_t device,
+                        void (*send)(struct wl_resource *, struct wl_array *)) {
+    struct wl_array array;
+    wl_array_init(&array);
+
+    dev_t *dev = wl_array_add(&array, sizeof(*dev));
+    if (dev) {
+        *dev = device;
+        send(resource, &array);
+    }
+
+    wl_array_release(&array);
+}
+
+/* The table fd only goes out once per object, it never changes */
+static void feedback_send(struct linux_dmabuf *dmabuf, struct wl_resource *resource,
+                          const struct linux_dmabuf_feedback *feedback, bool send_table) {
+    if (send_table) {
+        zwp_linux_dmabuf_feedback_v1_send_format_table(resource, dmabuf->table_fd, dmabuf->table_size);
+    }
+    send_device(resource, dmabuf->main_device, zwp_linux_dmabuf_feedback_v1_send_main_device);
+
+    for (uint32_t i = 0; i < feedback->n_tranches; i++) {
+        const struct linux_dmabuf_tranche *tranche = &feedback->tranches[i];
+
+        send_device(resource, tranche->target_device, zwp_linux_dmabuf_feedback_v1_send_tranche_target_device);
+
+        struct wl_array indices;
+        wl_array_init(&indices);
+        uint16_t *data = wl_array_add(&indices, tranche->n_indices * sizeof(uint16_t));
+        if (data) {
+            memcpy(data, tranche->indices, tranche->n_indices * sizeof(uint16_t));
+            zwp_linux_dmabuf_feedback_v1_send_tranche_formats(resource, &indices);
+        }
+        wl_array_release(&indices);
+
+        zwp_linux_dmabuf_feedback_v1_send_tranche_flags(resource, tranche->flags);
+        zwp_linux_dmabuf_feedback_v1_send_tranche_done(resource);
+    }
+
+    zwp_linux_dmabuf_feedback_v1_send_done(resource);
+}
+
+static struct surface_feedback_override *find_override(struct linux_dmabuf *dmabuf, struct surface *surface) {
+    struct surface_feedback_override *override;
+    wl_list_for_each(override, &dmabuf->surface_overrides, link) {
+        if (override->surface == surface) return override;
+    }
+    return NULL;
+}
+
+static const struct linux_dmabuf_feedback *surface_get_feedback(struct linux_dmabuf *dmabuf, struct surface *surface) {
+    struct surface_feedback_override *override = surface ? find_override(dmabuf, surface) : NULL;
+    return override ? &override->feedback : &dmabuf->default_feedback;
+}
+
+static struct wl_resource *feedback_resource_create(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct wl_resource *feedback_resource = wl_resource_create(client, &zwp_linux_dmabuf_feedback_v1_interface,
+                                                               wl_resource_get_version(resource), id);
+    if (!feedback_resource) {
+        wl_client_post_no_memory(client);
+    }
+    return feedback_resource;
+}
+
+static void surface_feedback_handle_surface_destroy(struct wl_listener *listener, void *data) {
+    struct surface_feedback *feedback = wl_container_of(listener, feedback, surface_destroy);
+
+    wl_list_remove(&feedback->surface_destroy.link);
+    wl_list_init(&feedback->surface_destroy.link);
+    feedback->surface = NULL;
+}
+
+static void surface_feedback_resource_destroy(struct wl_resource *resource) {
+    struct surface_feedback *feedback = wl_resource_get_user_data(resource);
+    if (!feedback) return;
+
+    wl_list_remove(&feedback->surface_destroy.link);
+    wl_list_remove(&feedback->link);
+    free(feedback);
+}
+
+/* zwp_linux_dmabuf_v1 */
+
+static void linux_dmabuf_handle_destroy(struct wl_client *client, struct wl_resource *resource) {
+    wl_resource_destroy(resource);
+}
+
+static void linux_dmabuf_get_default_feedback(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct linux_dmabuf *dmabuf = wl_resource_get_user_data(resource);
+
+    struct wl_resource *feedback_resource = feedback_resource_create(client, resource, id);
+    if (!feedback_resource) return;
+
+    wl_resource_set_implementation(feedback_resource, &feedback_implementation, NULL, NULL);
+    feedback_send(dmabuf, feedback_resource, &dmabuf->default_feedback, true);
+}
+
+static void linux_dmabuf_get_surface_feedback(struct wl_client *client, struct wl_resource *resource,
+                                              uint32_t id, struct wl_resource *surface_resource) {
+    struct linux_dmabuf *dmabuf = wl_resource_get_user_data(resource);
+    struct surface *surface = wl_resource_get_user_data(surface_resource);
+
+    struct surface_feedback *feedback = calloc(1, sizeof(struct surface_feedback));
+    if (!feedback) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    feedback->resource = feedback_resource_create(client, resource, id);
+    if (!feedback->resource) {
+        free(feedback);
+        return;
+    }
+
+    feedback->surface = surface;
+    feedback->surface_destroy.notify = surface_feedback_handle_surface_destroy;
+    wl_resource_add_destroy_listener(surface_resource, &feedback->surface_destroy);
+    wl_list_insert(&dmabuf->surface_feedbacks, &feedback->link);
+
+    wl_resource_set_implementation(feedback->resource, &feedback_implementation, feedback,
+                                   surface_feedback_resource_destroy);
+    feedback_send(dmabuf, feedback->resource, surface_get_feedback(dmabuf, surface), true);
+}
+
+static void linux_dmabuf_create_params(struct wl_client *client, struct wl_resource *resource, uint32_t id) {
+    struct linux_dmabuf_params *params = calloc(1, sizeof(struct linux_dmabuf_params));
+    if (!params) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    params->dmabuf = wl_resource_get_user_data(resource);
+    for (int i = 0; i < BUFFER_DMABUF_MAX_PLANES; i++) {
+        params->attribs.fd[i] = -1;
+    }
+
+    params->resource = wl_resource_create(client, &zwp_linux_buffer_params_v1_interface,
+                                          wl_resource_get_version(resource), id);
+    if (!params->resource) {
+        free(params);
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(params->resource, &params_implementation, params, params_resource_destroy);
+}
+
+static const struct zwp_linux_dmabuf_v1_interface linux_dmabuf_implementation = {
+    .destroy = linux_dmabuf_handle_destroy,
+    .create_params = linux_dmabuf_create_params,
+    .get_default_feedback = linux_dmabuf_get_default_feedback,
+    .get_surface_feedback = linux_dmabuf_get_surface_feedback,
+};
+
+static void send_supported_formats(struct wl_resource *resource) {
+    uint32_t version = wl_resource_get_version(resource);
+
+    /* v4 clients learn formats from feedback objects only */
+    if (version >= ZWP_LINUX_DMABUF_V1_GET_DEFAULT_FEEDBACK_SINCE_VERSION) return;
+
+    for (size_t i = 0; i < ARRAY_LENGTH(supported_formats); i++) {
+        uint32_t format = supported_formats[i].format;
+
+        if (version < ZWP_LINUX_DMABUF_V1_MODIFIER_SINCE_VERSION) {
+            zwp_linux_dmabuf_v1_send_format(resource, format);
+            continue;
+        }
+
+        for (size_t j = 0; j < ARRAY_LENGTH(supported_modifiers); j++) {
+            uint64_t modifier = supported_modifiers[j];
+            zwp_linux_dmabuf_v1_send_modifier(resource, format, modifier >> 32, modifier & 0xffffffff);
+        }
+    }
+}
+
+static void bind_linux_dmabuf(struct wl_client *client, void *data, uint32_t version, uint32_t id) {
+    struct wl_resource *resource = wl_resource_create(client, &zwp_linux_dmabuf_v1_interface, version, id);
+    if (!resource) {
+        wl_client_post_no_memory(client);
+        return;
+    }
+
+    wl_resource_set_implementation(resource, &linux_dmabuf_implementation, data, NULL);
+    send_supported_formats(resource);
+}
+
+/* Per-surface feedback updates */
+
+static void override_handle_surface_destroy(struct wl_listener *listener, void *data) {
+    struct surface_feedback_override *override = wl_container_of(listener, override, surface_destroy);
+
+    wl_list_remove(&override->surface_destroy.link);
+    wl_list_remove(&override->link);
+    free(override);
+}
+
+static int table_find(struct linux_dmabuf *dmabuf, const struct linux_dmabuf_format_modifier *pair) {
+    for (uint32_t i = 0; i < dmabuf->table_len; i++) {
+        if (dmabuf->table[i].format == pair->format && dmabuf->table[i].modifier == pair->modifier) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Map requested pairs onto table indices, returns false if nothing usable is left */
+static bool feedback_from_request(struct linux_dmabuf *dmabuf, const struct linux_dmabuf_feedback_request *request,
+                                  struct linux_dmabuf_feedback *feedback) {
+    memset(feedback, 0, sizeof(*feedback));
+
+    for (uint32_t i = 0; i < request->n_tranches && i < LINUX_DMABUF_MAX_TRANCHES; i++) {
+        const struct linux_dmabuf_tranche_request *src = &request->tranches[i];
+        struct linux_dmabuf_tranche *tranche = &feedback->tranches[feedback->n_tranches];
+
+        tranche->target_device = dmabuf->main_device;
+        tranche->flags = src->flags;
+
+        for (uint32_t j = 0; j < src->n_formats && j < LINUX_DMABUF_TABLE_MAX; j++) {
+            int index = table_find(dmabuf, &src->formats[j]);
+            if (index < 0) {
+                SERVER_DEBUG("DMA-BUF: feedback pair 0x%08x/0x%llx is not importable, dropped",
+                             src->formats[j].format, (unsigned long long)src->formats[j].modifier);
+                continue;
+            }
+            tranche->indices[tranche->n_indices++] = index;
+        }
+
+        if (tranche->n_indices > 0) feedback->n_tranches++;
+    }
+
+    return feedback->n_tranches > 0;
+}
+
+static struct surface *find_surface(struct linux_dmabuf *dmabuf, uint32_t surface_id) {
+    struct surface *surface;
+    wl_list_for_each(surface, &dmabuf->server->surfaces, link) {
+        if (surface->id == surface_id) return surface;
+    }
+    return NULL;
+}
+
+static void apply_feedback_request(struct linux_dmabuf *dmabuf, const struct linux_dmabuf_feedback_request *request) {
+    struct surface *surface = find_surface(dmabuf, request->surface_id);
+    if (!surface) {
+        SERVER_DEBUG("DMA-BUF: feedback for unknown surface %u", request->surface_id);
+        return;
+    }
+
+    struct surface_feedback_override *override = find_override(dmabuf, surface);
+    struct linux_dmabuf_feedback feedback;
+
+    if (feedback_from_request(dmabuf, request, &feedback)) {
+        if (!override) {
+            override = calloc(1, sizeof(struct surface_feedback_override));
+            if (!override) {
+                SERVER_ERROR("DMA-BUF: failed to allocate surface feedback");
+                return;
+            }
+            override->surface = surface;
+            override->surface_destroy.notify = override_handle_surface_destroy;
+            wl_resource_add_destroy_listener(surface->resource, &override->surface_destroy);
+            wl_list_insert(&dmabuf->surface_overrides, &override->link);
+        }
+        override->feedback = feedback;
+    } else if (override) {
+        override_handle_surface_destroy(&override->surface_destroy, NULL);
+    } else {
+        return;
+    }
+
+    SERVER_DEBUG("DMA-BUF: surface %u feedback updated (%u tranche(s))",
+                 request->surface_id, feedback.n_tranches);
+
+    const struct linux_dmabuf_feedback *current = surface_get_feedback(dmabuf, surface);
+    struct surface_feedback *surface_feedback;
+    wl_list_for_each(surface_feedback, &dmabuf->surface_feedbacks, link) {
+        if (surface_feedback->surface == surface) {
+            feedback_send(dmabuf, surface_feedback->resource, current, false);
+        }
+    }
+}
+
+static int handle_feedback_requests(int fd, uint32_t mask, void *data) {
+    struct linux_dmabuf *dmabuf = data;
+
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+
+    struct wl_list requests;
+    wl_list_init(&requests);
+
+    pthread_mutex_lock(&dmabuf->queue_mutex);
+    wl_list_insert_list(&requests, &dmabuf->queue);
+    wl_list_init(&dmabuf->queue);
+    pthread_mutex_unlock(&dmabuf->queue_mutex);
+
+    struct linux_dmabuf_feedback_request *request, *tmp;
+    wl_list_for_each_reverse_safe(request, tmp, &requests, link) {
+        apply_feedback_request(dmabuf, request);
+        wl_list_remove(&request->link);
+        free(request);
+    }
+
+    return 0;
+}
+
+void linux_dmabuf_request_surface_feedback(struct linux_dmabuf *dmabuf,
+                                           struct linux_dmabuf_feedback_request *request) {
+    if (!dmabuf || !request) {
+        free(request);
+        return;
+    }
+
+    /* Newest at the head, applied oldest first */
+    pthread_mutex_lock(&dmabuf->queue_mutex);
+    wl_list_insert(&dmabuf->queue, &request->link);
+    pthread_mutex_unlock(&dmabuf->queue_mutex);
+
+    uint64_t one = 1;
+    if (write(dmabuf->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        SERVER_ERROR("DMA-BUF: failed to wake Wayland loop: %s", strerror(errno));
+    }
+}
+
+/* Setup */
+
+static bool create_format_table(struct linux_dmabuf *dmabuf) {
+    struct format_table_entry entries[LINUX_DMABUF_TABLE_MAX];
+    uint32_t count = 0;
+
+    for (size_t i = 0; i < ARRAY_LENGTH(supported_formats); i++) {
+        for (size_t j = 0; j < ARRAY_LENGTH(supported_modifiers) && count < LINUX_DMABUF_TABLE_MAX; j++) {
+            entries[count] = (struct format_table_entry){
+                .format = supported_formats[i].format,
+                .modifier = supported_modifiers[j],
+            };
+            dmabuf->table[count].format = entries[count].format;
+            dmabuf->table[count].modifier = entries[count].modifier;
+            count++;
+        }
+    }
+
+    dmabuf->table_len = count;
+    dmabuf->table_size = count * sizeof(struct format_table_entry);
+
+    dmabuf->table_fd = memfd_create("linux-dmabuf-feedback-table", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (dmabuf->table_fd < 0) {
+        SERVER_ERROR("DMA-BUF: memfd_create failed: %s", strerror(errno));
+        return false;
+    }
+
+    const uint8_t *data = (const uint8_t *)entries;
+    size_t written = 0;
+    while (written < dmabuf->table_size) {
+        ssize_t ret = write(dmabuf->table_fd, data + written, dmabuf->table_size - written);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            SERVER_ERROR("DMA-BUF: failed to write format table: %s", strerror(errno));
+            return false;
+        }
+        written += ret;
+    }
+
+    /* Clients mmap the same file, nobody may change it from now on */
+    if (fcntl(dmabuf->table_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        SERVER_ERROR("DMA-BUF: failed to seal format table: %s", strerror(errno));
+        return false;
+    }
+
+    /* Default feedback: a single tranche with the whole table */
+    struct linux_dmabuf_tranche *tranche = &dmabuf->default_feedback.tranches[0];
+    tranche->target_device = dmabuf->main_device;
+    tranche->flags = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        tranche->indices[i] = i;
+    }
+    tranche->n_indices = count;
+    dmabuf->default_feedback.n_tranches = 1;
+
+    return true;
+}
+
+struct linux_dmabuf *linux_dmabuf_create(struct server *server) {
+    struct linux_dmabuf *dmabuf = calloc(1, sizeof(struct linux_dmabuf));
+    if (!dmabuf) {
+        SERVER_ERROR("Failed to allocate linux-dmabuf state");
+        return NULL;
+    }
+
+    dmabuf->server = server;
+    dmabuf->table_fd = -1;
+    dmabuf->event_fd = -1;
+    wl_list_init(&dmabuf->surface_overrides);
+    wl_list_init(&dmabuf->surface_feedbacks);
+    wl_list_init(&dmabuf->queue);
+
+    if (pthread_mutex_init(&dmabuf->queue_mutex, NULL) != 0) {
+        SERVER_ERROR("Failed to initialize linux-dmabuf mutex");
+        free(dmabuf);
+        return NULL;
+    }
+
+    /* No GPU is fine: dev_t 0, buffers are imported through CPU mappings anyway */
+    struct stat st;
+    if (stat(LINUX_DMABUF_RENDER_NODE, &st) == 0) {
+        dmabuf->main_device = st.st_rdev;
+    }
+
+    if (!create_format_table(dmabuf)) {
+        goto err;
+    }
+
+    dmabuf->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (dmabuf->event_fd < 0) {
+        SERVER_ERROR("Failed to create linux-dmabuf eventfd: %s", strerror(errno));
+        goto err;
+    }
+
+    struct wl_event_loop *loop = wl_display_get_event_loop(server->display);
+    dmabuf->event_source = wl_event_loop_add_fd(loop, dmabuf->event_fd, WL_EVENT_READABLE,
+                                                handle_feedback_requests, dmabuf);
+    if (!dmabuf->event_source) {
+        SERVER_ERROR("Failed to add linux-dmabuf to event loop");
+        goto err;
+    }
+
+    dmabuf->global = wl_global_create(server->display, &zwp_linux_dmabuf_v1_interface,
+                                      LINUX_DMABUF_VERSION, dmabuf, bind_linux_dmabuf);
+    if (!dmabuf->global) {
+        SERVER_ERROR("Failed to create linux-dmabuf global");
+        goto err;
+    }
+
+    SERVER_INFO("DMA-BUF: %u format/modifier pair(s) advertised", dmabuf->table_len);
+    return dmabuf;
+
+err:
+    linux_dmabuf_destroy(dmabuf);
+    return NULL;
+}
+
+void linux_dmabuf_destroy(struct linux_dmabuf *dmabuf) {
+    if (!dmabuf) return;
+
+    if (dmabuf->global) wl_global_destroy(dmabuf->global);
+
+    struct surface_feedback_override *override, *override_tmp;
+    wl_list_for_each_safe(override, override_tmp, &dmabuf->surface_overrides, link) {
+        override_handle_surface_destroy(&override->surface_destroy, NULL);
+    }
+
+    struct linux_dmabuf_feedback_request *request, *request_tmp;
+    wl_list_for_each_safe(request, request_tmp, &dmabuf->queue, link) {
+        wl_list_remove(&request->link);
+        free(request);
+    }
+
+    if (dmabuf->event_source) wl_event_source_remove(dmabuf->event_source);
+    if (dmabuf->event_fd >= 0) close(dmabuf->event_fd);
+    if (dmabuf->table_fd >= 0) close(dmabuf->table_fd);
+
+    pthread_mutex_destroy(&dmabuf->queue_mutex);
+    free(dmabuf);
+}
+
+#endif
@@ -0,0 +1,208 @@
+#include <wayland/region.h>
+#include <wayland-server.h>
+#include <string.h>
+
+static int32_t clamp_coord(int64_t value) {
+    if (value < INT32_MIN) return INT32_MIN;
+    if (value > INT32_MAX) return INT32_MAX;
+    return (int32_t)value;
+}
+
+static bool box_is_empty(const struct region_box *box) {
+    return box->x1 >= box->x2 || box->y1 >= box->y2;
+}
+
+static bool box_contains(const struct region_box *outer, const struct region_box *inner) {
+    return outer->x1 <= inner->x1 && outer->y1 <= inner->y1 &&
+           outer->x2 >= inner->x2 && outer->y2 >= inner->y2;
+}
+
+/* Two boxes whose union is itself a box (same span on one axis, touching on the other) */
+static bool box_try_merge(struct region_box *dst, const struct region_box *src) {
+    if (dst->x1 == src->x1 && dst->x2 == src->x2 &&
+        src->y1 <= dst->y2 && src->y2 >= dst->y1) {
+        if (src->y1 < dst->y1) dst->y1 = src->y1;
+        if (src->y2 > dst->y2) dst->y2 = src->y2;
+        return true;
+    }
+
+    if (dst->y1 == src->y1 && dst->y2 == src->y2 &&
+        src->x1 <= dst->x2 && src->x2 >= dst->x1) {
+        if (src->x1 < dst->x1) dst->x1 = src->x1;
+        if (src->x2 > dst->x2) dst->x2 = src->x2;
+        return true;
+    }
+
+    return false;
+}
+
+static void box_extend(struct region_box *dst, const struct region_box *src) {
+    if (src->x1 < dst->x1) dst->x1 = src->x1;
+    if (src->y1 < dst->y1) dst->y1 = src->y1;
+    if (src->x2 > dst->x2) dst->x2 = src->x2;
+    if (src->y2 > dst->y2) dst->y2 = src->y2;
+}
+
+static void region_update_extents(struct region *region) {
+    if (region->n_boxes == 0) {
+        memset(&region->extents, 0, sizeof(region->extents));
+        return;
+    }
+
+    region->extents = region->boxes[0];
+    for (uint32_t i = 1; i < region->n_boxes; i++) {
+        box_extend(&region->extents, &region->boxes[i]);
+    }
+}
+
+static void region_remove_box(struct region *region, uint32_t index) {
+    region->boxes[index] = region->boxes[--region->n_boxes];
+}
+
+static void region_add_box(struct region *region, struct region_box box) {
+    if (box_is_empty(&box)) return;
+
+    /* Fold the new box into existing ones until nothing changes */
+    uint32_t i = 0;
+    while (i < region->n_boxes) {
+        struct region_box *cur = &region->boxes[i];
+
+        if (box_contains(cur, &box)) return;
+
+        if (box_contains(&box, cur) || box_try_merge(&box, cur)) {
+            region_remove_box(region, i);
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    if (region->n_boxes == REGION_MAX_BOXES) {
+        /* Too fragmented, fall back to a single bounding box */
+        region_update_extents(region);
+        box_extend(&region->extents, &box);
+        region->boxes[0] = region->extents;
+        region->n_boxes = 1;
+        return;
+    }
+
+    region->boxes[region->n_boxes++] = box;
+    region_update_extents(region);
+}
+
+void region_init(struct region *region) {
+    memset(region, 0, sizeof(*region));
+}
+
+void region_clear(struct region *region) {
+    region->n_boxes = 0;
+    memset(&region->extents, 0, sizeof(region->extents));
+}
+
+bool region_is_empty(const struct region *region) {
+    return region->n_boxes == 0;
+}
+
+void region_add_rect(struct region *region, int32_t x, int32_t y, int32_t width, int32_t height) {
+    if (width <= 0 || height <= 0) return;
+
+    struct region_box box = {
+        .x1 = x,
+        .y1 = y,
+        .x2 = clamp_coord((int64_t)x + width),
+        .y2 = clamp_coord((int64_t)y + height),
+    };
+    region_add_box(region, box);
+}
+
+void region_union(struct region *dst, const struct region *src) {
+    if (dst == src) return;
+
+    for (uint32_t i = 0; i < src->n_boxes; i++) {
+        region_add_box(dst, src->boxes[i]);
+    }
+}
+
+void region_intersect_rect(struct region *region, int32_t x, int32_t y, int32_t width, int32_t height) {
+    struct region_box clip = {
+        .x1 = x,
+        .y1 = y,
+        .x2 = clamp_coord((int64_t)x + width),
+        .y2 = clamp_coord((int64_t)y + height),
+    };
+
+    uint32_t i = 0;
+    while (i < region->n_boxes) {
+        struct region_box *box = &region->boxes[i];
+
+        if (box->x1 < clip.x1) box->x1 = clip.x1;
+        if (box->y1 < clip.y1) box->y1 = clip.y1;
+        if (box->x2 > clip.x2) box->x2 = clip.x2;
+        if (box->y2 > clip.y2) box->y2 = clip.y2;
+
+        if (box_is_empty(box)) {
+            region_remove_box(region, i);
+            continue;
+        }
+        i++;
+    }
+
+    region_update_extents(region);
+}
+
+void region_scale(struct region *region, int32_t scale) {
+    if (scale == 1) return;
+
+    for (uint32_t i = 0; i < region->n_boxes; i++) {
+        struct region_box *box = &region->boxes[i];
+        box->x1 = clamp_coord((int64_t)box->x1 * scale);
+        box->y1 = clamp_coord((int64_t)box->y1 * scale);
+        box->x2 = clamp_coord((int64_t)box->x2 * scale);
+        box->y2 = clamp_coord((int64_t)box->y2 * scale);
+    }
+
+    region_update_extents(region);
+}
+
+/* Apply an output transform to a region living in a width x height space */
+void region_transform(struct region *dst, const struct region *src, int32_t transform, int32_t width, int32_t height) {
+    struct region result;
+    region_init(&result);
+
+    for (uint32_t i = 0; i < src->n_boxes; i++) {
+        const struct region_box *b = &src->boxes[i];
+        struct region_box t;
+
+        switch (transform) {
+            case WL_OUTPUT_TRANSFORM_90:
+                t = (struct region_box){ height - b->y2, b->x1, height - b->y1, b->x2 };
+                break;
+            case WL_OUTPUT_TRANSFORM_180:
+                t = (struct region_box){ width - b->x2, height - b->y2, width - b->x1, height - b->y1 };
+                break;
+            case WL_OUTPUT_TRANSFORM_270:
+                t = (struct region_box){ b->y1, width - b->x2, b->y2, width - b->x1 };
+                break;
+            case WL_OUTPUT_TRANSFORM_FLIPPED:
+                t = (struct region_box){ width - b->x2, b->y1, width - b->x1, b->y2 };
+                break;
+            case WL_OUTPUT_TRANSFORM_FLIPPED_90:
+                t = (struct region_box){ height - b->y2, width - b->x2, height - b->y1, width - b->x1 };
+                break;
+            case WL_OUTPUT_TRANSFORM_FLIPPED_180:
+                t = (struct region_box){ b->x1, height - b->y2, b->x2, height - b->y1 };
+                break;
+            case WL_OUTPUT_TRANSFORM_FLIPPED_270:
+                t = (struct region_box){ b->y1, b->x1, b->y2, b->x2 };
+                break;
+            case WL_OUTPUT_TRANSFORM_NORMAL:
+            default:
+                t = *b;
+                break;
+        }
+
+        region_add_box(&result, t);
+    }
+
+    *dst = result;
+}
@@ -9,6 +9,11 @@
 #include <wayland/server.h>
 #include <wayland/compositor.h>
 #include <wayland/shm.h>
+#include <wayland/linux_dmabuf.h>
+#include <wayland/frame_scheduler.h>
+#include <wayland/buffer_tracker.h>
+#include <wayland/buffer_ring.h>
+#include <wayland/frame_timing.h>
 #include <xdg-shell/wm_base.h>
 
 void server_init(struct server *server) {
@@ -43,6 +48,34 @@ void server_init(struct server *server) {
     if (!server->xdg_wm_base_global || !server->shm_global || !server->compositor_global) {
         SERVER_FATAL("Failed to create Wayland globals");
     }
+
+
+    server->frame_scheduler = frame_scheduler_create(server);
+    if (!server->frame_scheduler) {
+        SERVER_FATAL("Failed to create frame scheduler");
+    }
+
+    server->buffer_tracker = buffer_tracker_create(server);
+    if (!server->buffer_tracker) {
+        SERVER_FATAL("Failed to create buffer tracker");
+    }
+
+    server->buffer_ring = buffer_ring_create();
+    if (!server->buffer_ring) {
+        SERVER_FATAL("Failed to create buffer ring");
+    }
+
+    server->frame_timing = frame_timing_create(server);
+    if (!server->frame_timing) {
+        SERVER_FATAL("Failed to create frame timing");
+    }
+
+#ifdef HAVE_LINUX_DMABUF
+    server->linux_dmabuf = linux_dmabuf_create(server);
+    if (!server->linux_dmabuf) {
+        SERVER_FATAL("Failed to create linux-dmabuf global");
+    }
+#endif
 }
 
 void server_run(struct server *server) {
@@ -53,6 +86,23 @@ void server_run(struct server *server) {
 void server_cleanup(struct server *server) {
     wl_display_destroy_clients(server->display);
 
+    frame_scheduler_destroy(server->frame_scheduler);
+    server->frame_scheduler = NULL;
+
+    buffer_tracker_destroy(server->buffer_tracker);
+    server->buffer_tracker = NULL;
+
+    buffer_ring_destroy(server->buffer_ring);
+    server->buffer_ring = NULL;
+
+    frame_timing_destroy(server->frame_timing);
+    server->frame_timing = NULL;
+
+#ifdef HAVE_LINUX_DMABUF
+    linux_dmabuf_destroy(server->linux_dmabuf);
+    server->linux_dmabuf = NULL;
+#endif
+
     if (server->display) {
         wl_display_destroy(server->display);
         server->display = NULL;
@@ -1,12 +1,69 @@
+#define _GNU_SOURCE
 #include <wayland/server.h>
 #include <logger.h>
 #include <wayland/shm.h>
 #include <wayland/buffer.h>
+#include <wayland/buffer_tracker.h>
 
 #include <sys/mman.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+
+/* Pool being read by this thread, consulted by the SIGBUS handler */
+static _Thread_local struct shm_pool *current_access_pool;
+static _Thread_local int current_access_depth;
+
+static pthread_once_t sigbus_once = PTHREAD_ONCE_INIT;
+static bool sigbus_installed;
+static struct sigaction previous_sigbus_action;
+
+static void reraise_sigbus(void) {
+    /* Not ours: restore the previous disposition and let the fault repeat */
+    sigaction(SIGBUS, &previous_sigbus_action, NULL);
+    raise(SIGBUS);
+}
+
+static void sigbus_handler(int signum, siginfo_t *info, void *context) {
+    struct shm_pool *pool = current_access_pool;
+
+    if (!pool || !info) {
+        reraise_sigbus();
+        return;
+    }
+
+    uint8_t *addr = info->si_addr;
+    uint8_t *start = pool->data;
+    if (addr < start || addr >= start + pool->size) {
+        reraise_sigbus();
+        return;
+    }
+
+    pool->sigbus_fault = 1;
+
+    /* Zero pages over the whole pool, the interrupted copy resumes on them */
+    if (mmap(pool->data, pool->size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS, -1, 0) == MAP_FAILED) {
+        reraise_sigbus();
+    }
+}
+
+static void install_sigbus_handler(void) {
+    struct sigaction action = {0};
+    action.sa_sigaction = sigbus_handler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGBUS, &action, &previous_sigbus_action) < 0) {
+        SERVER_ERROR("Failed to install SIGBUS handler: %s", strerror(errno));
+        return;
+    }
+    sigbus_installed = true;
+}
 
 static bool check_format(uint32_t format) {
     switch (format) {
@@ -53,6 +110,10 @@ static void shm_buffer_destructor(struct wl_resource *resource) {
     
     if (buffer) {
         SERVER_DEBUG("SHM buffer destroyed: %dx%d", buffer->width, buffer->height);
+        buffer_tracker_forget(buffer);
+        buffer_publish_destroyed(buffer->server, buffer);
+        wl_list_remove(&buffer->link);
+        shm_pool_unref(buffer->shm.pool);
         free(buffer);
     }
 }
@@ -99,14 +160,14 @@ static void shm_pool_create_buffer(struct wl_client *client, struct wl_resource
         return;
     }
 
-    int fd = pool->fd;
-    struct buffer *buffer = buffer_create_shm(buffer_resource, id, offset, width, height, stride, format, fd);
+    struct buffer *buffer = buffer_create_shm(buffer_resource, pool, offset, width, height, stride, format);
     if (!buffer) {
         wl_client_post_no_memory(client);
         wl_resource_destroy(buffer_resource);
         return;
     }
 
+    buffer->server = pool->server;
     wl_list_init(&buffer->link);
     wl_list_insert(&pool->buffers, &buffer->link);
 
@@ -118,12 +179,36 @@ static void shm_pool_create_buffer(struct wl_client *client, struct wl_resource
     SERVER_DEBUG("SHM buffer created: %dx%d, stride=%d, format=0x%x, offset=%d=",
                 width, height, stride, format, offset);
 
-    // НЕ отправляем release сразу - это должен делать композитор после рендеринга
-    // wl_buffer_send_release(buffer->resource); // ⛔️ УБЕРИТЕ ЭТУ СТРОКУ
+    // release отправляет buffer_tracker, когда все потребители закончили чтение
 }
 
+/*
+ * Pools can only grow. mremap may move the mapping, buffers only store
+ * offsets into it so they stay valid (see shm_buffer_get_data).
+ */
 static void shm_pool_resize(struct wl_client *client, struct wl_resource *pool_resource, int32_t size) {
-    SERVER_DEBUG("SHM_POOL RESIZE requested from client");
+    struct shm_pool *pool = wl_resource_get_user_data(pool_resource);
+
+    if (size <= 0 || (size_t)size < pool->size) {
+        wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_STRIDE,
+                              "shrinking pool invalid (size: %zu, requested: %d)", pool->size, size);
+        return;
+    }
+
+    if ((size_t)size == pool->size) return;
+
+    void *data = mremap(pool->data, pool->size, size, MREMAP_MAYMOVE);
+    if (data == MAP_FAILED) {
+        wl_resource_post_error(pool_resource, WL_SHM_ERROR_INVALID_FD,
+                              "failed to remap shared memory: %s", strerror(errno));
+        return;
+    }
+
+    SERVER_DEBUG("SHM pool resized: fd=%d, %zu -> %d bytes%s",
+                pool->fd, pool->size, size, data != pool->data ? " (moved)" : "");
+
+    pool->data = data;
+    pool->size = size;
 }
 
 static void shm_pool_destroy(struct wl_client *client, struct wl_resource *pool_resource) {
@@ -136,28 +221,74 @@ static const struct wl_shm_pool_interface shm_pool_implementation = {
     .resize = shm_pool_resize,
 };
 
+struct shm_pool *shm_pool_ref(struct shm_pool *pool) {
+    pool->refcount++;
+    return pool;
+}
+
+void shm_pool_unref(struct shm_pool *pool) {
+    if (!pool || --pool->refcount > 0) return;
+
+    SERVER_DEBUG("Destroying SHM pool: fd=%d, size=%zu", pool->fd, pool->size);
+
+    if (pool->data && pool->data != MAP_FAILED) {
+        munmap(pool->data, pool->size);
+    }
+
+    if (pool->fd >= 0) {
+        close(pool->fd);
+    }
+
+    wl_list_remove(&pool->link);
+    free(pool);
+}
+
+bool shm_pool_begin_access(struct shm_pool *pool) {
+    if (!pool) return false;
+
+    pthread_once(&sigbus_once, install_sigbus_handler);
+    if (!sigbus_installed) return false;
+
+    if (current_access_pool && current_access_pool != pool) {
+        SERVER_ERROR("SHM: nested access to a different pool (fd=%d, active fd=%d)",
+                     pool->fd, current_access_pool->fd);
+        return false;
+    }
+
+    current_access_pool = pool;
+    current_access_depth++;
+    return !pool->sigbus_fault;
+}
+
+bool shm_pool_end_access(struct shm_pool *pool) {
+    if (!pool || current_access_pool != pool) return false;
+
+    if (--current_access_depth == 0) {
+        current_access_pool = NULL;
+    }
+
+    if (!pool->sigbus_fault) return true;
+
+    /* Report once, the zero mapping keeps later reads harmless */
+    if (pool->client && pool->sigbus_fault == 1) {
+        pool->sigbus_fault = 2;
+        SERVER_WARN("SHM: client truncated pool fd=%d under a read", pool->fd);
+        if (pool->resource) {
+            wl_resource_post_error(pool->resource, WL_SHM_ERROR_INVALID_FD,
+                                  "error accessing SHM buffer");
+        } else {
+            wl_client_post_implementation_error(pool->client, "error accessing SHM buffer");
+        }
+    }
+    return false;
+}
+
+/* Buffers created from the pool outlive wl_shm_pool.destroy, they keep their own refs */
 static void shm_pool_destructor(struct wl_resource *pool_resource) {
     struct shm_pool *pool = wl_resource_get_user_data(pool_resource);
     if (pool) {
-        SERVER_DEBUG("Destroying SHM pool: fd=%d, size=%zu", pool->fd, pool->size);
-        
-        struct buffer *buffer, *tmp;
-        wl_list_for_each_safe(buffer, tmp, &pool->buffers, link) {
-            if (buffer->resource) {
-                wl_resource_destroy(buffer->resource);
-            }
-        }
-        
-        if (pool->data && pool->data != MAP_FAILED) {
-            munmap(pool->data, pool->size);
-        }
-        
-        if (pool->fd >= 0) {
-            close(pool->fd);
-        }
-        
-        wl_list_remove(&pool->link);
-        free(pool);
+        pool->resource = NULL;
+        shm_pool_unref(pool);
     }
 }
 
@@ -184,6 +315,9 @@ static void shm_create_pool(struct wl_client *client, struct wl_resource *shm_re
         return;
     }
 
+    pool->refcount = 1;
+    pool->client = client;
+    pool->server = server;
     pool->fd = fd;
     pool->size = size;
     wl_list_init(&pool->buffers);
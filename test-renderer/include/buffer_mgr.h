@@ -11,11 +11,24 @@ typedef enum {
     FORMAT_ARGB8888 = 1,
 } RenderBufferFormat;
 
+#define RENDER_MAX_DAMAGE_RECTS 16
+
+typedef struct RenderDamageRect {
+    int32_t x, y;
+    int32_t width, height;
+} RenderDamageRect_t;
+
 typedef struct Buffer {
-    void *data;
-    size_t size;
+    void *data;      // First pixel (map + offset)
+    size_t size;     // stride * height
     size_t capacity;
 
+    // Whole pool mapping, one pool may hold many buffers. Borrowed from the
+    // per-id buffer cache together with fd, valid until BufferDestroyed
+    void *map;
+    size_t map_size;
+    uint32_t offset;
+
     uint32_t stride;
     uint32_t height;
     uint32_t width;
@@ -24,6 +37,17 @@ typedef struct Buffer {
     int fd;
     bool mmaped;
     bool dirty;
+
+    // Damage accumulated since last upload (0 rects = whole buffer)
+    RenderDamageRect_t damage[RENDER_MAX_DAMAGE_RECTS];
+    uint32_t damage_count;
+
+    // Commit serial of the content, Released back to the server after upload
+    uint32_t serial;
+
+    // Frame timing (Metrics.Report): surface of the update and when it arrived
+    uint32_t surface_id;
+    uint64_t received_ns;
 } RenderBuffer_t;
 
 typedef struct BufferMgr {
@@ -38,4 +62,17 @@ extern struct BufferMgr *g_buffer_mgr;
 
 void create_buffermgr_thread();
 void stop_buffermgr_thread();
-void cleanup_buffermgr();
\ No newline at end of file
+void cleanup_buffermgr();
+
+// Presentation feedback for the server frame scheduler
+void buffermgr_notify_presented();
+
+// Tell the server we are done reading the buffer with this serial
+void buffermgr_release(uint32_t serial);
+
+// CLOCK_MONOTONIC in ns, the clock the server stamps frames with
+uint64_t buffermgr_now_ns();
+
+// Renderer side stamps of a frame for the server latency histograms
+void buffermgr_report_timing(uint32_t surface_id, uint32_t serial,
+                             uint64_t received_ns, uint64_t uploaded_ns, uint64_t presented_ns);
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Wire layout of the server buffer ring, keep in sync with the server's
+// include/wayland/buffer_ring.h (negotiated with Buffer.OpenRing)
+
+#define BUFFER_RING_MAGIC 0x42524544u
+#define BUFFER_RING_VERSION 2
+#define BUFFER_RING_MAX_DAMAGE 16
+#define BUFFER_RING_MAX_FDS 4
+
+enum {
+    BUFFER_RING_RECORD_UPDATE = 1,
+    BUFFER_RING_RECORD_DESTROYED = 2,   // Only buffer_id is set, drop its fd/mapping
+};
+
+enum {
+    BUFFER_RING_TYPE_SHM = 1,
+    BUFFER_RING_TYPE_DMABUF = 2,
+};
+
+typedef struct BufferRingRecord {
+    uint32_t kind;
+    uint32_t surface_id;
+    uint32_t buffer_id;
+    uint32_t serial;
+    uint32_t type;
+    uint32_t format;
+    uint32_t width, height;
+    uint64_t modifier;
+    uint32_t n_planes;
+    uint32_t n_damage;
+    uint32_t offset[BUFFER_RING_MAX_FDS];
+    uint32_t stride[BUFFER_RING_MAX_FDS];
+    int32_t damage[BUFFER_RING_MAX_DAMAGE][4];
+} BufferRingRecord_t;
+
+typedef struct BufferRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t record_size;
+
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+    _Alignas(64) uint8_t records[];
+} BufferRingHeader_t;
+
+typedef struct BufferRingFdMsg {
+    uint32_t buffer_id;
+    uint32_t n_fds;
+} BufferRingFdMsg_t;
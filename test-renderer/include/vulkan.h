@@ -63,6 +63,8 @@ struct vulkan {
     VkImage texture_image;
     VkDeviceMemory texture_image_memory;
     VkImageView texture_image_view;
+    uint32_t texture_width;
+    uint32_t texture_height;
     VkSampler texture_sampler;
     VkDescriptorPool descriptor_pool;
     VkDescriptorSet descriptor_set;
@@ -1,4 +1,5 @@
 #include <buffer_mgr.h>
+#include <buffer_ring.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
@@ -6,128 +7,632 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdarg.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <time.h>
 
 BufferMgr_t *g_buffer_mgr = NULL;
 
-static void update_buffer_from_fd(RenderBuffer_t *buffer, dbus_uint32_t width, dbus_uint32_t height, dbus_uint32_t stride, dbus_uint32_t format, const char *type_str, const char *format_str, int fd) {
-    size_t buffer_size = 0;
+#define BUFFER_CACHE_SIZE 64
+
+// Server buffers by id: fd and mapping live until BufferDestroyed, so frames
+// of a known buffer cost no fd passing, fstat or mmap
+typedef struct CachedBuffer {
+    uint32_t id;
+    int fd;             // -1 = free slot
+    void *map;          // Whole fd, mapped on first use
+    size_t map_size;
+
+    // Layout from BufferRegistered / the last ring record
+    uint32_t width, height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t offset;
+    bool readable;      // Linear and single-planar
+    const char *type_str;
+} CachedBuffer_t;
+
+static CachedBuffer_t g_cache[BUFFER_CACHE_SIZE];
+static uint32_t g_cache_next;
+
+// Shared-memory update ring (Buffer.OpenRing), D-Bus signals are the fallback
+static struct {
+    BufferRingHeader_t *header;
+    size_t map_size;
+    int socket_fd;
+    int event_fd;
+} g_ring = { .socket_fd = -1, .event_fd = -1 };
+
+// Newest serial taken from either transport
+static uint32_t g_last_serial;
+
+// Append damage to the not yet uploaded one, overflow means full upload
+static void buffer_add_damage(RenderBuffer_t *buffer, const RenderDamageRect_t *rects, uint32_t count, bool was_dirty) {
+    if (!was_dirty) {
+        buffer->damage_count = 0;
+    } else if (buffer->damage_count == 0) {
+        return; // Already a full upload pending
+    }
+
+    if (count == 0 || buffer->damage_count + count > RENDER_MAX_DAMAGE_RECTS) {
+        buffer->damage_count = 0;
+        return;
+    }
+
+    memcpy(&buffer->damage[buffer->damage_count], rects, count * sizeof(*rects));
+    buffer->damage_count += count;
+}
+
+static void call_server_method(const char *path, const char *iface, const char *method, int first_arg_type, ...) {
+    if (!g_buffer_mgr || !g_buffer_mgr->conn) return;
+
+    DBusMessage *msg = dbus_message_new_method_call("org.skapty6260.DesktopEngine", path, iface, method);
+    if (!msg) return;
+
+    va_list args;
+    va_start(args, first_arg_type);
+    dbus_message_append_args_valist(msg, first_arg_type, args);
+    va_end(args);
+
+    dbus_message_set_no_reply(msg, TRUE);
+    dbus_connection_send(g_buffer_mgr->conn, msg, NULL);
+    dbus_message_unref(msg);
+}
+
+void buffermgr_release(uint32_t serial) {
+    if (serial == 0) return;
+
+    dbus_uint32_t arg = serial;
+    call_server_method("/org/skapty6260/DesktopEngine/Buffer", "org.skapty6260.DesktopEngine.Buffer",
+                       "Release", DBUS_TYPE_UINT32, &arg, DBUS_TYPE_INVALID);
+}
+
+uint64_t buffermgr_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void buffermgr_report_timing(uint32_t surface_id, uint32_t serial,
+                             uint64_t received_ns, uint64_t uploaded_ns, uint64_t presented_ns) {
+    if (serial == 0 || surface_id == 0) return;
+
+    dbus_uint32_t surface_arg = surface_id;
+    dbus_uint32_t serial_arg = serial;
+    dbus_uint64_t received_arg = received_ns;
+    dbus_uint64_t uploaded_arg = uploaded_ns;
+    dbus_uint64_t presented_arg = presented_ns;
+    call_server_method("/org/skapty6260/DesktopEngine/Metrics", "org.skapty6260.DesktopEngine.Metrics",
+                       "Report", DBUS_TYPE_UINT32, &surface_arg, DBUS_TYPE_UINT32, &serial_arg,
+                       DBUS_TYPE_UINT64, &received_arg, DBUS_TYPE_UINT64, &uploaded_arg,
+                       DBUS_TYPE_UINT64, &presented_arg, DBUS_TYPE_INVALID);
+}
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define DRM_MOD_LINEAR 0ULL
+#define DRM_MOD_INVALID ((1ULL << 56) - 1)
+
+// wl_shm codes (0/1) for SHM, DRM fourcc for DMA-BUF
+static RenderBufferFormat render_format_from_code(uint32_t format) {
+    switch (format) {
+        case 0: return FORMAT_ARGB8888;
+        case 1: return FORMAT_XRGB8888;
+        case FOURCC('A', 'R', '2', '4'): return FORMAT_ARGB8888;
+        case FOURCC('X', 'R', '2', '4'): return FORMAT_XRGB8888;
+        default: return FORMAT_XRGB8888;
+    }
+}
+
+static bool layout_readable(uint64_t modifier, uint32_t planes) {
+    // Tiled layouts cannot be read through a CPU mapping
+    return (modifier == DRM_MOD_LINEAR || modifier == DRM_MOD_INVALID) && planes == 1;
+}
+
+static CachedBuffer_t *cache_find(uint32_t id) {
+    for (uint32_t i = 0; i < BUFFER_CACHE_SIZE; i++) {
+        if (g_cache[i].fd >= 0 && g_cache[i].id == id) return &g_cache[i];
+    }
+    return NULL;
+}
+
+static void cache_entry_clear(CachedBuffer_t *entry) {
+    if (entry->fd < 0) return;
+
+    // Presented buffer points into this mapping, drop the not yet uploaded content
+    RenderBuffer_t *buffer = g_buffer_mgr ? g_buffer_mgr->buffers : NULL;
+    if (buffer && buffer->map && buffer->map == entry->map) {
+        if (buffer->dirty) buffermgr_release(buffer->serial);
+        buffer->dirty = false;
+        buffer->mmaped = false;
+        buffer->map = NULL;
+        buffer->map_size = 0;
+        buffer->data = NULL;
+        buffer->fd = -1;
+    }
+
+    if (entry->map) munmap(entry->map, entry->map_size);
+    close(entry->fd);
+    memset(entry, 0, sizeof(*entry));
+    entry->fd = -1;
+}
+
+// Takes ownership of fd
+static CachedBuffer_t *cache_insert(uint32_t id, int fd) {
+    CachedBuffer_t *entry = cache_find(id);
+
+    for (uint32_t i = 0; !entry && i < BUFFER_CACHE_SIZE; i++) {
+        if (g_cache[i].fd < 0) entry = &g_cache[i];
+    }
+    if (!entry) {
+        // Full: drop the oldest, it gets re-registered if still in use
+        entry = &g_cache[g_cache_next++ % BUFFER_CACHE_SIZE];
+    }
+
+    cache_entry_clear(entry);
+    entry->id = id;
+    entry->fd = fd;
+    return entry;
+}
+
+static void cache_remove(uint32_t id) {
+    CachedBuffer_t *entry = cache_find(id);
+    if (entry) {
+        printf("Buffer %u destroyed\n", id);
+        cache_entry_clear(entry);
+    }
+}
+
+static void cache_init(void) {
+    memset(g_cache, 0, sizeof(g_cache));
+    for (uint32_t i = 0; i < BUFFER_CACHE_SIZE; i++) {
+        g_cache[i].fd = -1;
+    }
+}
+
+static void cache_clear_all(void) {
+    for (uint32_t i = 0; i < BUFFER_CACHE_SIZE; i++) {
+        cache_entry_clear(&g_cache[i]);
+    }
+}
+
+static bool cache_entry_map(CachedBuffer_t *entry) {
+    if (entry->map) return true;
 
     // Get file size
     struct stat st;
-    if (fstat(fd, &st) != 0) {
+    if (fstat(entry->fd, &st) != 0) {
         perror("fstat failed");
-        return;
-    }
-    
-    size_t file_size = st.st_size;
-    if (buffer_size == 0) {
-        buffer_size = file_size;
+        return false;
     }
-    
-    printf("File size: %zu bytes\n", file_size);
 
-    // Mmap shm to memory
-    void *mapped_data = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
-    if (mapped_data == MAP_FAILED) {
+    // Mmap the whole fd once, one pool may hold many buffers
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, entry->fd, 0);
+    if (map == MAP_FAILED) {
         perror("mmap failed");
+        return false;
+    }
+
+    entry->map = map;
+    entry->map_size = st.st_size;
+    printf("Buffer %u mapped at %p, size: %zu\n", entry->id, map, entry->map_size);
+    return true;
+}
+
+// Point the presented buffer at a cached one, serial is released on every failure path
+static void present_cached_buffer(CachedBuffer_t *entry, const RenderDamageRect_t *damage, uint32_t damage_count,
+                                  uint32_t surface_id, uint32_t serial, uint64_t received_ns) {
+    RenderBuffer_t *buffer = g_buffer_mgr->buffers;
+    size_t buffer_size = (size_t)entry->stride * entry->height;
+
+    if (!entry->readable) {
+        printf("Unsupported layout of buffer %u, skipped\n", entry->id);
+        buffermgr_release(serial);
         return;
     }
 
-    printf("SHM mapped at %p, size: %zu\n", mapped_data, file_size);
-    
-    // Cleanup previous data
-    if (buffer->mmaped && buffer->data) {
-        munmap(buffer->data, buffer->size);
-        buffer->mmaped = false;
-        buffer->data = NULL;
-    } else if (buffer->data && !buffer->mmaped) {
-        free(buffer->data);
-        buffer->data = NULL;
+    if (!cache_entry_map(entry)) {
+        buffermgr_release(serial);
+        return;
+    }
+
+    if (buffer_size == 0 || (size_t)entry->offset + buffer_size > entry->map_size) {
+        fprintf(stderr, "Buffer out of fd bounds: offset=%u, size=%zu, file size=%zu\n", entry->offset, buffer_size, entry->map_size);
+        buffermgr_release(serial);
+        return;
     }
 
     // Update buffer struct
-    buffer->data = mapped_data;
-    buffer->size = file_size;
-    buffer->capacity = file_size;
-    buffer->width = width;
-    buffer->height = height;
-    buffer->stride = stride;
-    // buffer->format = NULL;
-    buffer->fd = fd;
+    bool was_dirty = buffer->dirty && buffer->width == entry->width && buffer->height == entry->height;
+    buffer_add_damage(buffer, damage, damage_count, was_dirty);
+
+    // Previous content was never uploaded and never will be, hand it back now
+    if (buffer->dirty) {
+        buffermgr_release(buffer->serial);
+    }
+    buffer->serial = serial;
+    buffer->surface_id = surface_id;
+    buffer->received_ns = received_ns;
+
+    buffer->map = entry->map;
+    buffer->map_size = entry->map_size;
+    buffer->offset = entry->offset;
+    buffer->data = (uint8_t *)entry->map + entry->offset;
+    buffer->size = buffer_size;
+    buffer->capacity = buffer_size;
+    buffer->width = entry->width;
+    buffer->height = entry->height;
+    buffer->stride = entry->stride;
+    buffer->format = render_format_from_code(entry->format);
+    buffer->fd = entry->fd;
     buffer->mmaped = true;
     buffer->dirty = true;
     
-    printf("Buffer updated successfully:\n");
-    printf("  Address: %p\n", buffer->data);
-    printf("  Size: %zu bytes\n", buffer->size);
-    printf("  Dimensions: %ux%u\n", buffer->width, buffer->height);
-    printf("  Stride: %u bytes\n", buffer->stride);
-    printf("  Format: %s\n", format_str);
-    printf("  FD: %d\n", buffer->fd);
-    printf("  Mmaped: %s\n", buffer->mmaped ? "yes" : "no");
-    printf("  Dirty: %s\n", buffer->dirty ? "yes" : "no");
+    printf("Buffer %u (%s) presented: %ux%u, stride %u, offset %u, damage rects: %u%s\n",
+           entry->id, entry->type_str, buffer->width, buffer->height, buffer->stride, buffer->offset,
+           buffer->damage_count, buffer->damage_count ? "" : " (full)");
 }
 
-static DBusHandlerResult message_handler(DBusConnection *connection, DBusMessage *message, void *user_data) {    
-    if (dbus_message_is_signal(message, 
-        "org.skapty6260.DesktopEngine.Buffer", 
-        "Updated")) {
-        
-        DBusError err;
-        dbus_error_init(&err);
-        
-        DBusMessageIter iter;
-        if (!dbus_message_iter_init(message, &iter)) {
-            printf("Failed to get message iterator\n");
-            return DBUS_HANDLER_RESULT_HANDLED;
-        }
-        
-        // Проверяем тип первого аргумента (должна быть структура)
-        if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRUCT) {
-            printf("Expected struct, got type %c\n", dbus_message_iter_get_arg_type(&iter));
-            return DBUS_HANDLER_RESULT_HANDLED;
-        }
-        
-        DBusMessageIter struct_iter;
-        dbus_message_iter_recurse(&iter, &struct_iter);
-        dbus_uint32_t width = 0;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
-            dbus_message_iter_get_basic(&struct_iter, &width);
-            dbus_message_iter_next(&struct_iter);
-        }
-        dbus_uint32_t height = 0;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
-            dbus_message_iter_get_basic(&struct_iter, &height);
-            dbus_message_iter_next(&struct_iter);
-        }
-        dbus_uint32_t stride = 0;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
-            dbus_message_iter_get_basic(&struct_iter, &stride);
-            dbus_message_iter_next(&struct_iter);
+// With a ring, Updated signals keep coming while another subscriber has none:
+// the first copy of a serial wins, late older ones are handed back right away
+static bool update_is_stale(uint32_t serial) {
+    if (g_last_serial == 0 || (int32_t)(serial - g_last_serial) > 0) {
+        g_last_serial = serial;
+        return false;
+    }
+
+    // The server ignores a second Release of the same serial
+    if (serial != g_last_serial) buffermgr_release(serial);
+    return true;
+}
+
+// Read fd announcements until buffer_id shows up (the server sends them before the record)
+static CachedBuffer_t *ring_receive_buffer(uint32_t buffer_id) {
+    for (;;) {
+        BufferRingFdMsg_t msg;
+        struct iovec iov = { .iov_base = &msg, .iov_len = sizeof(msg) };
+        union {
+            char buf[CMSG_SPACE(sizeof(int) * BUFFER_RING_MAX_FDS)];
+            struct cmsghdr align;
+        } control;
+        struct msghdr header = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = sizeof(control.buf),
+        };
+
+        ssize_t len = recvmsg(g_ring.socket_fd, &header, MSG_CMSG_CLOEXEC);
+        if (len < (ssize_t)sizeof(msg)) {
+            perror("ring recvmsg failed");
+            return NULL;
         }
-        dbus_uint32_t format = 0;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
-            dbus_message_iter_get_basic(&struct_iter, &format);
-            dbus_message_iter_next(&struct_iter);
+
+        int fds[BUFFER_RING_MAX_FDS];
+        uint32_t n_fds = 0;
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                n_fds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                if (n_fds > BUFFER_RING_MAX_FDS) n_fds = BUFFER_RING_MAX_FDS;
+                memcpy(fds, CMSG_DATA(cmsg), n_fds * sizeof(int));
+            }
         }
-        const char *type_str = NULL;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_STRING) {
-            dbus_message_iter_get_basic(&struct_iter, &type_str);
-            dbus_message_iter_next(&struct_iter);
+        if (n_fds == 0) continue;
+
+        // Only plane 0 is read, multi-planar buffers are skipped anyway
+        for (uint32_t i = 1; i < n_fds; i++) close(fds[i]);
+        CachedBuffer_t *entry = cache_insert(msg.buffer_id, fds[0]);
+
+        if (msg.buffer_id == buffer_id) return entry;
+    }
+}
+
+static void ring_handle_record(const BufferRingRecord_t *record) {
+    uint64_t received_ns = buffermgr_now_ns();
+
+    if (record->kind == BUFFER_RING_RECORD_DESTROYED) {
+        cache_remove(record->buffer_id);
+        return;
+    }
+    if (record->kind != BUFFER_RING_RECORD_UPDATE || update_is_stale(record->serial)) return;
+
+    CachedBuffer_t *entry = cache_find(record->buffer_id);
+    if (!entry) entry = ring_receive_buffer(record->buffer_id);
+    if (!entry) {
+        buffermgr_release(record->serial);
+        return;
+    }
+
+    entry->width = record->width;
+    entry->height = record->height;
+    entry->stride = record->stride[0];
+    entry->format = record->format;
+    entry->offset = record->offset[0];
+    entry->readable = layout_readable(record->modifier, record->n_planes);
+    entry->type_str = record->type == BUFFER_RING_TYPE_DMABUF ? "DMA-BUF" : "SHM";
+
+    RenderDamageRect_t damage[RENDER_MAX_DAMAGE_RECTS];
+    uint32_t damage_count = record->n_damage <= RENDER_MAX_DAMAGE_RECTS ? record->n_damage : 0;
+    for (uint32_t i = 0; i < damage_count; i++) {
+        damage[i] = (RenderDamageRect_t){ record->damage[i][0], record->damage[i][1],
+                                          record->damage[i][2], record->damage[i][3] };
+    }
+
+    present_cached_buffer(entry, damage, damage_count, record->surface_id, record->serial, received_ns);
+}
+
+static void ring_drain(void) {
+    uint64_t value;
+    if (read(g_ring.event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        perror("ring eventfd read failed");
+    }
+
+    BufferRingHeader_t *header = g_ring.header;
+    uint32_t tail = atomic_load_explicit(&header->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&header->head, memory_order_acquire);
+
+    while (tail != head) {
+        uint32_t slot = tail & (header->capacity - 1);
+        BufferRingRecord_t record;
+        memcpy(&record, header->records + (size_t)slot * header->record_size, sizeof(record));
+
+        // Free the slot before the (possibly slow) mmap/upload bookkeeping
+        atomic_store_explicit(&header->tail, ++tail, memory_order_release);
+        ring_handle_record(&record);
+    }
+}
+
+static void ring_close(void) {
+    if (g_ring.header) munmap(g_ring.header, g_ring.map_size);
+    if (g_ring.socket_fd >= 0) close(g_ring.socket_fd);
+    if (g_ring.event_fd >= 0) close(g_ring.event_fd);
+    g_ring.header = NULL;
+    g_ring.socket_fd = -1;
+    g_ring.event_fd = -1;
+}
+
+// Negotiate the ring, on failure updates keep coming as D-Bus signals
+static bool ring_open(DBusConnection *conn) {
+    DBusMessage *msg = dbus_message_new_method_call("org.skapty6260.DesktopEngine",
+        "/org/skapty6260/DesktopEngine/Buffer", "org.skapty6260.DesktopEngine.Buffer", "OpenRing");
+    if (!msg) return false;
+
+    DBusError err;
+    dbus_error_init(&err);
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block(conn, msg, 1000, &err);
+    dbus_message_unref(msg);
+    if (!reply) {
+        fprintf(stderr, "OpenRing failed: %s\n", err.message ? err.message : "unknown");
+        dbus_error_free(&err);
+        return false;
+    }
+
+    int memfd = -1;
+    bool ok = dbus_message_get_args(reply, &err,
+                                    DBUS_TYPE_UNIX_FD, &memfd,
+                                    DBUS_TYPE_UNIX_FD, &g_ring.socket_fd,
+                                    DBUS_TYPE_UNIX_FD, &g_ring.event_fd,
+                                    DBUS_TYPE_INVALID);
+    dbus_message_unref(reply);
+    if (!ok) {
+        fprintf(stderr, "OpenRing reply: %s\n", err.message);
+        dbus_error_free(&err);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(memfd, &st) != 0 || (size_t)st.st_size < sizeof(BufferRingHeader_t)) {
+        close(memfd);
+        ring_close();
+        return false;
+    }
+
+    g_ring.map_size = st.st_size;
+    void *map = mmap(NULL, g_ring.map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    close(memfd);
+    if (map == MAP_FAILED) {
+        perror("ring mmap failed");
+        ring_close();
+        return false;
+    }
+    g_ring.header = map;
+
+    BufferRingHeader_t *header = g_ring.header;
+    if (header->magic != BUFFER_RING_MAGIC || header->version != BUFFER_RING_VERSION ||
+        header->record_size < sizeof(BufferRingRecord_t) ||
+        sizeof(BufferRingHeader_t) + (size_t)header->capacity * header->record_size > g_ring.map_size) {
+        fprintf(stderr, "Incompatible buffer ring (version %u)\n", header->version);
+        ring_close();
+        return false;
+    }
+
+    printf("Buffer ring opened: %u records\n", header->capacity);
+    return true;
+}
+
+// BufferRegistered: fd and layout of a buffer id, later frames only reference the id
+static void handle_buffer_registered(DBusMessage *message) {
+    DBusMessageIter iter;
+    if (!dbus_message_iter_init(message, &iter)) {
+        printf("Failed to get message iterator\n");
+        return;
+    }
+    
+    // Проверяем тип первого аргумента (должна быть структура)
+    if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRUCT) {
+        printf("Expected struct, got type %c\n", dbus_message_iter_get_arg_type(&iter));
+        return;
+    }
+    
+    DBusMessageIter struct_iter;
+    dbus_message_iter_recurse(&iter, &struct_iter);
+    dbus_uint32_t buffer_id = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &buffer_id);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t width = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &width);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t height = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &height);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t stride = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &stride);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t format = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &format);
+        dbus_message_iter_next(&struct_iter);
+    }
+    const char *type_str = NULL;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_STRING) {
+        dbus_message_iter_get_basic(&struct_iter, &type_str);
+        dbus_message_iter_next(&struct_iter);
+    }
+    const char *format_str = NULL;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_STRING) {
+        dbus_message_iter_get_basic(&struct_iter, &format_str);
+        dbus_message_iter_next(&struct_iter);
+    }
+    int fd = -1;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UNIX_FD) {
+        dbus_message_iter_get_basic(&struct_iter, &fd);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t offset = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &offset);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint64_t modifier = DRM_MOD_LINEAR;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT64) {
+        dbus_message_iter_get_basic(&struct_iter, &modifier);
+        dbus_message_iter_next(&struct_iter);
+    }
+    // Extra planes a(huu), we only read plane 0 of single-planar formats
+    uint32_t extra_planes = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_ARRAY) {
+        DBusMessageIter planes_iter;
+        dbus_message_iter_recurse(&struct_iter, &planes_iter);
+        while (dbus_message_iter_get_arg_type(&planes_iter) == DBUS_TYPE_STRUCT) {
+            DBusMessageIter plane_iter;
+            dbus_message_iter_recurse(&planes_iter, &plane_iter);
+            if (dbus_message_iter_get_arg_type(&plane_iter) == DBUS_TYPE_UNIX_FD) {
+                int plane_fd = -1;
+                dbus_message_iter_get_basic(&plane_iter, &plane_fd);
+                if (plane_fd >= 0) close(plane_fd);
+            }
+            extra_planes++;
+            dbus_message_iter_next(&planes_iter);
         }
-        const char *format_str = NULL;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_STRING) {
-            dbus_message_iter_get_basic(&struct_iter, &format_str);
-            dbus_message_iter_next(&struct_iter);
+        dbus_message_iter_next(&struct_iter);
+    }
+
+    if (fd < 0) {
+        printf("Buffer %u registered without fd\n", buffer_id);
+        return;
+    }
+
+    CachedBuffer_t *entry = cache_insert(buffer_id, fd);
+    entry->width = width;
+    entry->height = height;
+    entry->stride = stride;
+    entry->format = format;
+    entry->offset = offset;
+    entry->readable = layout_readable(modifier, extra_planes + 1);
+    entry->type_str = type_str && strcmp(type_str, "DMA-BUF") == 0 ? "DMA-BUF" : "SHM";
+
+    printf("Buffer %u registered: %ux%u %s (%s), modifier=0x%llx, planes=%u\n", buffer_id, width, height,
+           format_str ? format_str : "?", entry->type_str, (unsigned long long)modifier, extra_planes + 1);
+}
+
+// Updated: new content of a registered buffer
+static void handle_buffer_updated(DBusMessage *message) {
+    uint64_t received_ns = buffermgr_now_ns();
+    DBusMessageIter iter;
+    if (!dbus_message_iter_init(message, &iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRUCT) {
+        printf("Malformed buffer update\n");
+        return;
+    }
+    
+    DBusMessageIter struct_iter;
+    dbus_message_iter_recurse(&iter, &struct_iter);
+    dbus_uint32_t buffer_id = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &buffer_id);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t surface_id = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &surface_id);
+        dbus_message_iter_next(&struct_iter);
+    }
+    dbus_uint32_t serial = 0;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UINT32) {
+        dbus_message_iter_get_basic(&struct_iter, &serial);
+        dbus_message_iter_next(&struct_iter);
+    }
+    // Damage rects a(iiii), empty array means whole buffer
+    RenderDamageRect_t damage[RENDER_MAX_DAMAGE_RECTS];
+    uint32_t damage_count = 0;
+    bool damage_overflow = false;
+    if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_ARRAY) {
+        DBusMessageIter array_iter;
+        dbus_message_iter_recurse(&struct_iter, &array_iter);
+        while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT) {
+            DBusMessageIter rect_iter;
+            dbus_int32_t rect[4] = {0};
+            dbus_message_iter_recurse(&array_iter, &rect_iter);
+            for (int i = 0; i < 4 && dbus_message_iter_get_arg_type(&rect_iter) == DBUS_TYPE_INT32; i++) {
+                dbus_message_iter_get_basic(&rect_iter, &rect[i]);
+                dbus_message_iter_next(&rect_iter);
+            }
+            if (damage_count < RENDER_MAX_DAMAGE_RECTS) {
+                damage[damage_count++] = (RenderDamageRect_t){ rect[0], rect[1], rect[2], rect[3] };
+            } else {
+                damage_overflow = true;
+            }
+            dbus_message_iter_next(&array_iter);
         }
-        int fd = -1;
-        if (dbus_message_iter_get_arg_type(&struct_iter) == DBUS_TYPE_UNIX_FD) {
-            dbus_message_iter_get_basic(&struct_iter, &fd);
-            dbus_message_iter_next(&struct_iter);
+        dbus_message_iter_next(&struct_iter);
+    }
+    if (damage_overflow) damage_count = 0;
+    if (update_is_stale(serial)) return;
+
+    CachedBuffer_t *entry = cache_find(buffer_id);
+    if (!entry) {
+        // Subscribed after it was registered, the server re-registers it on a later commit
+        printf("Update for unknown buffer %u (surface %u), skipped\n", buffer_id, surface_id);
+        buffermgr_release(serial);
+        return;
+    }
+
+    present_cached_buffer(entry, damage, damage_count, surface_id, serial, received_ns);
+}
+
+static DBusHandlerResult message_handler(DBusConnection *connection, DBusMessage *message, void *user_data) {    
+    if (dbus_message_is_signal(message, "org.skapty6260.DesktopEngine.Buffer", "BufferRegistered")) {
+        handle_buffer_registered(message);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (dbus_message_is_signal(message, "org.skapty6260.DesktopEngine.Buffer", "Updated")) {
+        handle_buffer_updated(message);
+        return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+    if (dbus_message_is_signal(message, "org.skapty6260.DesktopEngine.Buffer", "BufferDestroyed")) {
+        dbus_uint32_t buffer_id = 0;
+        if (dbus_message_get_args(message, NULL, DBUS_TYPE_UINT32, &buffer_id, DBUS_TYPE_INVALID)) {
+            cache_remove(buffer_id);
         }
-        
-        update_buffer_from_fd(g_buffer_mgr->buffers, width, height, stride, format, type_str, format_str, fd);
-        
         return DBUS_HANDLER_RESULT_HANDLED;
     }
     
@@ -189,6 +694,10 @@ static void* buffer_fetcher_worker(void* arg) {
     
     printf("Match rule added successfully\n");
 
+    // Subscribe: the server keeps committed buffers until we Release them
+    call_server_method("/org/skapty6260/DesktopEngine/Buffer", "org.skapty6260.DesktopEngine.Buffer",
+                       "Subscribe", DBUS_TYPE_INVALID);
+
     // Список всех правил для проверки (убрана, чтобы не вызывала ошибку)
     // ...
     
@@ -203,27 +712,57 @@ static void* buffer_fetcher_worker(void* arg) {
         return NULL;
     }
 
-    // Main handling loop
+    bool ring = ring_open(conn);
+
+    int dbus_fd = -1;
+    if (!dbus_connection_get_unix_fd(conn, &dbus_fd)) {
+        fprintf(stderr, "Failed to get D-Bus fd\n");
+        return NULL;
+    }
+
+    // Main handling loop: D-Bus socket + ring eventfd
     printf("Entering main loop...\n");
 
-    // TODO: async handling
     while (g_buffer_mgr->running) {
-        dbus_connection_read_write_dispatch(conn, 1000); // 1 секунда таймаут
+        struct pollfd pfds[2] = {
+            { .fd = dbus_fd, .events = POLLIN },
+            { .fd = ring ? g_ring.event_fd : -1, .events = POLLIN },
+        };
+        poll(pfds, 2, 1000); // 1 секунда таймаут, чтобы заметить остановку
+
+        if (ring && (pfds[1].revents & POLLIN)) {
+            ring_drain();
+        }
+
+        dbus_connection_read_write(conn, 0);
+        while (dbus_connection_dispatch(conn) == DBUS_DISPATCH_DATA_REMAINS);
     }
 
+    ring_close();
+
     printf("buffer fetcher worker cleanup\n");
+    call_server_method("/org/skapty6260/DesktopEngine/Buffer", "org.skapty6260.DesktopEngine.Buffer",
+                       "Unsubscribe", DBUS_TYPE_INVALID);
+    dbus_connection_flush(conn);
     dbus_connection_remove_filter(conn, message_handler, NULL);
     dbus_connection_unref(conn);
 
     return NULL;
 }
 
+void buffermgr_notify_presented() {
+    call_server_method("/org/skapty6260/DesktopEngine/Frame", "org.skapty6260.DesktopEngine.Frame",
+                       "Presented", DBUS_TYPE_INVALID);
+}
+
 void create_buffermgr_thread() {
     g_buffer_mgr = calloc(1, sizeof(BufferMgr_t));
     g_buffer_mgr->running = true;
 
     // Initial buffer
     g_buffer_mgr->buffers = calloc(1, sizeof(RenderBuffer_t));
+    g_buffer_mgr->buffers->fd = -1;
+    cache_init();
 
     pthread_create(&g_buffer_mgr->tid, NULL, buffer_fetcher_worker, NULL); //  2 arg is thread attrs (TODO), 4th is arguments for worker function in future
 }
@@ -246,23 +785,9 @@ void cleanup_buffermgr() {
         stop_buffermgr_thread();
     }
     
-    if (g_buffer_mgr->buffers) {
-        RenderBuffer_t *buffer = g_buffer_mgr->buffers;
-        
-        if (buffer->mmaped && buffer->data) {
-            munmap(buffer->data, buffer->size);
-            buffer->mmaped = false;
-        } 
-        else if (buffer->data && !buffer->mmaped) {
-            free(buffer->data);
-        }
-        
-        if (buffer->fd >= 0) {
-            close(buffer->fd);
-        }
-        
-        free(g_buffer_mgr->buffers);
-    }
+    // Unmaps everything, the presented buffer only borrows a cached mapping
+    cache_clear_all();
+    free(g_buffer_mgr->buffers);
     
     free(g_buffer_mgr);
     g_buffer_mgr = NULL;
@@ -6,19 +6,36 @@
 #include <string.h>
 
 void draw_callback(void) {
+    uint32_t surface_id = 0, serial = 0;
+    uint64_t received_ns = 0, uploaded_ns = 0;
+
     if (g_buffer_mgr && g_buffer_mgr->buffers && g_buffer_mgr->buffers->dirty) {
         RenderBuffer_t *buffer = g_buffer_mgr->buffers;
+        surface_id = buffer->surface_id;
+        serial = buffer->serial;
+        received_ns = buffer->received_ns;
         
         printf("New buffer available: %ux%u\n", buffer->width, buffer->height);
         
         // Обновляем текстуру Vulkan
         update_vulkan_texture_from_buffer(g_vulkan, buffer);
+        uploaded_ns = buffermgr_now_ns();
         
         // Сбрасываем флаг
         buffer->dirty = false;
+        buffer->damage_count = 0;
+
+        // Данные скопированы в текстуру, сервер может вернуть буфер клиенту
+        buffermgr_release(serial);
     }
 
     draw_frame(g_vulkan);
+    buffermgr_notify_presented();
+
+    // Задержки кадра для гистограмм сервера (Metrics.Report)
+    if (serial) {
+        buffermgr_report_timing(surface_id, serial, received_ns, uploaded_ns, buffermgr_now_ns());
+    }
 }
 
 // static bool parse_args(int argc, char **argv) {
@@ -128,6 +128,9 @@ void create_texture_image(struct vulkan *vulkan, uint32_t width, uint32_t height
     err = vkCreateImageView(vulkan->device, &viewInfo, NULL, &vulkan->texture_image_view);
     assert(!err);
     
+    vulkan->texture_width = width;
+    vulkan->texture_height = height;
+    
     printf("Texture image created: %ux%u\n", width, height);
 }
 
@@ -215,6 +218,20 @@ void create_descriptor_set(struct vulkan *vulkan) {
     vkUpdateDescriptorSets(vulkan->device, 1, descriptorWrites, 0, NULL);
 }
 
+// Клиппинг damage прямоугольника к размерам буфера
+static bool clip_damage_rect(const RenderBuffer_t *buffer, const RenderDamageRect_t *in, RenderDamageRect_t *out) {
+    int64_t x1 = in->x < 0 ? 0 : in->x;
+    int64_t y1 = in->y < 0 ? 0 : in->y;
+    int64_t x2 = (int64_t)in->x + in->width;
+    int64_t y2 = (int64_t)in->y + in->height;
+    if (x2 > buffer->width) x2 = buffer->width;
+    if (y2 > buffer->height) y2 = buffer->height;
+    if (x1 >= x2 || y1 >= y2) return false;
+
+    *out = (RenderDamageRect_t){ (int32_t)x1, (int32_t)y1, (int32_t)(x2 - x1), (int32_t)(y2 - y1) };
+    return true;
+}
+
 // Обновление текстуры Vulkan из SHM буфера
 void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *buffer) {
     if (!vulkan || !buffer || !buffer->data || buffer->size == 0) {
@@ -222,38 +239,17 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
         return;
     }
     
-    printf("Updating Vulkan texture from buffer: %ux%u, %zu bytes\n", 
-           buffer->width, buffer->height, buffer->size);
-    
     VkResult err;
     
-    // 1. Создаем staging буфер если нужно
-    create_staging_buffer(vulkan, buffer->size);
-    
-    // 2. Копируем данные из SHM в staging буфер
-    void *staging_data;
-    err = vkMapMemory(vulkan->device, vulkan->staging_buffer_memory, 0, buffer->size, 0, &staging_data);
-    assert(!err);
-    
-    memcpy(staging_data, buffer->data, buffer->size);
+    // 1. Создаем текстуру если нужно (или меняем размер), новая текстура требует полной загрузки
+    bool full_upload = buffer->damage_count == 0;
     
-    VkMappedMemoryRange range = {
-        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
-        .memory = vulkan->staging_buffer_memory,
-        .offset = 0,
-        .size = buffer->size,
-    };
-    vkFlushMappedMemoryRanges(vulkan->device, 1, &range);
-    
-    vkUnmapMemory(vulkan->device, vulkan->staging_buffer_memory);
-    
-    // 3. Создаем текстуру если нужно (или меняем размер)
-    if (!vulkan->texture_image || 
-        vulkan->current_buffer == NULL ||
-        vulkan->current_buffer->width != buffer->width ||
-        vulkan->current_buffer->height != buffer->height) {
+    if (!vulkan->texture_image ||
+        vulkan->texture_width != buffer->width ||
+        vulkan->texture_height != buffer->height) {
         
         create_texture_image(vulkan, buffer->width, buffer->height);
+        full_upload = true;
         
         // Обновляем дескрипторы с новой текстурой
         VkDescriptorImageInfo imageInfo = {
@@ -275,7 +271,58 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
         vkUpdateDescriptorSets(vulkan->device, 1, &descriptorWrite, 0, NULL);
     }
     
-    // 4. Создаем командный буфер для копирования
+    // 2. Список прямоугольников для загрузки
+    RenderDamageRect_t rects[RENDER_MAX_DAMAGE_RECTS];
+    uint32_t rect_count = 0;
+    
+    if (full_upload) {
+        rects[rect_count++] = (RenderDamageRect_t){ 0, 0, buffer->width, buffer->height };
+    } else {
+        for (uint32_t i = 0; i < buffer->damage_count; i++) {
+            if (clip_damage_rect(buffer, &buffer->damage[i], &rects[rect_count])) {
+                rect_count++;
+            }
+        }
+    }
+    
+    if (rect_count == 0) {
+        return;
+    }
+    
+    printf("Updating Vulkan texture from buffer: %ux%u, %zu bytes, %u rect(s)%s\n", 
+           buffer->width, buffer->height, buffer->size, rect_count, full_upload ? " (full)" : "");
+    
+    // 3. Создаем staging буфер если нужно
+    create_staging_buffer(vulkan, buffer->size);
+    
+    // 4. Копируем только повреждённые строки из SHM в staging буфер (тот же layout, что и в SHM)
+    void *staging_data;
+    err = vkMapMemory(vulkan->device, vulkan->staging_buffer_memory, 0, buffer->size, 0, &staging_data);
+    assert(!err);
+    
+    if (full_upload) {
+        memcpy(staging_data, buffer->data, buffer->size);
+    } else {
+        for (uint32_t i = 0; i < rect_count; i++) {
+            size_t row_bytes = (size_t)rects[i].width * 4;
+            for (int32_t row = rects[i].y; row < rects[i].y + rects[i].height; row++) {
+                size_t offset = (size_t)row * buffer->stride + (size_t)rects[i].x * 4;
+                memcpy((uint8_t *)staging_data + offset, (const uint8_t *)buffer->data + offset, row_bytes);
+            }
+        }
+    }
+    
+    VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = vulkan->staging_buffer_memory,
+        .offset = 0,
+        .size = buffer->size,
+    };
+    vkFlushMappedMemoryRanges(vulkan->device, 1, &range);
+    
+    vkUnmapMemory(vulkan->device, vulkan->staging_buffer_memory);
+    
+    // 5. Создаем командный буфер для копирования
     VkCommandBufferAllocateInfo allocInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .commandPool = vulkan->command_pool,
@@ -293,12 +340,12 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
     
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
     
-    // 5. Переводим текстуру в layout для записи
+    // 6. Переводим текстуру в layout для записи (при частичной загрузке сохраняем содержимое)
     VkImageMemoryBarrier barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = 0,
+        .srcAccessMask = full_upload ? 0 : VK_ACCESS_SHADER_READ_BIT,
         .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .oldLayout = full_upload ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
@@ -314,7 +361,7 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
     
     vkCmdPipelineBarrier(
         commandBuffer,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        full_upload ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT,
         0,
         0, NULL,
@@ -322,31 +369,34 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
         1, &barrier
     );
     
-    // 6. Копируем из staging буфера в текстуру
-    VkBufferImageCopy region = {
-        .bufferOffset = 0,
-        .bufferRowLength = buffer->stride / 4, // 4 байта на пиксель для XRGB8888
-        .bufferImageHeight = buffer->height,
-        .imageSubresource = {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
-            .baseArrayLayer = 0,
-            .layerCount = 1,
-        },
-        .imageOffset = {0, 0, 0},
-        .imageExtent = {buffer->width, buffer->height, 1},
-    };
+    // 7. Копируем повреждённые области из staging буфера в текстуру
+    VkBufferImageCopy regions[RENDER_MAX_DAMAGE_RECTS];
+    for (uint32_t i = 0; i < rect_count; i++) {
+        regions[i] = (VkBufferImageCopy){
+            .bufferOffset = (VkDeviceSize)rects[i].y * buffer->stride + (VkDeviceSize)rects[i].x * 4,
+            .bufferRowLength = buffer->stride / 4, // 4 байта на пиксель для XRGB8888
+            .bufferImageHeight = 0,
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .imageOffset = {rects[i].x, rects[i].y, 0},
+            .imageExtent = {(uint32_t)rects[i].width, (uint32_t)rects[i].height, 1},
+        };
+    }
     
     vkCmdCopyBufferToImage(
         commandBuffer,
         vulkan->staging_buffer,
         vulkan->texture_image,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
+        rect_count,
+        regions
     );
     
-    // 7. Переводим текстуру в layout для чтения шейдером
+    // 8. Переводим текстуру в layout для чтения шейдером
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
@@ -364,7 +414,7 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
     
     vkEndCommandBuffer(commandBuffer);
     
-    // 8. Отправляем командный буфер
+    // 9. Отправляем командный буфер
     VkSubmitInfo submitInfo = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
         .commandBufferCount = 1,
@@ -376,7 +426,7 @@ void update_vulkan_texture_from_buffer(struct vulkan *vulkan, RenderBuffer_t *bu
     
     vkFreeCommandBuffers(vulkan->device, vulkan->command_pool, 1, &commandBuffer);
     
-    // 9. Сохраняем ссылку на текущий буфер
+    // 10. Сохраняем ссылку на текущий буфер
     vulkan->current_buffer = buffer;
     vulkan->texture_needs_update = false;
     
@@ -0,0 +1,173 @@
+/*
+ * Offline decoder for binary logs (file_format = binary). Prints the same
+ * lines the text file sink would have written; --raw prints CLOCK_MONOTONIC
+ * nanoseconds instead of the local time.
+ *
+ *   desktop_engine_log_decode [--raw] application.log
+ */
+#include <logger_format.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_MESSAGE 1024
+
+struct site {
+    uint32_t line;
+    char *file;
+    char *function;
+    char *format;
+};
+
+static struct site *g_sites;
+static size_t g_n_sites;
+static int g_raw_timestamps;
+
+static const char *level_names[] = { "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+static const char *module_names[] = { "SERVER", "DBUS", "CORE" };
+
+static const char *name_of(const char **names, size_t count, unsigned int index) {
+    return index < count ? names[index] : "UNKNOWN";
+}
+
+static void reset_sites(void) {
+    for (size_t i = 0; i < g_n_sites; i++) {
+        free(g_sites[i].file);
+    }
+    free(g_sites);
+    g_sites = NULL;
+    g_n_sites = 0;
+}
+
+/* Payload: file\0function\0format\0, stored in one allocation */
+static int add_site(const log_binary_record_t *record, char *payload) {
+    if (record->id == 0) return 0;
+
+    if (record->id > g_n_sites) {
+        struct site *sites = realloc(g_sites, record->id * sizeof(struct site));
+        if (!sites) return 0;
+        memset(sites + g_n_sites, 0, (record->id - g_n_sites) * sizeof(struct site));
+        g_sites = sites;
+        g_n_sites = record->id;
+    }
+
+    char *end = payload + record->length;
+    char *function = memchr(payload, '\0', record->length);
+    char *format = function ? memchr(function + 1, '\0', (size_t)(end - function - 1)) : NULL;
+    if (!format) return 0;
+
+    struct site *site = &g_sites[record->id - 1];
+    free(site->file);
+    site->line = record->line;
+    site->file = payload;
+    site->function = function + 1;
+    site->format = format + 1;
+    return 1;
+}
+
+static void print_line(const log_binary_record_t *record, const char *text) {
+    char timestamp[40];
+    if (g_raw_timestamps) {
+        snprintf(timestamp, sizeof(timestamp), "%lld", (long long)record->monotonic);
+    } else {
+        time_t seconds = (time_t)(record->timestamp / 1000000000ll);
+        size_t length = strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+        snprintf(timestamp + length, sizeof(timestamp) - length, ".%06lld",
+                 (long long)(record->timestamp % 1000000000ll / 1000));
+    }
+
+    printf("[%s] [%s] [%s] %s\n", timestamp,
+           name_of(level_names, sizeof(level_names) / sizeof(level_names[0]), record->level),
+           name_of(module_names, sizeof(module_names) / sizeof(module_names[0]), record->module),
+           text);
+}
+
+static int read_header(FILE *file) {
+    log_binary_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1) return 0;
+
+    if (memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "Not a binary log (bad magic)\n");
+        return 0;
+    }
+    if (header.version != LOG_BINARY_VERSION || header.pointer_size != sizeof(void *)) {
+        fprintf(stderr, "Unsupported binary log version %u (pointer size %u)\n",
+                header.version, header.pointer_size);
+        return 0;
+    }
+    return 1;
+}
+
+static int decode(FILE *file) {
+    if (!read_header(file)) return 0;
+
+    log_binary_record_t record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        /* Every run appends a new header, site ids restart */
+        if (memcmp(&record, LOG_BINARY_MAGIC, strlen(LOG_BINARY_MAGIC)) == 0) {
+            if (fseek(file, -(long)sizeof(record), SEEK_CUR) != 0 || !read_header(file)) return 0;
+            reset_sites();
+            continue;
+        }
+
+        char *payload = malloc((size_t)record.length + 1);
+        if (!payload || (record.length && fread(payload, record.length, 1, file) != 1)) {
+            free(payload);
+            fprintf(stderr, "Truncated record\n");
+            return 0;
+        }
+        payload[record.length] = '\0';
+
+        char text[MAX_MESSAGE];
+        switch (record.type) {
+            case LOG_BINARY_SITE:
+                if (!add_site(&record, payload)) {
+                    fprintf(stderr, "Malformed site record %u\n", record.id);
+                    free(payload);
+                }
+                continue;
+            case LOG_BINARY_EVENT:
+                if (record.id == 0 || record.id > g_n_sites || !g_sites[record.id - 1].format) {
+                    snprintf(text, sizeof(text), "<unknown site %u>", record.id);
+                } else {
+                    log_format_render(g_sites[record.id - 1].format, (const uint8_t *)payload,
+                                      record.length, text, sizeof(text));
+                }
+                print_line(&record, text);
+                break;
+            case LOG_BINARY_TEXT:
+                print_line(&record, payload);
+                break;
+            default:
+                fprintf(stderr, "Unknown record type %u\n", record.type);
+                break;
+        }
+        free(payload);
+    }
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    const char *path = argv[argc - 1];
+    g_raw_timestamps = argc == 3 && strcmp(argv[1], "--raw") == 0;
+
+    if (argc != 2 && !g_raw_timestamps) {
+        fprintf(stderr, "Usage: %s [--raw] BINARY_LOG\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 1;
+    }
+
+    int ok = decode(file);
+    fclose(file);
+    reset_sites();
+
+    return ok ? 0 : 1;
+}